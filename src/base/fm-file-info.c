@@ -36,6 +36,10 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_STATX
+# define _GNU_SOURCE 1 /* for statx() */
+#endif
+
 #include <menu-cache.h>
 #include "fm-file-info.h"
 #include <glib.h>
@@ -43,15 +47,21 @@
 #include <grp.h> /* Query group name */
 #include <pwd.h> /* Query user name */
 #include <string.h>
+#include <wchar.h>
 #include <errno.h>
+#include <limits.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#ifdef HAVE_STATX
+#include <sys/sysmacros.h> /* for makedev() */
+#endif
 
 #include "fm-config.h"
 #include "fm-utils.h"
+#include "fm-record-cache.h"
 
 /* support for libmenu-cache 0.4.x */
 #ifndef MENU_CACHE_CHECK_VERSION
@@ -66,6 +76,12 @@
 
 static FmIcon* icon_locked_folder = NULL;
 
+/* read-only state of file systems by device id, reset on (un)mount */
+static GHashTable *fs_ro_cache = NULL;
+G_LOCK_DEFINE_STATIC(fs_ro_cache);
+
+static void desktop_cache_finalize(void);
+
 /* all of the user special dirs are direct child of home directory */
 static gboolean special_dirs_all_in_home = TRUE;
 
@@ -88,39 +104,32 @@ static SpecialDirInfo special_dir_info[G_USER_N_DIRECTORIES] = {
     {NULL, NULL, "folder-videos"}
 };
 
+/* display strings and link target, allocated on first use; nothing here
+   is retrieved by FmFolder so listing doesn't allocate it */
+typedef struct _FmFileInfoExtra
+{
+    char* disp_size;  /* displayed human-readable file size */
+    char* disp_mtime; /* displayed last modification time */
+    char* disp_owner;
+    char* disp_group;
+    char* target; /* target of shortcut or mountable. */
+} FmFileInfoExtra;
+
 struct _FmFileInfo
 {
+    /* members used by sorting and filtering go first so they fit into
+       one cache line (64 bytes on 64-bit) */
     FmPath* path; /* path of the file */
-
-    mode_t mode;
-    union {
-        const char* fs_id;
-        dev_t dev;
-    };
-    uid_t uid;
-    gid_t gid;
-    goffset size;
-    time_t mtime;
-    time_t atime;
-    time_t ctime;
-
-    gulong blksize;
-    goffset blocks;
-
+    FmMimeType* mime_type;
     /* FIXME: caching the collate key can greatly speed up sorting.
      *        However, memory usage is greatly increased!.
      *        Is there a better alternative solution?
      */
     char* collate_key; /* used to sort files by name */
     char* collate_key_case; /* the same but case-sensitive */
-    char* disp_size;  /* displayed human-readable file size */
-    char* disp_mtime; /* displayed last modification time */
-    char* disp_owner;
-    char* disp_group;
-    FmMimeType* mime_type;
-    FmIcon* icon;
-
-    char* target; /* target of shortcut or mountable. */
+    goffset size;
+    time_t mtime;
+    mode_t mode;
 
     gboolean shortcut : 1; /* TRUE if file is shortcut type */
     gboolean accessible : 1; /* TRUE if can be read by user */
@@ -132,9 +141,43 @@ struct _FmFileInfo
     gboolean fs_is_ro : 1; /* TRUE if host FS is R/O */
 
     /*<private>*/
+    guint missing_attrs : 6; /* FmFileInfoAttrMask not retrieved */
     int n_ref;
+
+    FmIcon* icon;
+    union {
+        const char* fs_id;
+        dev_t dev;
+    };
+    guint64 inode; /* 0 if unknown */
+    time_t atime;
+    time_t ctime;
+    uid_t uid;
+    gid_t gid;
+    gulong blksize;
+    goffset blocks;
+    FmFileInfoExtra* extra; /* NULL until some of its members are set */
 };
 
+static const FmFileInfoExtra no_extra; /* all zeroes */
+
+/* for reading members of extra data */
+static inline const FmFileInfoExtra *_fm_file_info_peek_extra(FmFileInfo *fi)
+{
+    return fi->extra ? fi->extra : &no_extra;
+}
+
+/* for setting members of extra data */
+static inline FmFileInfoExtra *_fm_file_info_get_extra(FmFileInfo *fi)
+{
+    if (G_UNLIKELY(fi->extra == NULL))
+    {
+        fi->extra = _fm_object_alloc(sizeof(FmFileInfoExtra));
+        memset(fi->extra, 0, sizeof(FmFileInfoExtra));
+    }
+    return fi->extra;
+}
+
 struct _FmFileInfoList
 {
     FmList list;
@@ -147,6 +190,7 @@ void _fm_file_info_init(void)
     int home_dir_len = strlen(user_home);
     int i;
     icon_locked_folder = fm_icon_from_name("folder-locked");
+    fs_ro_cache = g_hash_table_new(g_direct_hash, NULL);
 
     for(i = 0; i < G_USER_N_DIRECTORIES; ++i)
     {
@@ -173,7 +217,10 @@ void _fm_file_info_init(void)
 
 void _fm_file_info_finalize()
 {
+    desktop_cache_finalize();
     g_object_unref(icon_locked_folder);
+    g_hash_table_destroy(fs_ro_cache);
+    fs_ro_cache = NULL;
 }
 
 /**
@@ -184,24 +231,25 @@ void _fm_file_info_finalize()
  */
 FmFileInfo* fm_file_info_new ()
 {
-    FmFileInfo * fi = g_slice_new0(FmFileInfo);
+    FmFileInfo * fi = _fm_object_alloc(sizeof(FmFileInfo));
+    memset(fi, 0, sizeof(FmFileInfo));
     fi->n_ref = 1;
     return fi;
 }
 
 /**
- * _fm_file_info_set_emblems:
+ * _fm_file_info_add_emblems:
  * @fi:  A FmFileInfo struct
- * @inf: A GFileInfo object
+ * @emblem_names: (allow-none): names of emblem icons
  *
- * Read icon emblems metadata from the "metadata::emblems" attribute of
- * a GFileInfo object and make the GIcon store in the FmFileInfo a 
- * GEmblemedIcon object if the file has emblems.
+ * Make the GIcon store in the FmFileInfo a GEmblemedIcon object if
+ * there are any emblems in @emblem_names and icon has no emblems yet.
+ *
+ * Returns: %TRUE if icon of @fi was changed.
  */
-static void _fm_file_info_set_emblems(FmFileInfo* fi, GFileInfo* inf)
+gboolean _fm_file_info_add_emblems(FmFileInfo *fi, char **emblem_names)
 {
-    char** emblem_names = g_file_info_get_attribute_stringv(inf, "metadata::emblems");
-    if(emblem_names)
+    if(emblem_names && emblem_names[0] && !G_IS_EMBLEMED_ICON(fi->icon))
     {
         GIcon* gicon = g_emblemed_icon_new(G_ICON(fi->icon), NULL);
         char** emblem_name;
@@ -217,57 +265,618 @@ static void _fm_file_info_set_emblems(FmFileInfo* fi, GFileInfo* inf)
         g_object_unref(fi->icon);
         fi->icon = fm_icon_from_gicon(gicon);
         g_object_unref(gicon);
+        return TRUE;
     }
+    return FALSE;
 }
 
 /**
- * fm_file_info_set_from_native_file:
+ * _fm_file_info_set_emblems:
  * @fi:  A FmFileInfo struct
- * @path:  full path of the file
+ * @inf: A GFileInfo object
+ *
+ * Read icon emblems metadata from the "metadata::emblems" attribute of
+ * a GFileInfo object and make the GIcon store in the FmFileInfo a 
+ * GEmblemedIcon object if the file has emblems.
+ */
+static void _fm_file_info_set_emblems(FmFileInfo* fi, GFileInfo* inf)
+{
+    _fm_file_info_add_emblems(fi, g_file_info_get_attribute_stringv(inf, "metadata::emblems"));
+}
+
+/* for usage by FmFolder: mounts were changed so cached states are invalid */
+void _fm_file_info_reset_fs_cache(void)
+{
+    G_LOCK(fs_ro_cache);
+    if (fs_ro_cache)
+        g_hash_table_remove_all(fs_ro_cache);
+    G_UNLOCK(fs_ro_cache);
+}
+
+/* for usage by FmFolder: checks if @fi and @src have the same type, inode,
+   size, and modification time; attributes not retrieved are not compared */
+gboolean _fm_file_info_is_unchanged(FmFileInfo *fi, FmFileInfo *src)
+{
+    guint missing = fi->missing_attrs | src->missing_attrs;
+
+    if (fi->mode != src->mode || fi->inode != src->inode)
+        return FALSE;
+    if (!(missing & FM_FILE_INFO_ATTR_SIZE) && fi->size != src->size)
+        return FALSE;
+    if (!(missing & FM_FILE_INFO_ATTR_MTIME) && fi->mtime != src->mtime)
+        return FALSE;
+    return TRUE;
+}
+
+/* for usage by jobs: computes collate keys requested in @attrs; it should
+   be called before @fi is handed to the main thread, the handoff itself
+   publishes the keys so no locking is required */
+void _fm_file_info_prepare_collate_keys(FmFileInfo *fi, FmFileInfoAttrMask attrs)
+{
+    if (attrs & FM_FILE_INFO_ATTR_COLLATE_KEY)
+        fm_file_info_get_collate_key(fi);
+    if (attrs & FM_FILE_INFO_ATTR_COLLATE_KEY_CASE)
+        fm_file_info_get_collate_key_nocasefold(fi);
+}
+
+/* full path is built only when it cannot be avoided; if @dir_path is
+   %NULL then @name is the full path already */
+static inline const char *_native_path(const char *dir_path, const char *name,
+                                       char **path_buf)
+{
+    if (dir_path == NULL)
+        return name;
+    if (*path_buf == NULL)
+        *path_buf = g_build_filename(dir_path, name, NULL);
+    return *path_buf;
+}
+
+/* retrieve only type, mode, and @attrs of file, the rest of @st is not
+   reliable; on network file systems it doesn't force synchronization with
+   the server */
+static int _native_stat_at(int dirfd, const char *name, int flags,
+                           FmFileInfoAttrMask attrs, struct stat *st)
+{
+#ifdef HAVE_STATX
+    struct statx stx;
+    unsigned int mask = STATX_TYPE | STATX_MODE | STATX_INO;
+
+    if (attrs & FM_FILE_INFO_ATTR_SIZE)
+        mask |= STATX_SIZE;
+    if (attrs & FM_FILE_INFO_ATTR_MTIME)
+        mask |= STATX_MTIME;
+    if (attrs & FM_FILE_INFO_ATTR_ATIME)
+        mask |= STATX_ATIME;
+    if (attrs & FM_FILE_INFO_ATTR_CTIME)
+        mask |= STATX_CTIME;
+    if (attrs & FM_FILE_INFO_ATTR_OWNER)
+        mask |= STATX_UID | STATX_GID;
+    if (attrs & FM_FILE_INFO_ATTR_BLOCKS)
+        mask |= STATX_BLOCKS;
+    if (statx(dirfd, name, flags | AT_STATX_DONT_SYNC, mask, &stx) < 0)
+    {
+        if (errno != ENOSYS)
+            return -1;
+        /* kernel doesn't support statx() */
+        return fstatat(dirfd, name, st, flags);
+    }
+    memset(st, 0, sizeof(*st));
+    st->st_mode = stx.stx_mode;
+    st->st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    st->st_ino = stx.stx_ino;
+    st->st_nlink = stx.stx_nlink;
+    st->st_uid = stx.stx_uid;
+    st->st_gid = stx.stx_gid;
+    st->st_size = stx.stx_size;
+    st->st_blksize = stx.stx_blksize;
+    st->st_blocks = stx.stx_blocks;
+    st->st_atime = stx.stx_atime.tv_sec;
+    st->st_mtime = stx.stx_mtime.tv_sec;
+    st->st_ctime = stx.stx_ctime.tv_sec;
+    return 0;
+#else
+    return fstatat(dirfd, name, st, flags);
+#endif
+}
+
+static void _fm_file_info_set_stat_attrs(FmFileInfo *fi, struct stat *st,
+                                         FmFileInfoAttrMask attrs)
+{
+    if (attrs & FM_FILE_INFO_ATTR_SIZE)
+        fi->size = st->st_size;
+    if (attrs & FM_FILE_INFO_ATTR_MTIME)
+        fi->mtime = st->st_mtime;
+    if (attrs & FM_FILE_INFO_ATTR_ATIME)
+        fi->atime = st->st_atime;
+    if (attrs & FM_FILE_INFO_ATTR_CTIME)
+        fi->ctime = st->st_ctime;
+    if (attrs & FM_FILE_INFO_ATTR_OWNER)
+    {
+        fi->uid = st->st_uid;
+        fi->gid = st->st_gid;
+    }
+    if (attrs & FM_FILE_INFO_ATTR_BLOCKS)
+    {
+        fi->blksize = st->st_blksize;
+        fi->blocks = st->st_blocks;
+    }
+}
+
+/* file system state doesn't change until remount so it's enough to query
+   it once per mount instead of querying it for each directory; bind mounts
+   of the same device may differ in read-only state so the cache is keyed by
+   mount id and is not used if statx() cannot report it */
+static gboolean _fm_file_info_fs_is_ro(int dirfd, const char *dir_path,
+                                       const char *name, char **path_buf)
+{
+    gpointer key = NULL;
+    gboolean use_cache = FALSE, ro = FALSE;
+    GFile *gfile;
+    GFileInfo *inf;
+
+#if defined(HAVE_STATX) && defined(STATX_MNT_ID)
+    struct statx stx;
+
+    if (statx(dirfd, name, AT_STATX_DONT_SYNC, STATX_MNT_ID, &stx) == 0 &&
+        (stx.stx_mask & STATX_MNT_ID))
+    {
+        gpointer val;
+        gboolean found;
+
+        key = GUINT_TO_POINTER((guint)stx.stx_mnt_id);
+        G_LOCK(fs_ro_cache);
+        found = g_hash_table_lookup_extended(fs_ro_cache, key, NULL, &val);
+        G_UNLOCK(fs_ro_cache);
+        if (found)
+            return GPOINTER_TO_INT(val);
+        use_cache = TRUE;
+    }
+#endif
+    gfile = g_file_new_for_path(_native_path(dir_path, name, path_buf));
+    inf = g_file_query_filesystem_info(gfile, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY,
+                                       NULL, NULL);
+    g_object_unref(gfile);
+    if (inf == NULL) /* don't cache failures */
+        return FALSE;
+    ro = g_file_info_get_attribute_boolean(inf, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY);
+    g_object_unref(inf);
+    if (use_cache)
+    {
+        G_LOCK(fs_ro_cache);
+        g_hash_table_replace(fs_ro_cache, key, GINT_TO_POINTER(ro));
+        G_UNLOCK(fs_ro_cache);
+    }
+    return ro;
+}
+
+/* Cache of parsed desktop entries, keyed by device and inode of the file,
+ * valid while modification time and size of the file are the same. The
+ * least recently used entries are kept in memory. If the cache is
+ * persistent then it is also saved on finalization into
+ * $XDG_CACHE_HOME/libfm/desktop.cache, see fm-record-cache.h for its
+ * format, and that file is mapped into memory on first use. Display names
+ * depend on locale so the file is ignored if it was made with other
+ * language names. */
+#define DESKTOP_CACHE_NAME "desktop.cache"
+#define DESKTOP_CACHE_MAGIC "LIBFMDC1"
+#define DESKTOP_CACHE_DEFAULT_LIMIT 1024
+
+typedef enum
+{
+    DESKTOP_ENTRY_INVALID, /* not a desktop entry, is treated as text */
+    DESKTOP_ENTRY_LINK, /* Type=Link with URL */
+    DESKTOP_ENTRY_OTHER, /* any other Type */
+    DESKTOP_ENTRY_FORGOTTEN /* removed from cache, see _fm_file_info_forget_desktop_entry() */
+} DesktopEntryKind;
+
+typedef struct
+{
+    FmRecordKey key;
+    DesktopEntryKind kind;
+    gboolean hidden;
+    char *url;
+    char *icon_name;
+    char *name;
+    GList *link; /* in desktop_lru */
+} DesktopEntry;
+
+typedef struct
+{
+    FmRecordKey key;
+    guint32 kind;
+    guint32 hidden;
+    /* offsets in the table of strings or FM_RECORD_NO_STRING */
+    guint32 url;
+    guint32 icon_name;
+    guint32 name;
+    guint32 reserved;
+} DesktopCacheRecord;
+
+G_LOCK_DEFINE_STATIC(desktop_cache);
+static guint desktop_limit = DESKTOP_CACHE_DEFAULT_LIMIT;
+static gboolean desktop_persistent = TRUE;
+static gboolean desktop_dirty = FALSE;
+static GHashTable *desktop_hash = NULL; /* DesktopEntry -> itself */
+static GQueue desktop_lru = G_QUEUE_INIT; /* most recently used first */
+/* header keeps offset of language names used for names */
+static FmRecordFile desktop_file = { NULL, NULL, sizeof(DesktopCacheRecord), 0, NULL, 0, 0 };
+
+static void desktop_entry_clear(DesktopEntry *entry)
+{
+    g_free(entry->url);
+    g_free(entry->icon_name);
+    g_free(entry->name);
+}
+
+static void desktop_entry_free(gpointer data)
+{
+    DesktopEntry *entry = data;
+
+    desktop_entry_clear(entry);
+    g_slice_free(DesktopEntry, entry);
+}
+
+/* copies data of @src into @dst which should be cleared later */
+static void desktop_entry_copy(DesktopEntry *dst, const DesktopEntry *src)
+{
+    *dst = *src;
+    dst->url = g_strdup(src->url);
+    dst->icon_name = g_strdup(src->icon_name);
+    dst->name = g_strdup(src->name);
+    dst->link = NULL;
+}
+
+static void desktop_entry_parse(DesktopEntry *entry, GKeyFile *kf)
+{
+    char *type = g_key_file_get_string(kf, G_KEY_FILE_DESKTOP_GROUP,
+                                       G_KEY_FILE_DESKTOP_KEY_TYPE, NULL);
+
+    entry->kind = DESKTOP_ENTRY_INVALID;
+    if (type == NULL)
+        return;
+    /* g_debug("got desktop entry with type %s", type); */
+    if (strcmp(type, G_KEY_FILE_DESKTOP_TYPE_LINK) == 0)
+    {
+        /* Type=Link are shortcuts, otherwise it's error, Link should have URL */
+        entry->url = g_key_file_get_string(kf, G_KEY_FILE_DESKTOP_GROUP,
+                                           G_KEY_FILE_DESKTOP_KEY_URL, NULL);
+        if (entry->url)
+            entry->kind = DESKTOP_ENTRY_LINK;
+    }
+    else /* FIXME: fail if Type isn't Application or Directory */
+        entry->kind = DESKTOP_ENTRY_OTHER;
+    g_free(type);
+    if (entry->kind == DESKTOP_ENTRY_INVALID)
+        return;
+    entry->icon_name = g_key_file_get_string(kf, G_KEY_FILE_DESKTOP_GROUP,
+                                             G_KEY_FILE_DESKTOP_KEY_ICON, NULL);
+    /* Use title of the desktop entry for display */
+    entry->name = g_key_file_get_locale_string(kf, G_KEY_FILE_DESKTOP_GROUP,
+                                               G_KEY_FILE_DESKTOP_KEY_NAME,
+                                               NULL, NULL);
+    entry->hidden = g_key_file_get_boolean(kf, G_KEY_FILE_DESKTOP_GROUP,
+                                           G_KEY_FILE_DESKTOP_KEY_HIDDEN, NULL);
+}
+
+static char *desktop_cache_languages(void)
+{
+    return g_strjoinv(":", (char**)g_get_language_names());
+}
+
+static inline const DesktopCacheRecord *desktop_record(guint i)
+{
+    return (const DesktopCacheRecord*)_fm_record_file_get(&desktop_file, i);
+}
+
+/* should be called with lock held */
+static void desktop_cache_load(void)
+{
+    char *languages;
+    guint i;
+
+    if (!_fm_record_file_load(&desktop_file, DESKTOP_CACHE_NAME, DESKTOP_CACHE_MAGIC,
+                              sizeof(DesktopCacheRecord)))
+        return;
+    languages = desktop_cache_languages();
+    if (desktop_file.extra >= desktop_file.strings_size ||
+        strcmp(languages, _fm_record_file_get_string(&desktop_file, desktop_file.extra)) != 0)
+        _fm_record_file_unload(&desktop_file); /* names are for other locale */
+    g_free(languages);
+    for (i = 0; i < desktop_file.n_records; i++)
+    {
+        const DesktopCacheRecord *rec = desktop_record(i);
+        if (!_fm_record_file_string_valid(&desktop_file, rec->url) ||
+            !_fm_record_file_string_valid(&desktop_file, rec->icon_name) ||
+            !_fm_record_file_string_valid(&desktop_file, rec->name) ||
+            rec->kind >= DESKTOP_ENTRY_FORGOTTEN)
+        {
+            g_debug("ignoring invalid desktop entry cache");
+            _fm_record_file_unload(&desktop_file);
+            break;
+        }
+    }
+}
+
+/* fills @entry with data of record @rec, strings are not copied */
+static void desktop_entry_from_record(DesktopEntry *entry, const DesktopCacheRecord *rec)
+{
+    entry->key = rec->key;
+    entry->kind = rec->kind;
+    entry->hidden = rec->hidden;
+    entry->url = (char*)_fm_record_file_get_string(&desktop_file, rec->url);
+    entry->icon_name = (char*)_fm_record_file_get_string(&desktop_file, rec->icon_name);
+    entry->name = (char*)_fm_record_file_get_string(&desktop_file, rec->name);
+}
+
+/* should be called with lock held */
+static void desktop_cache_trim(void)
+{
+    while (g_queue_get_length(&desktop_lru) > desktop_limit)
+        g_hash_table_remove(desktop_hash, g_queue_pop_tail(&desktop_lru));
+}
+
+/* adds new entry to memory, should be called with lock held */
+static DesktopEntry *desktop_cache_add(const DesktopEntry *data)
+{
+    DesktopEntry *entry = g_slice_new(DesktopEntry);
+
+    desktop_entry_copy(entry, data);
+    /* replaced entry is freed by the hash table */
+    if ((data = g_hash_table_lookup(desktop_hash, entry)) != NULL)
+        g_queue_delete_link(&desktop_lru, data->link);
+    g_queue_push_head(&desktop_lru, entry);
+    entry->link = g_queue_peek_head_link(&desktop_lru);
+    g_hash_table_replace(desktop_hash, entry, entry);
+    desktop_cache_trim();
+    return entry;
+}
+
+/* should be called with lock held */
+static gboolean desktop_cache_ready(void)
+{
+    if (desktop_limit == 0)
+        return FALSE;
+    if (G_UNLIKELY(desktop_hash == NULL))
+    {
+        desktop_hash = g_hash_table_new_full(_fm_record_key_hash, _fm_record_key_equal,
+                                             NULL, desktop_entry_free);
+        if (desktop_persistent)
+            desktop_cache_load();
+    }
+    return TRUE;
+}
+
+/* fills @entry with copy of cached data for file @fi, entries are keyed
+   by device and inode of @fi itself, as _fm_file_info_forget_desktop_entry()
+   does, while @pstat is info of the file contents (i.e. symlink target) */
+static gboolean desktop_cache_lookup(const FmFileInfo *fi, const struct stat *pstat,
+                                     DesktopEntry *entry)
+{
+    DesktopEntry key, *found;
+    gboolean ok = FALSE;
+    gint i;
+
+    G_LOCK(desktop_cache);
+    if (!desktop_cache_ready())
+        goto _out;
+    key.key.dev = fi->dev;
+    key.key.ino = fi->inode;
+    found = g_hash_table_lookup(desktop_hash, &key);
+    if (found == NULL &&
+        (i = _fm_record_file_find(&desktop_file, key.key.dev, key.key.ino)) >= 0)
+    {
+        /* strings are copied by desktop_cache_add() */
+        desktop_entry_from_record(&key, desktop_record(i));
+        found = desktop_cache_add(&key);
+    }
+    if (found && found->kind != DESKTOP_ENTRY_FORGOTTEN &&
+        found->key.mtime == pstat->st_mtime && found->key.size == pstat->st_size)
+    {
+        g_queue_unlink(&desktop_lru, found->link);
+        g_queue_push_head_link(&desktop_lru, found->link);
+        desktop_entry_copy(entry, found);
+        ok = TRUE;
+    }
+_out:
+    G_UNLOCK(desktop_cache);
+    return ok;
+}
+
+static void desktop_cache_insert(const FmFileInfo *fi, const struct stat *pstat,
+                                 DesktopEntry *entry)
+{
+    G_LOCK(desktop_cache);
+    if (desktop_cache_ready())
+    {
+        entry->key.dev = fi->dev;
+        entry->key.ino = fi->inode;
+        entry->key.mtime = pstat->st_mtime;
+        entry->key.size = pstat->st_size;
+        desktop_cache_add(entry);
+        desktop_dirty = TRUE;
+    }
+    G_UNLOCK(desktop_cache);
+}
+
+/* writes entries from memory and still unused records of mapped file,
+   should be called with lock held */
+static void desktop_cache_save(void)
+{
+    GPtrArray *entries = g_ptr_array_new();
+    GArray *from_file = g_array_new(FALSE, FALSE, sizeof(DesktopEntry));
+    FmRecordWriter *writer;
+    char *languages;
+    GList *l;
+    guint i;
+
+    /* most recently used first */
+    for (l = desktop_lru.head; l; l = l->next)
+        if (((DesktopEntry*)l->data)->kind != DESKTOP_ENTRY_FORGOTTEN)
+            g_ptr_array_add(entries, l->data);
+    /* entries of mapped file which were not used in this session */
+    for (i = 0; i < desktop_file.n_records && entries->len + from_file->len < desktop_limit; i++)
+    {
+        DesktopEntry tmp;
+
+        desktop_entry_from_record(&tmp, desktop_record(i));
+        if (g_hash_table_lookup(desktop_hash, &tmp))
+            continue;
+        g_array_append_val(from_file, tmp);
+    }
+    for (i = 0; i < from_file->len; i++)
+        g_ptr_array_add(entries, &g_array_index(from_file, DesktopEntry, i));
+    _fm_record_keep_recent(entries, desktop_limit);
+
+    languages = desktop_cache_languages();
+    writer = _fm_record_writer_new(sizeof(DesktopCacheRecord), entries->len);
+    for (i = 0; i < entries->len; i++)
+    {
+        const DesktopEntry *entry = g_ptr_array_index(entries, i);
+        DesktopCacheRecord rec;
+
+        rec.key = entry->key;
+        rec.kind = entry->kind;
+        rec.hidden = entry->hidden;
+        rec.url = _fm_record_writer_add_string(writer, entry->url);
+        rec.icon_name = _fm_record_writer_add_string(writer, entry->icon_name);
+        rec.name = _fm_record_writer_add_string(writer, entry->name);
+        rec.reserved = 0;
+        _fm_record_writer_add(writer, &rec);
+    }
+    _fm_record_writer_save(writer, DESKTOP_CACHE_NAME, DESKTOP_CACHE_MAGIC,
+                           _fm_record_writer_add_string(writer, languages));
+    g_free(languages);
+    g_array_free(from_file, TRUE);
+    g_ptr_array_free(entries, TRUE);
+}
+
+static void desktop_cache_finalize(void)
+{
+    G_LOCK(desktop_cache);
+    if (desktop_hash)
+    {
+        if (desktop_persistent && desktop_limit > 0 && desktop_dirty)
+            desktop_cache_save();
+        _fm_record_file_unload(&desktop_file);
+        g_queue_clear(&desktop_lru);
+        g_hash_table_destroy(desktop_hash);
+        desktop_hash = NULL;
+        desktop_dirty = FALSE;
+    }
+    G_UNLOCK(desktop_cache);
+}
+
+/* makes sure desktop entry @fi will be parsed again on next query, it is
+   used by FmFolder when file monitor reports a change */
+void _fm_file_info_forget_desktop_entry(FmFileInfo *fi)
+{
+    DesktopEntry key = { 0 };
+
+    if (fi->inode == 0 || !fm_path_is_native(fi->path))
+        return;
+    key.key.dev = fi->dev;
+    key.key.ino = fi->inode;
+    key.kind = DESKTOP_ENTRY_FORGOTTEN;
+    G_LOCK(desktop_cache);
+    /* record in mapped file will be ignored too */
+    if (desktop_hash && (g_hash_table_lookup(desktop_hash, &key) ||
+                         _fm_record_file_find(&desktop_file, key.key.dev, key.key.ino) >= 0))
+    {
+        desktop_cache_add(&key);
+        desktop_dirty = TRUE;
+    }
+    G_UNLOCK(desktop_cache);
+}
+
+/**
+ * fm_file_info_set_desktop_entry_cache
+ * @max_entries: maximum number of parsed desktop entries, 0 to disable cache
+ * @persistent: %TRUE to keep the cache in user cache directory
+ *
+ * Sets parameters of cache of parsed desktop entry files. Entries are
+ * valid until size or modification time of the file is changed or the
+ * change is reported by file monitor of #FmFolder. If @persistent is
+ * %TRUE then the cache is saved on fm_finalize() and loaded on next run.
+ * Default limit is 1024 entries, and the cache is persistent. Changing
+ * of @persistent has effect only before the first desktop entry is read.
+ *
+ * Since: 1.3.2
+ */
+void fm_file_info_set_desktop_entry_cache(guint max_entries, gboolean persistent)
+{
+    G_LOCK(desktop_cache);
+    desktop_limit = max_entries;
+    desktop_persistent = persistent;
+    if (desktop_hash)
+        desktop_cache_trim();
+    G_UNLOCK(desktop_cache);
+}
+
+static char *_read_link_at(int dirfd, const char *name)
+{
+    char buf[4096];
+    ssize_t len = readlinkat(dirfd, name, buf, sizeof(buf));
+
+    if (len < 0 || len == sizeof(buf))
+        return NULL;
+    return g_strndup(buf, len);
+}
+
+/*
+ * _fm_file_info_set_from_native_file_at:
+ * @fi:  A FmFileInfo struct
+ * @dirfd: descriptor of containing directory or AT_FDCWD
+ * @name: name of file in @dirfd
+ * @dir_path: (allow-none): path of @dirfd, %NULL if @name is full path
  * @err: a GError** to retrive errors
+ * @get_fast: %TRUE to skip content tests
+ * @attrs: attributes to retrieve
  *
  * Get file info of the specified native file and store it in
- * the FmFileInfo struct.
- * 
- * Prior to calling this function, the FmPath of FmFileInfo should
- * have been set with fm_file_info_set_path().
+ * the FmFileInfo struct. All file system queries are done relative to
+ * @dirfd so full path is not built unless it is really required.
+ * Attributes not in @attrs are left zero.
  *
- * Note that this call does I/O and therefore can block.
+ * If @dir_path is not %NULL then emblems aren't retrieved, caller
+ * should query them for the whole directory at once and then use
+ * _fm_file_info_add_emblems() on the @fi.
  *
  * Returns: TRUE if no error happens.
  */
-gboolean _fm_file_info_set_from_native_file(FmFileInfo* fi, const char* path,
-                                            GError** err, gboolean get_fast)
+gboolean _fm_file_info_set_from_native_file_at(FmFileInfo* fi, int dirfd,
+                                               const char* name,
+                                               const char* dir_path,
+                                               GError** err, gboolean get_fast,
+                                               FmFileInfoAttrMask attrs)
 {
     struct stat st;
     char *dname;
+    char *path_buf = NULL;
 
     g_return_val_if_fail(fi && fi->path, FALSE);
-    if(lstat(path, &st) == 0)
+    if (!get_fast) /* size and time are required for content tests */
+        attrs |= FM_FILE_INFO_ATTR_SIZE | FM_FILE_INFO_ATTR_MTIME;
+    if(_native_stat_at(dirfd, name, AT_SYMLINK_NOFOLLOW, attrs, &st) == 0)
     {
-        GFile* gfile;
-        GFileInfo* inf;
-
         fi->mode = st.st_mode;
-        fi->mtime = st.st_mtime;
-        fi->atime = st.st_atime;
-        fi->ctime = st.st_ctime;
-        fi->size = st.st_size;
         fi->dev = st.st_dev;
-        fi->uid = st.st_uid;
-        fi->gid = st.st_gid;
+        fi->inode = st.st_ino;
+        _fm_file_info_set_stat_attrs(fi, &st, attrs);
+        fi->missing_attrs = FM_FILE_INFO_ATTR_ALL & ~attrs;
 
         /* handle symlinks: use target to retrieve its info */
         if(S_ISLNK(st.st_mode))
         {
-            if (stat(path, &st) < 0)
+            if (_native_stat_at(dirfd, name, 0,
+                                attrs & (FM_FILE_INFO_ATTR_SIZE | FM_FILE_INFO_ATTR_MTIME),
+                                &st) < 0)
             {
                 /* g_debug("invalid symlink: %s", strerror(errno)); */
                 fi->icon = fm_icon_from_name("dialog-warning");
                 /* we cannot test broken symlink so skip all tests */
                 get_fast = TRUE;
             }
-            fi->target = g_file_read_link(path, NULL);
+            _fm_file_info_get_extra(fi)->target = _read_link_at(dirfd, name);
         }
 
         /* files with . prefix or ~ suffix are regarded as hidden files.
@@ -287,7 +896,9 @@ gboolean _fm_file_info_set_from_native_file(FmFileInfo* fi, const char* path,
         }
         else
         {
-            fi->mime_type = fm_mime_type_from_native_file(path, fm_path_get_basename(fi->path), &st);
+            /* contents of regular files are read relative to @dirfd */
+            fi->mime_type = _fm_mime_type_from_native_file_at(dirfd, name,
+                                        fm_path_get_basename(fi->path), &st);
             if (G_UNLIKELY(fi->mime_type == NULL))
                 /* file might be deleted while we test it but we assume mime_type is not NULL */
                 fi->mime_type = fm_mime_type_from_name("application/octet-stream");
@@ -296,82 +907,70 @@ gboolean _fm_file_info_set_from_native_file(FmFileInfo* fi, const char* path,
         if (get_fast) /* do rough estimation */
             fi->accessible = ((st.st_mode & S_IRUSR) == S_IRUSR);
         else
-            fi->accessible = (g_access(path, R_OK) == 0);
+            fi->accessible = (faccessat(dirfd, name, R_OK, 0) == 0);
 
         /* special handling for desktop entry files */
         if(G_UNLIKELY(!get_fast && fm_file_info_is_desktop_entry(fi)))
         {
-            GKeyFile* kf = g_key_file_new();
+            DesktopEntry entry = { 0 };
             FmIcon* icon = NULL;
-            char* icon_name;
-            char* type;
 
-            if(g_key_file_load_from_file(kf, path, 0, NULL))
+            if (!desktop_cache_lookup(fi, &st, &entry))
             {
-                /* check if type is correct and supported */
-                type = g_key_file_get_string(kf, "Desktop Entry", "Type", NULL);
-                if(type)
-                {
-                    /* g_debug("got desktop entry with type %s", type); */
-                    if(strcmp(type, G_KEY_FILE_DESKTOP_TYPE_LINK) == 0)
-                    {
-                        char *uri = g_key_file_get_string(kf, G_KEY_FILE_DESKTOP_GROUP,
-                                                          G_KEY_FILE_DESKTOP_KEY_URL, NULL);
-                        /* handle Type=Link, those are shortcuts
-                           therefore set ->shortcut, ->target, ->mime_type */
-                        if (uri)
-                        {
-                            FmMimeType *new_mime_type = fm_mime_type_from_file_name(uri);
-
-                            /* g_debug("got type %s for URL %s", fm_mime_type_get_type(new_mime_type), uri); */
-                            if (strcmp(fm_mime_type_get_type(new_mime_type),
-                                       "application/octet-stream") == 0 ||
-                                /* actually remote links should never be
-                                   directories so let treat them as unknown */
-                                (new_mime_type == _fm_mime_type_get_inode_directory()
-                                 && !g_str_has_prefix(uri, "file:/")))
-                            {
-                                /* NOTE: earlier we classified all links to
-                                   desktop entry as inode/x-shortcut too but
-                                   that would require a lot of special support
-                                   therefore we set to inode/x-shortcut only
-                                   those shortcuts that we fail to determine */
-                                fm_mime_type_unref(new_mime_type);
-                                new_mime_type = fm_mime_type_ref(_fm_mime_type_get_inode_x_shortcut());
-                            }
-                            fm_mime_type_unref(fi->mime_type);
-                            fi->mime_type = new_mime_type;
-                            fi->shortcut = TRUE;
-                            fi->target = uri;
-                        }
-                        else
-                        {
-                            /* otherwise it's error, Link should have URL */
-                            g_free(type);
-                            goto _not_desktop_entry;
-                        }
-                    }
-                    /* FIXME: fail if Type isn't Application or Directory */
-                    g_free(type);
-                }
-                else
-                    goto _not_desktop_entry;
-                icon_name = g_key_file_get_string(kf, "Desktop Entry", "Icon", NULL);
-                if(icon_name)
+                GKeyFile* kf = g_key_file_new();
+                GError *error = NULL;
+
+                if(g_key_file_load_from_file(kf, _native_path(dir_path, name, &path_buf), 0, &error))
+                    desktop_entry_parse(&entry, kf);
+                /* don't cache I/O errors, file might be not readable yet */
+                if (error == NULL || error->domain == G_KEY_FILE_ERROR)
+                    desktop_cache_insert(fi, &st, &entry);
+                if (error)
+                    g_error_free(error);
+                g_key_file_free(kf);
+            }
+            if (entry.kind == DESKTOP_ENTRY_LINK)
+            {
+                /* handle Type=Link, those are shortcuts
+                   therefore set ->shortcut, ->target, ->mime_type */
+                FmMimeType *new_mime_type = fm_mime_type_from_file_name(entry.url);
+
+                /* g_debug("got type %s for URL %s", fm_mime_type_get_type(new_mime_type), entry.url); */
+                if (strcmp(fm_mime_type_get_type(new_mime_type),
+                           "application/octet-stream") == 0 ||
+                    /* actually remote links should never be
+                       directories so let treat them as unknown */
+                    (new_mime_type == _fm_mime_type_get_inode_directory()
+                     && !g_str_has_prefix(entry.url, "file:/")))
                 {
-                    icon = fm_icon_from_name(icon_name);
-                    g_free(icon_name);
+                    /* NOTE: earlier we classified all links to
+                       desktop entry as inode/x-shortcut too but
+                       that would require a lot of special support
+                       therefore we set to inode/x-shortcut only
+                       those shortcuts that we fail to determine */
+                    fm_mime_type_unref(new_mime_type);
+                    new_mime_type = fm_mime_type_ref(_fm_mime_type_get_inode_x_shortcut());
                 }
-                /* Use title of the desktop entry for display */
-                dname = g_key_file_get_locale_string(kf, "Desktop Entry", "Name", NULL, NULL);
+                fm_mime_type_unref(fi->mime_type);
+                fi->mime_type = new_mime_type;
+                fi->shortcut = TRUE;
+                g_free(_fm_file_info_get_extra(fi)->target);
+                _fm_file_info_get_extra(fi)->target = entry.url;
+                entry.url = NULL;
+            }
+            if (entry.kind != DESKTOP_ENTRY_INVALID)
+            {
+                if (entry.icon_name)
+                    icon = fm_icon_from_name(entry.icon_name);
+                dname = entry.name;
+                entry.name = NULL;
                 /* handle 'Hidden' key to set hidden attribute */
                 if (!fi->hidden)
-                    fi->hidden = g_key_file_get_boolean(kf, "Desktop Entry", "Hidden", NULL);
+                    fi->hidden = entry.hidden;
             }
             else
             {
                 /* otherwise it's error so treat the file as simple text */
-_not_desktop_entry:
                 fm_mime_type_unref(fi->mime_type);
                 fi->mime_type = fm_mime_type_from_name("text/plain");
             }
@@ -379,7 +978,7 @@ _not_desktop_entry:
                 fi->icon = icon;
             else
                 fi->icon = g_object_ref(fm_mime_type_get_icon(fi->mime_type));
-            g_key_file_free(kf);
+            desktop_entry_clear(&entry);
         }
         else if(!S_ISDIR(st.st_mode))
             ;
@@ -433,7 +1032,8 @@ _not_desktop_entry:
                         si = &special_dir_info[i];
                         /* compare base name first, and then prefix if needed. */
                         if(si->base_name && strcmp(si->base_name, base_name) == 0
-                            && strncmp(si->path_str, path, (si->base_name - si->path_str)) == 0)
+                            && strncmp(si->path_str, _native_path(dir_path, name, &path_buf),
+                                       (si->base_name - si->path_str)) == 0)
                         {
                             fi->icon = fm_icon_from_name(si->icon_name);
                             break;
@@ -445,41 +1045,43 @@ _not_desktop_entry:
         if(!fi->icon)
             fi->icon = g_object_ref(fm_mime_type_get_icon(fi->mime_type));
 
-        gfile = g_file_new_for_path(path);
-
-        /* get emblems using gio/gvfs-metadata */
-        inf = g_file_query_info(gfile, "metadata::emblems,standard::icon", G_FILE_QUERY_INFO_NONE, NULL, NULL);
-        if(inf)
+        if (dir_path == NULL)
         {
-            _fm_file_info_set_emblems(fi, inf);
-            g_object_unref(inf);
+            GFile *gfile = g_file_new_for_path(name);
+            GFileInfo *inf;
+
+            /* get emblems using gio/gvfs-metadata */
+            inf = g_file_query_info(gfile, "metadata::emblems,standard::icon", G_FILE_QUERY_INFO_NONE, NULL, NULL);
+            if(inf)
+            {
+                _fm_file_info_set_emblems(fi, inf);
+                g_object_unref(inf);
+            }
+            g_object_unref(gfile);
         }
 
         if (!dname)
-            dname = g_filename_display_basename(path);
+            dname = g_filename_display_basename(name);
         _fm_path_set_display_name(fi->path, dname);
         g_free(dname);
 
         /* check if directory's file system is read-only, default is FALSE */
-        fi->fs_is_ro = FALSE;
         if (S_ISDIR(st.st_mode))
-        {
-            inf = g_file_query_filesystem_info(gfile, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY,
-                                               NULL, NULL);
-            if (inf)
-            {
-                fi->fs_is_ro = g_file_info_get_attribute_boolean(inf, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY);
-                g_object_unref(inf);
-            }
-        }
-        g_object_unref(gfile);
+            fi->fs_is_ro = _fm_file_info_fs_is_ro(dirfd, dir_path, name,
+                                                  &path_buf);
+        else
+            fi->fs_is_ro = FALSE;
     }
     else
     {
-        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
-                    "%s: %s", path, g_strerror(errno));
+        int errsv = errno;
+        g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errsv),
+                    "%s: %s", _native_path(dir_path, name, &path_buf),
+                    g_strerror(errsv));
+        g_free(path_buf);
         return FALSE;
     }
+    g_free(path_buf);
     /* name is changeable for native files */
     fi->name_is_changeable = TRUE;
     /* hidden attribute is immutable for native files */
@@ -490,6 +1092,30 @@ _not_desktop_entry:
     return TRUE;
 }
 
+/**
+ * fm_file_info_set_from_native_file:
+ * @fi:  A FmFileInfo struct
+ * @path:  full path of the file
+ * @err: a GError** to retrive errors
+ *
+ * Get file info of the specified native file and store it in
+ * the FmFileInfo struct.
+ * 
+ * Prior to calling this function, the FmPath of FmFileInfo should
+ * have been set with fm_file_info_set_path().
+ *
+ * Note that this call does I/O and therefore can block.
+ *
+ * Returns: TRUE if no error happens.
+ */
+gboolean _fm_file_info_set_from_native_file(FmFileInfo* fi, const char* path,
+                                            GError** err, gboolean get_fast)
+{
+    return _fm_file_info_set_from_native_file_at(fi, AT_FDCWD, path, NULL,
+                                                 err, get_fast,
+                                                 FM_FILE_INFO_ATTR_ALL);
+}
+
 gboolean fm_file_info_set_from_native_file(FmFileInfo* fi, const char* path, GError** err)
 {
     return _fm_file_info_set_from_native_file(fi, path, err, FALSE);
@@ -521,6 +1147,23 @@ FmFileInfo *fm_file_info_new_from_native_file(FmPath *path, const char *path_str
     return NULL;
 }
 
+/* for usage by FmDirListJob: @name is relative to opened directory @dirfd
+   which has path @dir_path, see _fm_file_info_set_from_native_file_at() */
+FmFileInfo *_fm_file_info_new_from_native_file_at(FmPath *path, int dirfd,
+                                                  const char *name,
+                                                  const char *dir_path,
+                                                  GError **err, gboolean get_fast,
+                                                  FmFileInfoAttrMask attrs)
+{
+    FmFileInfo* fi = fm_file_info_new();
+    fi->path = fm_path_ref(path);
+    if (_fm_file_info_set_from_native_file_at(fi, dirfd, name, dir_path, err,
+                                              get_fast, attrs))
+        return fi;
+    fm_file_info_unref(fi);
+    return NULL;
+}
+
 /**
  * fm_file_info_set_from_gfileinfo:
  * @fi:  A FmFileInfo struct
@@ -554,6 +1197,7 @@ void fm_file_info_set_from_g_file_data(FmFileInfo *fi, GFile *gf, GFileInfo *inf
     GFile *_gf = NULL;
     GFileAttributeInfoList *list;
     GFileType type;
+    FmFileInfoExtra *extra;
 
     g_return_if_fail(fi->path);
 
@@ -562,6 +1206,7 @@ void fm_file_info_set_from_g_file_data(FmFileInfo *fi, GFile *gf, GFileInfo *inf
         tmp = g_file_info_get_display_name(inf);
     _fm_path_set_display_name(fi->path, tmp);
 
+    fi->missing_attrs = 0;
     fi->size = g_file_info_get_size(inf);
 
     tmp = g_file_info_get_content_type(inf);
@@ -636,12 +1281,13 @@ void fm_file_info_set_from_g_file_data(FmFileInfo *fi, GFile *gf, GFileInfo *inf
         uri = g_file_info_get_attribute_string(inf, G_FILE_ATTRIBUTE_STANDARD_TARGET_URI);
         if(uri)
         {
+            extra = _fm_file_info_get_extra(fi);
             if(g_str_has_prefix(uri, "file:///"))
-                fi->target = g_filename_from_uri(uri, NULL, NULL);
+                extra->target = g_filename_from_uri(uri, NULL, NULL);
             else
-                fi->target = g_strdup(uri);
+                extra->target = g_strdup(uri);
             if(!fi->mime_type)
-                fi->mime_type = fm_mime_type_from_file_name(fi->target);
+                fi->mime_type = fm_mime_type_from_file_name(extra->target);
         }
 
         /* if the mime-type is not determined or is unknown */
@@ -666,12 +1312,13 @@ _file_is_symlink:
         uri = g_file_info_get_symlink_target(inf);
         if(uri)
         {
+            extra = _fm_file_info_get_extra(fi);
             if(g_str_has_prefix(uri, "file:///"))
-                fi->target = g_filename_from_uri(uri, NULL, NULL);
+                extra->target = g_filename_from_uri(uri, NULL, NULL);
             else
-                fi->target = g_strdup(uri);
+                extra->target = g_strdup(uri);
             if(!fi->mime_type)
-                fi->mime_type = fm_mime_type_from_file_name(fi->target);
+                fi->mime_type = fm_mime_type_from_file_name(extra->target);
         }
         /* continue with absent mime type */
     default: /* G_FILE_TYPE_UNKNOWN G_FILE_TYPE_REGULAR G_FILE_TYPE_SPECIAL */
@@ -702,6 +1349,7 @@ _file_is_symlink:
     if(fm_path_is_native(fi->path))
     {
         fi->dev = g_file_info_get_attribute_uint32(inf, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+        fi->inode = g_file_info_get_attribute_uint64(inf, G_FILE_ATTRIBUTE_UNIX_INODE);
     }
     else
     {
@@ -807,7 +1455,7 @@ void fm_file_info_set_from_menu_cache_item(FmFileInfo* fi, MenuCacheItem* item)
     }
     else if(menu_cache_item_get_type(item) == MENU_CACHE_TYPE_APP)
     {
-        fi->target = menu_cache_item_get_file_path(item);
+        _fm_file_info_get_extra(fi)->target = menu_cache_item_get_file_path(item);
         fi->mime_type = fm_mime_type_ref(_fm_mime_type_get_application_x_desktop());
         fi->hidden = !menu_cache_app_get_is_visible(MENU_CACHE_APP(item), (guint32)-1);
         fi->hidden_is_changeable = TRUE;
@@ -863,27 +1511,15 @@ static void fm_file_info_clear(FmFileInfo* fi)
         fi->path = NULL;
     }
 
-    if(G_LIKELY(fi->disp_size))
+    if(fi->extra)
     {
-        g_free(fi->disp_size);
-        fi->disp_size = NULL;
-    }
-
-    if(G_UNLIKELY(fi->disp_mtime))
-    {
-        g_free(fi->disp_mtime);
-        fi->disp_mtime = NULL;
-    }
-
-    g_free(fi->disp_owner);
-    fi->disp_owner = NULL;
-    g_free(fi->disp_group);
-    fi->disp_group = NULL;
-
-    if(G_UNLIKELY(fi->target))
-    {
-        g_free(fi->target);
-        fi->target = NULL;
+        g_free(fi->extra->disp_size);
+        g_free(fi->extra->disp_mtime);
+        g_free(fi->extra->disp_owner);
+        g_free(fi->extra->disp_group);
+        g_free(fi->extra->target);
+        _fm_object_free(fi->extra, sizeof(FmFileInfoExtra));
+        fi->extra = NULL;
     }
 
     if(G_LIKELY(fi->mime_type))
@@ -928,7 +1564,7 @@ void fm_file_info_unref(FmFileInfo* fi)
     if (g_atomic_int_dec_and_test(&fi->n_ref))
     {
         fm_file_info_clear(fi);
-        g_slice_free(FmFileInfo, fi);
+        _fm_object_free(fi, sizeof(FmFileInfo));
     }
 }
 
@@ -961,15 +1597,26 @@ void fm_file_info_update(FmFileInfo* fi, FmFileInfo* src)
         fi->dev = src->dev;
     else
         fi->fs_id = src->fs_id;
-    fi->uid = src->uid;
-    fi->gid = src->gid;
     fi->size = src->size;
     fi->mtime = src->mtime;
+    fi->inode = src->inode;
     fi->atime = src->atime;
     fi->ctime = src->ctime;
-
+    fi->uid = src->uid;
+    fi->gid = src->gid;
     fi->blksize = src->blksize;
     fi->blocks = src->blocks;
+    fi->missing_attrs = src->missing_attrs;
+    if(src->extra)
+    {
+        FmFileInfoExtra *extra = _fm_file_info_get_extra(fi);
+        *extra = *src->extra;
+        extra->disp_size = g_strdup(src->extra->disp_size);
+        extra->disp_mtime = g_strdup(src->extra->disp_mtime);
+        extra->disp_owner = g_strdup(src->extra->disp_owner);
+        extra->disp_group = g_strdup(src->extra->disp_group);
+        extra->target = g_strdup(src->extra->target);
+    }
 
     if(src->collate_key == COLLATE_USING_DISPLAY_NAME)
         fi->collate_key = COLLATE_USING_DISPLAY_NAME;
@@ -979,11 +1626,6 @@ void fm_file_info_update(FmFileInfo* fi, FmFileInfo* src)
         fi->collate_key_case = COLLATE_USING_DISPLAY_NAME;
     else
         fi->collate_key_case = g_strdup(src->collate_key_case);
-    fi->disp_size = g_strdup(src->disp_size);
-    fi->disp_mtime = g_strdup(src->disp_mtime);
-    fi->disp_owner = g_strdup(src->disp_owner);
-    fi->disp_group = g_strdup(src->disp_group);
-    fi->target = g_strdup(src->target);
     fi->accessible = src->accessible;
     fi->hidden = src->hidden;
     fi->backup = src->backup;
@@ -1156,17 +1798,17 @@ goffset fm_file_info_get_size(FmFileInfo* fi)
  */
 const char* fm_file_info_get_disp_size(FmFileInfo* fi)
 {
-    if (G_UNLIKELY(!fi->disp_size))
+    if (G_UNLIKELY(!_fm_file_info_peek_extra(fi)->disp_size))
     {
         if(S_ISREG(fi->mode))
         {
             char buf[ 64 ];
             fm_file_size_to_str2(buf, sizeof(buf), fi->size,
                         fm_config->list_view_size_units ? fm_config->list_view_size_units[0] : 0);
-            fi->disp_size = g_strdup(buf);
+            _fm_file_info_get_extra(fi)->disp_size = g_strdup(buf);
         }
     }
-    return fi->disp_size;
+    return _fm_file_info_peek_extra(fi)->disp_size;
 }
 
 /**
@@ -1387,15 +2029,16 @@ gboolean fm_file_info_is_executable_type(FmFileInfo* fi)
          they are native and have read permission */
         if(fm_path_is_native(fi->path) && (fi->mode & (S_IRUSR|S_IRGRP|S_IROTH)))
         {
-            if (fi->shortcut && fi->target) {
+            const char *target_str = _fm_file_info_peek_extra(fi)->target;
+            if (fi->shortcut && target_str) {
                 /* handle shortcuts from desktop to menu entries:
                    first check for entries in /usr/share/applications and such
                    which may be considered as a safe desktop entry path
                    then check if that is a shortcut to a native file
                    otherwise it is a link to a file under menu:// */
-                if (!g_str_has_prefix(fi->target, "/usr/share/"))
+                if (!g_str_has_prefix(target_str, "/usr/share/"))
                 {
-                    FmPath *target = fm_path_new_for_str(fi->target);
+                    FmPath *target = fm_path_new_for_str(target_str);
                     gboolean is_native = fm_path_is_native(target);
                     fm_path_unref(target);
                     if (is_native)
@@ -1478,6 +2121,133 @@ gboolean fm_file_info_can_thumbnail(FmFileInfo* fi)
 }
 
 
+/* Keys of ASCII names are made the same way g_utf8_collate_key_for_filename()
+ * does it: each dot is replaced by a sentinel, each number by a sentinel,
+ * a colon per digit but the first, and the significant digits, the rest of
+ * the name is transformed as g_utf8_collate_key() does, and counts of
+ * leading zeros are appended at the end as a tie-break. So keys made here
+ * and by glib can be compared together, but normalization, case folding
+ * and allocation for each part of the name are not needed for ASCII.
+ * Other names are left to glib. */
+#define COLLATION_SENTINEL "\1\1\1"
+
+static void _fm_collate_key_append_text(GString *key, const char *text,
+                                        gsize len, gboolean casefold)
+{
+#ifdef __STDC_ISO_10646__
+    /* glib uses wcsxfrm() and encodes resulting weights in UTF-8 */
+    wchar_t buf[128], xfrm_buf[512];
+    wchar_t *str = (len < G_N_ELEMENTS(buf)) ? buf : g_new(wchar_t, len + 1);
+    wchar_t *xfrm = xfrm_buf;
+    char utf8[6];
+    gsize n, i;
+
+    for (i = 0; i < len; i++)
+        str[i] = casefold ? g_ascii_tolower(text[i]) : text[i];
+    str[len] = 0;
+    n = wcsxfrm(xfrm, str, G_N_ELEMENTS(xfrm_buf));
+    if (n >= G_N_ELEMENTS(xfrm_buf))
+    {
+        xfrm = g_new(wchar_t, n + 1);
+        wcsxfrm(xfrm, str, n + 1);
+    }
+    for (i = 0; i < n; i++)
+        g_string_append_len(key, utf8, g_unichar_to_utf8(xfrm[i], utf8));
+    if (xfrm != xfrm_buf)
+        g_free(xfrm);
+#else
+    /* glib uses strxfrm() in UTF-8 locale */
+    char buf[128];
+    char *str = (len < sizeof(buf)) ? buf : g_malloc(len + 1);
+    gsize pos = key->len, room = key->allocated_len - key->len, n, i;
+
+    for (i = 0; i < len; i++)
+        str[i] = casefold ? g_ascii_tolower(text[i]) : text[i];
+    str[len] = '\0';
+    /* try to fit into space already allocated */
+    n = strxfrm(key->str + pos, str, room);
+    g_string_set_size(key, pos + n);
+    if (n >= room)
+        strxfrm(key->str + pos, str, n + 1);
+#endif
+    if (str != buf)
+        g_free(str);
+}
+
+static char *_fm_make_ascii_collate_key(const char *name, gboolean casefold)
+{
+    GString *key, *zeros;
+    const char *p, *prev, *digits;
+    gsize n_zeros;
+
+    for (p = name; *p; p++)
+        if ((guchar)*p >= 0x80)
+            return NULL;
+#ifndef __STDC_ISO_10646__
+    if (!g_get_charset(NULL)) /* glib makes other keys in other locales */
+        return NULL;
+#endif
+    key = g_string_sized_new((p - name) * 4);
+    zeros = g_string_new(NULL);
+    for (prev = p = name; *p; )
+    {
+        if (*p == '.')
+        {
+            if (prev != p)
+                _fm_collate_key_append_text(key, prev, p - prev, casefold);
+            g_string_append(key, COLLATION_SENTINEL "\1");
+            prev = ++p;
+        }
+        else if (g_ascii_isdigit(*p))
+        {
+            if (prev != p)
+                _fm_collate_key_append_text(key, prev, p - prev, casefold);
+            g_string_append(key, COLLATION_SENTINEL "\2");
+            for (digits = p; *p == '0'; p++);
+            n_zeros = p - digits;
+            if (g_ascii_isdigit(*p))
+                for (digits = p; g_ascii_isdigit(*p); p++);
+            else if (*p && n_zeros > 0)
+            {
+                /* number of all zeros is zero with one less leading zero
+                   unless it ends the name, glib counts all of them then */
+                n_zeros--;
+                digits = p - 1;
+            }
+            else
+                digits = p;
+            /* longer numbers are greater, then compared by digits */
+            for (prev = digits + 1; prev < p; prev++)
+                g_string_append_c(key, ':');
+            g_string_append_len(key, digits, p - digits);
+            if (n_zeros > 0)
+                g_string_append_c(zeros, (char)n_zeros);
+            prev = p;
+        }
+        else
+            p++;
+    }
+    if (prev != p)
+        _fm_collate_key_append_text(key, prev, p - prev, casefold);
+    g_string_append(key, zeros->str);
+    g_string_free(zeros, TRUE);
+    return g_string_free(key, FALSE);
+}
+
+static char *_fm_make_collate_key(const char *name, gboolean case_sensitive)
+{
+    char *key = _fm_make_ascii_collate_key(name, !case_sensitive);
+    char *casefold = NULL;
+
+    if (G_LIKELY(key))
+        return key;
+    if (!case_sensitive)
+        name = casefold = g_utf8_casefold(name, -1);
+    key = g_utf8_collate_key_for_filename(name, -1);
+    g_free(casefold);
+    return key;
+}
+
 /**
  * fm_file_info_get_collate_key:
  * @fi:  A FmFileInfo struct
@@ -1497,9 +2267,7 @@ const char* fm_file_info_get_collate_key(FmFileInfo* fi)
     if(G_UNLIKELY(!fi->collate_key))
     {
         const char* disp_name = fm_file_info_get_disp_name(fi);
-        char* casefold = g_utf8_casefold(disp_name, -1);
-        char* collate = g_utf8_collate_key_for_filename(casefold, -1);
-        g_free(casefold);
+        char* collate = _fm_make_collate_key(disp_name, FALSE);
         if(strcmp(collate, disp_name))
             fi->collate_key = collate;
         else
@@ -1543,7 +2311,7 @@ const char* fm_file_info_get_collate_key_nocasefold(FmFileInfo* fi)
     if(G_UNLIKELY(!fi->collate_key_case))
     {
         const char* disp_name = fm_file_info_get_disp_name(fi);
-        char* collate = g_utf8_collate_key_for_filename(disp_name, -1);
+        char* collate = _fm_make_collate_key(disp_name, TRUE);
         if(strcmp(collate, disp_name))
             fi->collate_key_case = collate;
         else
@@ -1578,7 +2346,7 @@ const char* fm_file_info_get_collate_key_nocasefold(FmFileInfo* fi)
  */
 const char* fm_file_info_get_target(FmFileInfo* fi)
 {
-    return fi->target;
+    return _fm_file_info_peek_extra(fi)->target;
 }
 
 /**
@@ -1616,16 +2384,16 @@ const char* fm_file_info_get_disp_mtime(FmFileInfo* fi)
     /*        We'd better hide mtime for virtual files only. */
     if(fi->mtime > 0)
     {
-        if (!fi->disp_mtime)
+        if (!_fm_file_info_peek_extra(fi)->disp_mtime)
         {
             char buf[ 128 ];
             strftime(buf, sizeof(buf),
                       "%x %R",
                       localtime(&fi->mtime));
-            fi->disp_mtime = g_strdup(buf);
+            _fm_file_info_get_extra(fi)->disp_mtime = g_strdup(buf);
         }
     }
-    return fi->disp_mtime;
+    return _fm_file_info_peek_extra(fi)->disp_mtime;
 }
 
 /**
@@ -1805,8 +2573,11 @@ gboolean fm_file_info_is_writable_directory(FmFileInfo* fi)
  */
 const char *fm_file_info_get_disp_owner(FmFileInfo *fi)
 {
+    FmFileInfoExtra *extra;
+
     g_return_val_if_fail(fi, NULL);
-    if (!fi->disp_owner)
+    extra = _fm_file_info_get_extra(fi);
+    if (!extra->disp_owner)
     {
         struct passwd* pw = NULL;
         struct passwd pwb;
@@ -1814,11 +2585,11 @@ const char *fm_file_info_get_disp_owner(FmFileInfo *fi)
 
         getpwuid_r(fi->uid, &pwb, unamebuf, sizeof(unamebuf), &pw);
         if (pw)
-            fi->disp_owner = g_strdup(pw->pw_name);
+            extra->disp_owner = g_strdup(pw->pw_name);
         else
-            fi->disp_owner = g_strdup_printf("%u", (guint)fi->uid);
+            extra->disp_owner = g_strdup_printf("%u", (guint)fi->uid);
     }
-    return fi->disp_owner;
+    return extra->disp_owner;
 }
 
 /**
@@ -1836,8 +2607,11 @@ const char *fm_file_info_get_disp_owner(FmFileInfo *fi)
  */
 const char *fm_file_info_get_disp_group(FmFileInfo *fi)
 {
+    FmFileInfoExtra *extra;
+
     g_return_val_if_fail(fi, NULL);
-    if (!fi->disp_group)
+    extra = _fm_file_info_get_extra(fi);
+    if (!extra->disp_group)
     {
         struct group* grp = NULL;
         struct group grpb;
@@ -1845,11 +2619,11 @@ const char *fm_file_info_get_disp_group(FmFileInfo *fi)
 
         getgrgid_r(fi->gid, &grpb, unamebuf, sizeof(unamebuf), &grp);
         if (grp)
-            fi->disp_group = g_strdup(grp->gr_name);
+            extra->disp_group = g_strdup(grp->gr_name);
         else
-            fi->disp_group = g_strdup_printf("%u", (guint)fi->gid);
+            extra->disp_group = g_strdup_printf("%u", (guint)fi->gid);
     }
-    return fi->disp_group;
+    return extra->disp_group;
 }
 
 
@@ -41,6 +41,48 @@ G_BEGIN_DECLS
 typedef struct _FmFileInfo FmFileInfo;
 //typedef struct _FmFileInfoList FmFileInfoList; // defined in fm-path.h
 
+/**
+ * FmFileInfoAttrMask:
+ * @FM_FILE_INFO_ATTR_NONE: only file type and access mode
+ * @FM_FILE_INFO_ATTR_SIZE: file size
+ * @FM_FILE_INFO_ATTR_MTIME: time of last modification
+ * @FM_FILE_INFO_ATTR_ATIME: time of last access
+ * @FM_FILE_INFO_ATTR_CTIME: time of last status change
+ * @FM_FILE_INFO_ATTR_OWNER: user and group ids of owner
+ * @FM_FILE_INFO_ATTR_BLOCKS: number of allocated blocks
+ * @FM_FILE_INFO_ATTR_ALL: all attributes above
+ * @FM_FILE_INFO_ATTR_COLLATE_KEY: compute key returned by
+ *  fm_file_info_get_collate_key() in the job thread
+ * @FM_FILE_INFO_ATTR_COLLATE_KEY_CASE: compute key returned by
+ *  fm_file_info_get_collate_key_nocasefold() in the job thread
+ *
+ * Attributes of native files which should be retrieved when file info is
+ * filled. File type and access mode are retrieved always. Every job and
+ * #FmFolder retrieve %FM_FILE_INFO_ATTR_ALL unless the caller opts in to
+ * a smaller set with fm_dir_list_job_set_attributes() or with the
+ * fm_file_info_job_set_attributes(). Attributes not requested that way
+ * are not queried at all and getters return zero for them.
+ *
+ * Collate keys are not included into %FM_FILE_INFO_ATTR_ALL. If they are
+ * requested then #FmDirListJob and #FmFileInfoJob compute them for files
+ * of any file system before files are handed to the main thread, so the
+ * first sort doesn't compute them in the main thread.
+ *
+ * Since: 1.3.2
+ */
+typedef enum {
+    FM_FILE_INFO_ATTR_NONE = 0,
+    FM_FILE_INFO_ATTR_SIZE = 1 << 0,
+    FM_FILE_INFO_ATTR_MTIME = 1 << 1,
+    FM_FILE_INFO_ATTR_ATIME = 1 << 2,
+    FM_FILE_INFO_ATTR_CTIME = 1 << 3,
+    FM_FILE_INFO_ATTR_OWNER = 1 << 4,
+    FM_FILE_INFO_ATTR_BLOCKS = 1 << 5,
+    FM_FILE_INFO_ATTR_ALL = (1 << 6) - 1,
+    FM_FILE_INFO_ATTR_COLLATE_KEY = 1 << 6,
+    FM_FILE_INFO_ATTR_COLLATE_KEY_CASE = 1 << 7
+} FmFileInfoAttrMask;
+
 struct _MenuCacheItem;/* forward declaration for MenuCacheItem */
 
 /* intialize the file info system */
@@ -63,6 +105,25 @@ void fm_file_info_set_from_menu_cache_item(FmFileInfo* fi, struct _MenuCacheItem
 gboolean fm_file_info_set_from_native_file(FmFileInfo* fi, const char* path, GError** err);
 FmFileInfo *fm_file_info_new_from_native_file(FmPath *path, const char *path_str, GError **err);
 
+/* for usage by FmDirListJob and FmFileInfoJob - never use in applications */
+gboolean _fm_file_info_set_from_native_file_at(FmFileInfo *fi, int dirfd,
+                                               const char *name,
+                                               const char *dir_path,
+                                               GError **err, gboolean get_fast,
+                                               FmFileInfoAttrMask attrs);
+FmFileInfo *_fm_file_info_new_from_native_file_at(FmPath *path, int dirfd,
+                                                  const char *name,
+                                                  const char *dir_path,
+                                                  GError **err, gboolean get_fast,
+                                                  FmFileInfoAttrMask attrs);
+gboolean _fm_file_info_add_emblems(FmFileInfo *fi, char **emblem_names);
+/* for usage by FmFolder - never use in applications */
+void _fm_file_info_reset_fs_cache(void);
+gboolean _fm_file_info_is_unchanged(FmFileInfo *fi, FmFileInfo *src);
+void _fm_file_info_forget_desktop_entry(FmFileInfo *fi);
+/* for usage by jobs - never use in applications */
+void _fm_file_info_prepare_collate_keys(FmFileInfo *fi, FmFileInfoAttrMask attrs);
+
 FmFileInfo* fm_file_info_ref( FmFileInfo* fi );
 void fm_file_info_unref( FmFileInfo* fi );
 
@@ -78,6 +139,8 @@ void fm_file_info_set_path(FmFileInfo* fi, FmPath* path);
 void fm_file_info_set_disp_name( FmFileInfo* fi, const char* name );
 void fm_file_info_set_icon(FmFileInfo *fi, GIcon *icon);
 
+void fm_file_info_set_desktop_entry_cache(guint max_entries, gboolean persistent);
+
 goffset fm_file_info_get_size( FmFileInfo* fi );
 const char* fm_file_info_get_disp_size( FmFileInfo* fi );
 
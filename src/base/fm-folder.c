@@ -39,6 +39,7 @@
 #include "fm-dummy-monitor.h"
 #include "fm-file.h"
 #include "fm-config.h"
+#include "glib-compat.h"
 
 #include <string.h>
 
@@ -57,6 +58,35 @@ enum {
     N_SIGNALS
 };
 
+/* default policy of coalescing monitor events, see fm_folder_set_update_policy() */
+#define FOLDER_UPDATE_DEBOUNCE      50 /* ms */
+#define FOLDER_UPDATE_MAX_LATENCY   500 /* ms */
+#define FOLDER_UPDATE_MAX_BATCH     1000
+/* if more files are added or changed at once then the folder is refreshed
+   since one listing is cheaper than query of each of them */
+#define FOLDER_REFRESH_BURST        10000
+
+/* rough estimation of memory used by each file in a cached folder */
+#define FOLDER_CACHE_FILE_SIZE      512 /* bytes */
+
+/* deferred content tests are done by few parallel jobs in small batches so
+   results are shown soon and reads of files from batches go in parallel */
+#define FOLDER_TEST_JOBS            4
+#define FOLDER_TEST_BATCH           64
+
+/* collate key is computed by jobs so the first sort by name doesn't stall
+   the main thread on a large folder; all attributes are retrieved since
+   applications may use any getter on files of the folder */
+#define FOLDER_FILE_ATTRS (FM_FILE_INFO_ATTR_ALL | FM_FILE_INFO_ATTR_COLLATE_KEY)
+
+/* queue of pending items which also keeps an index item -> link in queue
+   so checks for duplicates and cancelling an item don't scan the queue */
+typedef struct
+{
+    GQueue items;
+    GHashTable* index;
+} FmPendingQueue;
+
 struct _FmFolder
 {
     GObject parent;
@@ -66,15 +96,33 @@ struct _FmFolder
     GFile* gf;
     GFileMonitor* mon;
     FmDirListJob* dirlist_job;
+    FmDirListJob* refresh_job; /* see fm_folder_refresh() */
+    /* FmPath -> NULL, files which got events while refresh_job runs, the
+       refresh leaves them to those events; protected by G_LOCK(lists) */
+    GHashTable* refresh_touched;
+    gboolean refresh_failed; /* refresh_job failed to list the folder */
     FmFileInfo* dir_fi;
     FmFileInfoList* files;
+    /* FmPath -> GList link in files; changed only in main thread and with
+       G_LOCK(lists) on, so it may be read from main thread without lock */
+    GHashTable* files_hash;
 
     /* for file monitor */
     guint idle_handler;
-    GSList* files_to_add;
-    GSList* files_to_update;
-    GSList* files_to_del;
+    gint64 first_update_time; /* when idle_handler was added */
+    gint64 last_update_time; /* when last update was queued */
+    guint update_debounce; /* ms */
+    guint update_max_latency; /* ms */
+    guint update_max_batch;
+    gboolean update_flushing; /* idle_handler is set to fire at first idle */
+    FmPendingQueue files_to_add; /* FmPath */
+    FmPendingQueue files_to_update; /* FmPath */
+    FmPendingQueue files_to_del; /* GList link in files */
     GSList* pending_jobs;
+    /* deferred content tests - accessed only in main thread */
+    FmPendingQueue files_to_test; /* FmPath, in order of testing */
+    GSList* test_jobs;
+    FmJobPriority test_priority; /* raised when folder is visible */
     gboolean pending_change_notify;
     gboolean filesystem_info_pending;
     gboolean wants_incremental;
@@ -88,6 +136,10 @@ struct _FmFolder
     gboolean has_fs_info : 1;
     gboolean fs_info_not_avail : 1;
     gboolean defer_content_test : 1;
+
+    /* folder cache - protected by G_LOCK(cache) */
+    GList* cache_link; /* link in cache_lru if folder is unused */
+    gsize cache_size; /* estimated memory size when added to cache */
 };
 
 static void fm_folder_dispose(GObject *object);
@@ -114,6 +166,16 @@ G_LOCK_DEFINE_STATIC(hash);
 /* protects access to files_to_add, files_to_update and files_to_del */
 G_LOCK_DEFINE_STATIC(lists);
 
+/* cache of unused folders, see fm_folder_set_cache_limits();
+   if both locks are needed then G_LOCK(hash) should be taken first */
+G_LOCK_DEFINE_STATIC(cache);
+static GQueue cache_lru = G_QUEUE_INIT; /* most recently released first */
+static guint cache_max_folders = 0; /* 0 if cache is disabled */
+static gsize cache_max_bytes = 0; /* 0 if unlimited */
+static gsize cache_bytes = 0;
+static guint cache_hits = 0;
+static guint cache_misses = 0;
+
 static void fm_folder_class_init(FmFolderClass *klass)
 {
     GObjectClass *g_object_class;
@@ -339,9 +401,118 @@ static void fm_folder_class_init(FmFolderClass *klass)
 }
 
 
+static inline void pending_queue_init(FmPendingQueue *q)
+{
+    g_queue_init(&q->items);
+    q->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static inline gboolean pending_queue_contains(FmPendingQueue *q, gpointer item)
+{
+    return g_hash_table_lookup(q->index, item) != NULL;
+}
+
+/* adds item to tail of queue, returns FALSE if it's already queued */
+static inline gboolean pending_queue_push(FmPendingQueue *q, gpointer item)
+{
+    if (g_hash_table_lookup(q->index, item))
+        return FALSE;
+    g_queue_push_tail(&q->items, item);
+    g_hash_table_insert(q->index, item, g_queue_peek_tail_link(&q->items));
+    return TRUE;
+}
+
+/* removes item from queue, returns FALSE if it wasn't queued */
+static inline gboolean pending_queue_remove(FmPendingQueue *q, gpointer item)
+{
+    GList *l = g_hash_table_lookup(q->index, item);
+
+    if (l == NULL)
+        return FALSE;
+    g_hash_table_remove(q->index, item);
+    g_queue_delete_link(&q->items, l);
+    return TRUE;
+}
+
+/* removes the first item from queue and returns it, or NULL if it's empty */
+static inline gpointer pending_queue_pop_head(FmPendingQueue *q)
+{
+    gpointer item = g_queue_pop_head(&q->items);
+
+    if (item)
+        g_hash_table_remove(q->index, item);
+    return item;
+}
+
+/* moves item to head of queue, returns FALSE if it isn't queued */
+static inline gboolean pending_queue_raise(FmPendingQueue *q, gpointer item)
+{
+    GList *l = g_hash_table_lookup(q->index, item);
+
+    if (l == NULL)
+        return FALSE;
+    g_queue_unlink(&q->items, l);
+    g_queue_push_head_link(&q->items, l);
+    return TRUE;
+}
+
+/* returns content of queue as a list which should be freed by caller */
+static inline GList *pending_queue_steal(FmPendingQueue *q)
+{
+    GList *l = q->items.head;
+
+    g_queue_init(&q->items);
+    g_hash_table_remove_all(q->index);
+    return l;
+}
+
+static void pending_queue_clear(FmPendingQueue *q, GDestroyNotify free_func)
+{
+    GList *l = pending_queue_steal(q);
+
+    if (free_func)
+        g_list_foreach(l, (GFunc)free_func, NULL);
+    g_list_free(l);
+}
+
+static void pending_queue_destroy(FmPendingQueue *q, GDestroyNotify free_func)
+{
+    pending_queue_clear(q, free_func);
+    g_hash_table_destroy(q->index);
+    q->index = NULL;
+}
+
+/* should be called with G_LOCK(lists) on */
+static inline void refresh_touch(FmFolder *folder, FmPath *path)
+{
+    /* if path is there already then new reference is dropped by table */
+    if (folder->refresh_touched)
+        g_hash_table_insert(folder->refresh_touched, fm_path_ref(path), NULL);
+}
+
+/* should be called only in main thread */
+static inline void files_push_tail(FmFolder *folder, FmFileInfo *fi)
+{
+    fm_file_info_list_push_tail(folder->files, fi);
+    G_LOCK(lists);
+    g_hash_table_insert(folder->files_hash, fm_file_info_get_path(fi),
+                        fm_list_peek_tail_link((FmList*)folder->files));
+    G_UNLOCK(lists);
+}
+
 static void fm_folder_init(FmFolder *folder)
 {
     folder->files = fm_file_info_list_new();
+    folder->files_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
+    pending_queue_init(&folder->files_to_add);
+    pending_queue_init(&folder->files_to_update);
+    pending_queue_init(&folder->files_to_del);
+    pending_queue_init(&folder->files_to_test);
+    /* tests of folders nobody looks at shouldn't delay refreshes */
+    folder->test_priority = FM_JOB_PRIORITY_BACKGROUND;
+    folder->update_debounce = FOLDER_UPDATE_DEBOUNCE;
+    folder->update_max_latency = FOLDER_UPDATE_MAX_LATENCY;
+    folder->update_max_batch = FOLDER_UPDATE_MAX_BATCH;
     G_LOCK(hash);
     if (G_UNLIKELY(hash_uses == 0))
     {
@@ -365,6 +536,8 @@ static gboolean on_idle_reload(FmFolder* folder)
         /* FIXME: it should be impossible, folder cannot be disposed at this point */
         return FALSE;
     }
+    /* the mount is gone or new, so files might be not there anymore and
+       the monitor is lost, do the full reload */
     fm_folder_reload(folder);
     G_LOCK(query);
     folder->idle_reload_handler = 0;
@@ -418,7 +591,7 @@ static void on_file_info_job_finished(FmFileInfoJob* job, FmFolder* folder)
             {
                 if(need_added)
                     files_to_add = g_slist_prepend(files_to_add, fi);
-                fm_file_info_list_push_tail(folder->files, fi);
+                files_push_tail(folder, fi);
             }
         }
         if(files_to_add)
@@ -437,12 +610,126 @@ static void on_file_info_job_finished(FmFileInfoJob* job, FmFolder* folder)
     g_object_unref(job);
 }
 
-static gboolean on_idle(FmFolder* folder)
+static void start_test_jobs(FmFolder* folder);
+
+static void on_test_job_finished(FmFileInfoJob* job, FmFolder* folder)
+{
+    GList* l;
+    GSList* files_changed = NULL;
+
+    folder->test_jobs = g_slist_remove(folder->test_jobs, job);
+    if(fm_job_is_cancelled(FM_JOB(job)))
+    {
+        g_object_unref(job);
+        return;
+    }
+    /* handlers may drop the last reference on folder */
+    g_object_ref(folder);
+    for(l = fm_file_info_list_peek_head_link(job->file_infos); l; l = l->next)
+    {
+        FmFileInfo* fi = (FmFileInfo*)l->data;
+        GList* l2 = _fm_folder_get_file_by_path(folder, fm_file_info_get_path(fi));
+
+        /* if file is gone meanwhile then monitor will tell us */
+        if(l2)
+        {
+            fm_file_info_update(l2->data, fi);
+            files_changed = g_slist_prepend(files_changed, l2->data);
+        }
+    }
+    g_object_unref(job);
+    if(files_changed)
+    {
+        g_signal_emit(folder, signals[FILES_CHANGED], 0, files_changed);
+        g_slist_free(files_changed);
+        g_signal_emit(folder, signals[CONTENT_CHANGED], 0);
+    }
+    /* it does nothing if folder was disposed meanwhile */
+    start_test_jobs(folder);
+    g_object_unref(folder);
+}
+
+/* runs up to FOLDER_TEST_JOBS jobs for files from the head of files_to_test */
+static void start_test_jobs(FmFolder* folder)
+{
+    while(g_slist_length(folder->test_jobs) < FOLDER_TEST_JOBS &&
+          !g_queue_is_empty(&folder->files_to_test.items))
+    {
+        FmFileInfoJob* job = fm_file_info_job_new(NULL, FM_FILE_INFO_JOB_READAHEAD);
+        FmPath* path;
+        guint n = 0;
+
+        fm_file_info_job_set_attributes(job, FOLDER_FILE_ATTRS);
+        fm_job_set_priority(FM_JOB(job), folder->test_priority);
+        while(n++ < FOLDER_TEST_BATCH &&
+              (path = pending_queue_pop_head(&folder->files_to_test)) != NULL)
+        {
+            fm_file_info_job_add(job, path);
+            fm_path_unref(path);
+        }
+        g_signal_connect(job, "finished", G_CALLBACK(on_test_job_finished), folder);
+        folder->test_jobs = g_slist_prepend(folder->test_jobs, job);
+        if(!fm_job_run_async(FM_JOB(job)))
+        {
+            folder->test_jobs = g_slist_remove(folder->test_jobs, job);
+            g_object_unref(job);
+            g_critical("failed to start content test job");
+            break;
+        }
+    }
+}
+
+static void cancel_test_jobs(FmFolder* folder)
+{
+    GSList* l;
+
+    for(l = folder->test_jobs; l; l = l->next)
+    {
+        FmJob* job = FM_JOB(l->data);
+        g_signal_handlers_disconnect_by_func(job, on_test_job_finished, folder);
+        fm_job_cancel(job);
+        g_object_unref(job);
+    }
+    g_slist_free(folder->test_jobs);
+    folder->test_jobs = NULL;
+}
+
+static gint compare_for_test(gconstpointer a, gconstpointer b)
+{
+    FmFileInfo* fi_a = (FmFileInfo*)a;
+    FmFileInfo* fi_b = (FmFileInfo*)b;
+    gboolean is_dir_a = fm_file_info_is_dir(fi_a);
+
+    /* views usually show directories first, then sort by name */
+    if(is_dir_a != fm_file_info_is_dir(fi_b))
+        return is_dir_a ? -1 : 1;
+    return strcmp(fm_file_info_get_collate_key(fi_a),
+                  fm_file_info_get_collate_key(fi_b));
+}
+
+/* schedules content tests of files which were listed with basic info only,
+   files which are sorted first are tested first */
+static void queue_content_tests(FmFolder* folder, GSList* files)
 {
     GSList* l;
+
+    files = g_slist_sort(g_slist_copy(files), compare_for_test);
+    for(l = files; l; l = l->next)
+    {
+        FmPath* path = fm_file_info_get_path(l->data);
+        if(pending_queue_push(&folder->files_to_test, path))
+            fm_path_ref(path);
+    }
+    g_slist_free(files);
+    start_test_jobs(folder);
+}
+
+static gboolean on_idle(FmFolder* folder)
+{
+    GList* l;
     FmFileInfoJob* job = NULL;
-    GSList *files_to_add, *files_to_del, *files_to_update;
-    gboolean stop_emission;
+    GList *files_to_add, *files_to_del, *files_to_update;
+    gboolean stop_emission, refresh = FALSE;
 
     /* check if folder still exists */
     if(g_source_is_destroyed(g_main_current_source()))
@@ -451,16 +738,41 @@ static gboolean on_idle(FmFolder* folder)
         return FALSE;
     }
     G_LOCK(lists);
-    folder->idle_handler = 0;
+    if (g_source_is_destroyed(g_main_current_source()))
+    {
+        /* it was replaced by queue_update() while we waited for lock,
+           the borrowed reference is passed to the new handler */
+        G_UNLOCK(lists);
+        return FALSE;
+    }
     stop_emission = folder->stop_emission;
+    if (!stop_emission && !folder->update_flushing)
+    {
+        /* wait while events keep coming but not longer than max latency */
+        gint64 deadline = MIN(folder->last_update_time + folder->update_debounce * 1000,
+                              folder->first_update_time + folder->update_max_latency * 1000);
+        gint64 now = g_get_monotonic_time();
+        if (deadline > now)
+        {
+            /* keep reference borrowed in queue_update() */
+            folder->idle_handler = g_timeout_add_full(G_PRIORITY_LOW,
+                                                      (deadline - now + 999) / 1000,
+                                                      (GSourceFunc)on_idle,
+                                                      folder, NULL);
+            G_UNLOCK(lists);
+            return FALSE;
+        }
+    }
+    folder->idle_handler = 0;
+    folder->update_flushing = FALSE;
     if (!stop_emission)
     {
-        files_to_add = folder->files_to_add;
-        folder->files_to_add = NULL;
-        files_to_del = folder->files_to_del;
-        folder->files_to_del = NULL;
-        files_to_update = folder->files_to_update;
-        folder->files_to_update = NULL;
+        refresh = (g_queue_get_length(&folder->files_to_add.items) +
+                   g_queue_get_length(&folder->files_to_update.items)
+                   >= FOLDER_REFRESH_BURST);
+        files_to_add = pending_queue_steal(&folder->files_to_add);
+        files_to_del = pending_queue_steal(&folder->files_to_del);
+        files_to_update = pending_queue_steal(&folder->files_to_update);
     }
     G_UNLOCK(lists);
 
@@ -470,8 +782,26 @@ static gboolean on_idle(FmFolder* folder)
 
     /* g_debug("folder: on_idle() started"); */
 
+    /* burst of events such as unpacking of big archive, get changes with
+       fm_folder_refresh() below instead of a query for each file */
+    if (refresh && !folder->dirlist_job && !folder->wants_incremental &&
+        fm_folder_is_valid(folder))
+    {
+        g_list_foreach(files_to_update, (GFunc)fm_path_unref, NULL);
+        g_list_free(files_to_update);
+        files_to_update = NULL;
+        g_list_foreach(files_to_add, (GFunc)fm_path_unref, NULL);
+        g_list_free(files_to_add);
+        files_to_add = NULL;
+    }
+    else
+        refresh = FALSE;
+
     if(files_to_update || files_to_add)
+    {
         job = (FmFileInfoJob*)fm_file_info_job_new(NULL, 0);
+        fm_file_info_job_set_attributes(job, FOLDER_FILE_ATTRS);
+    }
 
     if(files_to_update)
     {
@@ -481,7 +811,7 @@ static gboolean on_idle(FmFolder* folder)
             fm_file_info_job_add(job, path);
             fm_path_unref(path);
         }
-        g_slist_free(files_to_update);
+        g_list_free(files_to_update);
     }
 
     if(files_to_add)
@@ -492,7 +822,7 @@ static gboolean on_idle(FmFolder* folder)
             fm_file_info_job_add(job, path);
             fm_path_unref(path);
         }
-        g_slist_free(files_to_add);
+        g_list_free(files_to_add);
     }
 
     if(job)
@@ -510,20 +840,28 @@ static gboolean on_idle(FmFolder* folder)
 
     if(files_to_del)
     {
-        GSList* ll;
-        for(ll=files_to_del;ll;ll=ll->next)
+        GSList* removed = NULL;
+        G_LOCK(lists);
+        for(l=files_to_del;l;l=l->next)
         {
-            GList* l= (GList*)ll->data;
-            ll->data = l->data;
-            fm_file_info_list_delete_link_nounref(folder->files, l);
+            GList* ll = (GList*)l->data;
+            FmFileInfo* fi = (FmFileInfo*)ll->data;
+            g_hash_table_remove(folder->files_hash, fm_file_info_get_path(fi));
+            fm_file_info_list_delete_link_nounref(folder->files, ll);
+            removed = g_slist_prepend(removed, fi);
         }
-        g_signal_emit(folder, signals[FILES_REMOVED], 0, files_to_del);
-        g_slist_foreach(files_to_del, (GFunc)fm_file_info_unref, NULL);
-        g_slist_free(files_to_del);
+        G_UNLOCK(lists);
+        g_list_free(files_to_del);
+        g_signal_emit(folder, signals[FILES_REMOVED], 0, removed);
+        g_slist_foreach(removed, (GFunc)fm_file_info_unref, NULL);
+        g_slist_free(removed);
 
         g_signal_emit(folder, signals[CONTENT_CHANGED], 0);
     }
 
+    if (refresh)
+        fm_folder_refresh(folder);
+
     if(folder->pending_change_notify)
     {
         g_signal_emit(folder, signals[CHANGED], 0);
@@ -549,13 +887,41 @@ _finish:
     return FALSE;
 }
 
+static inline guint n_pending_updates(FmFolder *folder)
+{
+    return g_queue_get_length(&folder->files_to_add.items)
+         + g_queue_get_length(&folder->files_to_update.items)
+         + g_queue_get_length(&folder->files_to_del.items);
+}
+
 /* should be called only with G_LOCK(lists) on! */
-static inline void queue_update(FmFolder *folder)
+static void queue_update(FmFolder *folder)
 {
+    gint64 now = g_get_monotonic_time();
+
+    folder->last_update_time = now;
     if (!folder->idle_handler)
+    {
+        folder->first_update_time = now;
+        folder->update_flushing = (folder->update_debounce == 0);
         /* borrow reference on folder */
+        if (folder->update_flushing)
+            folder->idle_handler = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)on_idle,
+                                                   g_object_ref(folder), NULL);
+        else
+            folder->idle_handler = g_timeout_add_full(G_PRIORITY_LOW, folder->update_debounce,
+                                                      (GSourceFunc)on_idle,
+                                                      g_object_ref(folder), NULL);
+    }
+    else if (!folder->update_flushing &&
+             n_pending_updates(folder) >= folder->update_max_batch)
+    {
+        /* batch is full, don't wait anymore; borrowed reference is kept */
+        g_source_remove(folder->idle_handler);
+        folder->update_flushing = TRUE;
         folder->idle_handler = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)on_idle,
-                                               g_object_ref(folder), NULL);
+                                               folder, NULL);
+    }
 }
 
 /* returns TRUE if reference was taken from path */
@@ -564,16 +930,17 @@ gboolean _fm_folder_event_file_added(FmFolder *folder, FmPath *path)
     gboolean added = TRUE;
 
     G_LOCK(lists);
+    refresh_touch(folder, path);
     /* make sure that the file is not already queued for addition. */
-    if(!g_slist_find(folder->files_to_add, path))
+    if(!pending_queue_contains(&folder->files_to_add, path))
     {
         GList *l = _fm_folder_get_file_by_path(folder, path);
         if(!l) /* it's new file */
         {
             /* add the file name to queue for addition. */
-            folder->files_to_add = g_slist_append(folder->files_to_add, path);
+            pending_queue_push(&folder->files_to_add, path);
         }
-        else if(g_slist_find(folder->files_to_update, path))
+        else if(pending_queue_contains(&folder->files_to_update, path))
         {
             /* file already queued for update, don't duplicate */
             added = FALSE;
@@ -583,9 +950,9 @@ gboolean _fm_folder_event_file_added(FmFolder *folder, FmPath *path)
         {
             /* bug #3591771: 'ln -fns . test' leave no file visible in folder.
                If it is queued for deletion then cancel that operation */
-            folder->files_to_del = g_slist_remove(folder->files_to_del, l);
+            pending_queue_remove(&folder->files_to_del, l);
             /* update the existing item. */
-            folder->files_to_update = g_slist_append(folder->files_to_update, path);
+            pending_queue_push(&folder->files_to_update, path);
         }
     }
     else
@@ -600,15 +967,21 @@ gboolean _fm_folder_event_file_added(FmFolder *folder, FmPath *path)
 gboolean _fm_folder_event_file_changed(FmFolder *folder, FmPath *path)
 {
     gboolean added;
+    GList *l;
 
     G_LOCK(lists);
+    refresh_touch(folder, path);
+    l = _fm_folder_get_file_by_path(folder, path);
+    /* parsed contents of desktop entry might be not valid anymore */
+    if (l && fm_file_info_is_desktop_entry(l->data))
+        _fm_file_info_forget_desktop_entry(l->data);
     /* make sure that the file is not already queued for changes or
      * it's already queued for addition. */
-    if(!g_slist_find(folder->files_to_update, path) &&
-       !g_slist_find(folder->files_to_add, path) &&
-       _fm_folder_get_file_by_path(folder, path)) /* ensure it is our file */
+    if(!pending_queue_contains(&folder->files_to_update, path) &&
+       !pending_queue_contains(&folder->files_to_add, path) &&
+       l) /* ensure it is our file */
     {
-        folder->files_to_update = g_slist_append(folder->files_to_update, path);
+        pending_queue_push(&folder->files_to_update, path);
         added = TRUE;
         queue_update(folder);
     }
@@ -623,24 +996,20 @@ gboolean _fm_folder_event_file_changed(FmFolder *folder, FmPath *path)
 void _fm_folder_event_file_deleted(FmFolder *folder, FmPath *path)
 {
     GList *l;
-    GSList *sl;
 
     G_LOCK(lists);
+    refresh_touch(folder, path);
     l = _fm_folder_get_file_by_path(folder, path);
-    if(l && !g_slist_find(folder->files_to_del, l) )
-        folder->files_to_del = g_slist_prepend(folder->files_to_del, l);
-    /* if the file is already queued for addition or update, that operation
-       will be just a waste, therefore cancel it right now */
-    sl = g_slist_find(folder->files_to_update, path);
-    if(sl)
-    {
-        folder->files_to_update = g_slist_delete_link(folder->files_to_update, sl);
-    }
-    else if((sl = g_slist_find(folder->files_to_add, path)))
+    if(l)
     {
-        folder->files_to_add = g_slist_delete_link(folder->files_to_add, sl);
+        if (fm_file_info_is_desktop_entry(l->data))
+            _fm_file_info_forget_desktop_entry(l->data);
+        pending_queue_push(&folder->files_to_del, l);
     }
-    else
+    /* if the file is already queued for addition or update, that operation
+       will be just a waste, therefore cancel it right now */
+    if(!pending_queue_remove(&folder->files_to_update, path) &&
+       !pending_queue_remove(&folder->files_to_add, path))
         path = NULL;
     queue_update(folder);
     G_UNLOCK(lists);
@@ -697,9 +1066,9 @@ static void on_folder_changed(GFileMonitor* mon, GFile* gf, GFile* other, GFileM
         case G_FILE_MONITOR_EVENT_CHANGED:
             folder->pending_change_notify = TRUE;
             G_LOCK(lists);
-            if (g_slist_find(folder->files_to_update, folder->dir_path) == NULL)
+            if (pending_queue_push(&folder->files_to_update, folder->dir_path))
             {
-                folder->files_to_update = g_slist_append(folder->files_to_update, fm_path_ref(folder->dir_path));
+                fm_path_ref(folder->dir_path);
                 queue_update(folder);
             }
             G_UNLOCK(lists);
@@ -760,19 +1129,13 @@ static void on_dirlist_job_finished(FmDirListJob* job, FmFolder* folder)
         {
             FmFileInfo* inf = (FmFileInfo*)l->data;
             files = g_slist_prepend(files, inf);
-            fm_file_info_list_push_tail(folder->files, inf);
+            files_push_tail(folder, inf);
         }
         if(G_LIKELY(files))
         {
-            GSList *l;
-
-            G_LOCK(lists);
             if (folder->defer_content_test && fm_path_is_native(folder->dir_path))
                 /* we got only basic info on content, schedule update it now */
-                for (l = files; l; l = l->next)
-                    folder->files_to_update = g_slist_prepend(folder->files_to_update,
-                                                fm_path_ref(fm_file_info_get_path(l->data)));
-            G_UNLOCK(lists);
+                queue_content_tests(folder, files);
             g_signal_emit(folder, signals[FILES_ADDED], 0, files);
             g_slist_free(files);
         }
@@ -782,31 +1145,35 @@ static void on_dirlist_job_finished(FmDirListJob* job, FmFolder* folder)
 
         /* Some new files are created while FmDirListJob is loading the folder. */
         G_LOCK(lists);
-        if(G_UNLIKELY(folder->files_to_add))
+        if(G_UNLIKELY(!g_queue_is_empty(&folder->files_to_add.items)))
         {
             /* This should be a very rare case. Could this happen? */
-            GSList* l;
-            for(l = folder->files_to_add; l;)
+            GList* l;
+            for(l = folder->files_to_add.items.head; l;)
             {
                 FmPath *path = l->data;
-                GSList* next = l->next;
+                GList* next = l->next;
                 if(_fm_folder_get_file_by_path(folder, path))
                 {
                     /* we already have the file. remove it from files_to_add, 
                      * and put it in files_to_update instead.
-                     * No strdup for name is needed here. We steal
-                     * the string from files_to_add.*/
-                    folder->files_to_update = g_slist_prepend(folder->files_to_update, path);
-                    folder->files_to_add = g_slist_delete_link(folder->files_to_add, l);
+                     * No ref for path is needed here. We steal
+                     * the reference from files_to_add.*/
+                    pending_queue_remove(&folder->files_to_add, path);
+                    if (!pending_queue_push(&folder->files_to_update, path))
+                        fm_path_unref(path);
                 }
                 l = next;
             }
         }
         G_UNLOCK(lists);
     }
-    else if(!folder->dir_fi && job->dir_fi)
-        /* we may need dir_fi for incremental folders too */
-        folder->dir_fi = fm_file_info_ref(job->dir_fi);
+    else
+    {
+        if(!folder->dir_fi && job->dir_fi)
+            /* we may need dir_fi for incremental folders too */
+            folder->dir_fi = fm_file_info_ref(job->dir_fi);
+    }
     g_object_unref(folder->dirlist_job);
     folder->dirlist_job = NULL;
 
@@ -822,7 +1189,7 @@ static void on_dirlist_job_files_found(FmDirListJob* job, GSList* files, gpointe
     for(l = files; l; l = l->next)
     {
         FmFileInfo* file = FM_FILE_INFO(l->data);
-        fm_file_info_list_push_tail(folder->files, file);
+        files_push_tail(folder, file);
     }
     if (G_UNLIKELY(!folder->dir_fi && job->dir_fi))
         /* we may want info while folder is still loading */
@@ -841,6 +1208,128 @@ static FmJobErrorAction on_dirlist_job_error(FmDirListJob* job, GError* err, FmJ
     return ret;
 }
 
+static FmJobErrorAction on_refresh_job_error(FmDirListJob* job, GError* err, FmJobErrorSeverity severity, FmFolder* folder)
+{
+    /* damaged files are still listed, anything worse makes listing partial */
+    if(severity > FM_JOB_ERROR_MILD)
+        folder->refresh_failed = TRUE;
+    return on_dirlist_job_error(job, err, severity, folder);
+}
+
+/* should be called with G_LOCK(lists) on; files which got events since
+   refresh was started are handled by those events, the listing might be
+   older than them */
+static inline gboolean refresh_skips_file(FmFolder* folder, FmPath* path)
+{
+    return g_hash_table_lookup_extended(folder->refresh_touched, path, NULL, NULL) ||
+           pending_queue_contains(&folder->files_to_add, path) ||
+           pending_queue_contains(&folder->files_to_update, path);
+}
+
+/* apply difference between folder->files and listing done by refresh_job */
+static void on_refresh_job_finished(FmDirListJob* job, FmFolder* folder)
+{
+    GHashTable* listed;
+    GList *l, *next;
+    GSList *files_added = NULL, *files_changed = NULL, *files_removed = NULL;
+    GSList *files_to_test = NULL;
+
+    /* if listing failed then it's incomplete and cannot be compared */
+    if(fm_job_is_cancelled(FM_JOB(job)) || folder->refresh_failed)
+        goto _finish;
+
+    listed = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for(l = fm_file_info_list_peek_head_link(job->files); l; l = l->next)
+        g_hash_table_insert(listed, fm_file_info_get_path(l->data), l->data);
+
+    /* remove files which are gone */
+    G_LOCK(lists);
+    for(l = fm_file_info_list_peek_head_link(folder->files); l; l = next)
+    {
+        FmFileInfo* fi = (FmFileInfo*)l->data;
+        FmPath* path = fm_file_info_get_path(fi);
+        next = l->next;
+        if(g_hash_table_lookup(listed, path) || refresh_skips_file(folder, path))
+            continue;
+        g_hash_table_remove(folder->files_hash, path);
+        pending_queue_remove(&folder->files_to_del, l);
+        fm_file_info_list_delete_link_nounref(folder->files, l);
+        files_removed = g_slist_prepend(files_removed, fi);
+    }
+    G_UNLOCK(lists);
+    g_hash_table_destroy(listed);
+
+    /* add new files and update changed ones */
+    for(l = fm_file_info_list_peek_head_link(job->files); l; l = l->next)
+    {
+        FmFileInfo* fi = (FmFileInfo*)l->data;
+        FmPath* path = fm_file_info_get_path(fi);
+        GList* l2 = _fm_folder_get_file_by_path(folder, path);
+        gboolean defer = folder->defer_content_test && fm_path_is_native(path);
+        gboolean skip;
+
+        G_LOCK(lists);
+        skip = refresh_skips_file(folder, path);
+        G_UNLOCK(lists);
+        if(skip)
+            continue;
+        if(l2 == NULL)
+        {
+            files_push_tail(folder, fi);
+            files_added = g_slist_prepend(files_added, fi);
+            if(!defer)
+                continue;
+        }
+        else if(_fm_file_info_is_unchanged(l2->data, fi))
+            continue;
+        else if(!defer)
+        {
+            fm_file_info_update(l2->data, fi);
+            files_changed = g_slist_prepend(files_changed, l2->data);
+            continue;
+        }
+        /* we got only basic info on content, schedule update it */
+        files_to_test = g_slist_prepend(files_to_test, fi);
+    }
+
+    if(job->dir_fi)
+        fm_file_info_update(folder->dir_fi, job->dir_fi);
+
+    if(files_removed)
+    {
+        g_signal_emit(folder, signals[FILES_REMOVED], 0, files_removed);
+        g_slist_foreach(files_removed, (GFunc)fm_file_info_unref, NULL);
+        g_slist_free(files_removed);
+    }
+    if(files_added)
+    {
+        files_added = g_slist_reverse(files_added);
+        g_signal_emit(folder, signals[FILES_ADDED], 0, files_added);
+        g_slist_free(files_added);
+    }
+    if(files_changed)
+    {
+        g_signal_emit(folder, signals[FILES_CHANGED], 0, files_changed);
+        g_slist_free(files_changed);
+    }
+    if(files_removed || files_added || files_changed)
+        g_signal_emit(folder, signals[CONTENT_CHANGED], 0);
+    if(files_to_test)
+    {
+        queue_content_tests(folder, files_to_test);
+        g_slist_free(files_to_test);
+    }
+
+_finish:
+    g_signal_handlers_disconnect_by_func(job, on_refresh_job_error, folder);
+    g_object_unref(folder->refresh_job);
+    folder->refresh_job = NULL;
+    G_LOCK(lists);
+    g_hash_table_destroy(folder->refresh_touched);
+    folder->refresh_touched = NULL;
+    G_UNLOCK(lists);
+}
+
 static FmFolder* fm_folder_new_internal(FmPath* path, GFile* gf)
 {
     FmFolder* folder = (FmFolder*)g_object_new(FM_TYPE_FOLDER, NULL);
@@ -851,6 +1340,69 @@ static FmFolder* fm_folder_new_internal(FmPath* path, GFile* gf)
     return folder;
 }
 
+/* should be called only with G_LOCK(cache) on! */
+static inline void cache_remove(FmFolder* folder)
+{
+    g_queue_delete_link(&cache_lru, folder->cache_link);
+    folder->cache_link = NULL;
+    cache_bytes -= folder->cache_size;
+}
+
+/* should be called only with G_LOCK(cache) on! returns list of folders
+   which should be released with release_evicted() after unlocking */
+static GSList* cache_trim(void)
+{
+    GSList* evicted = NULL;
+
+    while (cache_lru.length > 0 &&
+           (cache_lru.length > cache_max_folders ||
+            (cache_max_bytes > 0 && cache_bytes > cache_max_bytes)))
+    {
+        FmFolder* folder = g_queue_peek_tail(&cache_lru);
+        cache_remove(folder);
+        evicted = g_slist_prepend(evicted, folder);
+    }
+    return evicted;
+}
+
+static void on_folder_toggle_ref(gpointer data, GObject* object, gboolean is_last_ref);
+
+static void release_evicted(GSList* evicted)
+{
+    GSList* l;
+
+    /* this drops the last reference so folders will be disposed */
+    for (l = evicted; l; l = l->next)
+        g_object_remove_toggle_ref(l->data, on_folder_toggle_ref, NULL);
+    g_slist_free(evicted);
+}
+
+/* the cache holds a toggle reference on each folder created while cache
+   is enabled, when that reference becomes the only one the folder is
+   added to LRU list instead of being disposed; users get folders from the
+   cache by fm_folder_get_internal() or fm_folder_find_by_path() which
+   take it out of the list, other references are internal ones (idle
+   handlers, jobs, signal emission) and don't change its place in list */
+static void on_folder_toggle_ref(gpointer data, GObject* object, gboolean is_last_ref)
+{
+    FmFolder* folder = (FmFolder*)object;
+    GSList* evicted = NULL;
+
+    G_LOCK(cache);
+    if (is_last_ref && folder->cache_link == NULL)
+    {
+        g_queue_push_head(&cache_lru, folder);
+        folder->cache_link = cache_lru.head;
+        folder->cache_size = sizeof(FmFolder) + FOLDER_CACHE_FILE_SIZE
+                             * fm_file_info_list_get_length(folder->files);
+        cache_bytes += folder->cache_size;
+        /* if cache is disabled then the folder is evicted at once */
+        evicted = cache_trim();
+    }
+    G_UNLOCK(cache);
+    release_evicted(evicted);
+}
+
 /* NB: increases reference on returned object */
 static FmFolder* fm_folder_get_internal(FmPath* path, GFile* gf)
 {
@@ -873,9 +1425,25 @@ static FmFolder* fm_folder_get_internal(FmPath* path, GFile* gf)
             g_object_unref(_gf);
         G_LOCK(hash);
         g_hash_table_insert(hash, folder->dir_path, folder);
+        G_UNLOCK(hash);
+        G_LOCK(cache);
+        if(cache_max_folders > 0)
+        {
+            cache_misses++;
+            g_object_add_toggle_ref(G_OBJECT(folder), on_folder_toggle_ref, NULL);
+        }
+        G_UNLOCK(cache);
+        return folder;
     }
-    else
-        g_object_ref(folder);
+    G_LOCK(cache);
+    if(folder->cache_link)
+    {
+        /* remove it now, the toggle notification will not find it */
+        cache_remove(folder);
+        cache_hits++;
+    }
+    G_UNLOCK(cache);
+    g_object_ref(folder);
     G_UNLOCK(hash);
     return folder;
 }
@@ -891,6 +1459,19 @@ static void free_dirlist_job(FmFolder* folder)
     folder->dirlist_job = NULL;
 }
 
+static void free_refresh_job(FmFolder* folder)
+{
+    g_signal_handlers_disconnect_by_func(folder->refresh_job, on_refresh_job_finished, folder);
+    g_signal_handlers_disconnect_by_func(folder->refresh_job, on_refresh_job_error, folder);
+    fm_job_cancel(FM_JOB(folder->refresh_job));
+    g_object_unref(folder->refresh_job);
+    folder->refresh_job = NULL;
+    G_LOCK(lists);
+    g_hash_table_destroy(folder->refresh_touched);
+    folder->refresh_touched = NULL;
+    G_UNLOCK(lists);
+}
+
 static void fm_folder_dispose(GObject *object)
 {
     FmFolder *folder;
@@ -903,6 +1484,8 @@ static void fm_folder_dispose(GObject *object)
 
     if(folder->dirlist_job)
         free_dirlist_job(folder);
+    if(folder->refresh_job)
+        free_refresh_job(folder);
 
     if(folder->pending_jobs)
     {
@@ -917,6 +1500,7 @@ static void fm_folder_dispose(GObject *object)
         g_slist_free(folder->pending_jobs);
         folder->pending_jobs = NULL;
     }
+    cancel_test_jobs(folder);
 
     if(folder->mon)
     {
@@ -947,24 +1531,14 @@ static void fm_folder_dispose(GObject *object)
         /* FIXME: it should be impossible, folder should be referenced if handler added */
         g_source_remove(folder->idle_handler);
         folder->idle_handler = 0;
-        if(folder->files_to_add)
-        {
-            g_slist_foreach(folder->files_to_add, (GFunc)fm_path_unref, NULL);
-            g_slist_free(folder->files_to_add);
-            folder->files_to_add = NULL;
-        }
-        if(folder->files_to_update)
-        {
-            g_slist_foreach(folder->files_to_update, (GFunc)fm_path_unref, NULL);
-            g_slist_free(folder->files_to_update);
-            folder->files_to_update = NULL;
-        }
-        if(folder->files_to_del)
-        {
-            g_slist_free(folder->files_to_del);
-            folder->files_to_del = NULL;
-        }
     }
+    /* callbacks already queued may still look up files or push paths, so
+       the indexes are only emptied here and destroyed in finalize */
+    pending_queue_clear(&folder->files_to_add, (GDestroyNotify)fm_path_unref);
+    pending_queue_clear(&folder->files_to_update, (GDestroyNotify)fm_path_unref);
+    pending_queue_clear(&folder->files_to_del, NULL);
+    pending_queue_clear(&folder->files_to_test, (GDestroyNotify)fm_path_unref);
+    g_hash_table_remove_all(folder->files_hash);
     G_UNLOCK(lists);
 
     /* remove from hash table */
@@ -1000,6 +1574,14 @@ static void fm_folder_dispose(GObject *object)
 
 static void fm_folder_finalize(GObject *object)
 {
+    FmFolder* folder = FM_FOLDER(object);
+
+    pending_queue_destroy(&folder->files_to_add, (GDestroyNotify)fm_path_unref);
+    pending_queue_destroy(&folder->files_to_update, (GDestroyNotify)fm_path_unref);
+    pending_queue_destroy(&folder->files_to_del, NULL);
+    pending_queue_destroy(&folder->files_to_test, (GDestroyNotify)fm_path_unref);
+    g_hash_table_destroy(folder->files_hash);
+
     G_LOCK(hash);
     hash_uses--;
     if (G_UNLIKELY(hash_uses == 0))
@@ -1093,6 +1675,28 @@ FmFolder*    fm_folder_from_uri    (const char* uri)
     return folder;
 }
 
+static void restart_monitor(FmFolder* folder)
+{
+    GError* err = NULL;
+
+    if(folder->mon)
+    {
+        g_signal_handlers_disconnect_by_func(folder->mon, on_folder_changed, folder);
+        g_object_unref(folder->mon);
+    }
+    folder->mon = fm_monitor_directory(folder->gf, &err);
+    if(folder->mon)
+    {
+        g_signal_connect(folder->mon, "changed", G_CALLBACK(on_folder_changed), folder);
+    }
+    else
+    {
+        g_debug("file monitor cannot be created: %s", err->message);
+        g_error_free(err);
+        folder->mon = NULL;
+    }
+}
+
 /**
  * fm_folder_reload
  * @folder: folder to be reloaded
@@ -1104,8 +1708,6 @@ FmFolder*    fm_folder_from_uri    (const char* uri)
  */
 void fm_folder_reload(FmFolder* folder)
 {
-    GError* err = NULL;
-
     /* Tell the world that we're about to reload the folder.
      * It might be a good idea for users of the folder to disconnect
      * from the folder temporarily and reconnect to it again after
@@ -1122,28 +1724,18 @@ void fm_folder_reload(FmFolder* folder)
 
     /* clear all update-lists now, see SF bug #919 - if update comes before
        listing job is finished, a duplicate may be created in the folder */
+    G_LOCK(lists);
     if (folder->idle_handler)
     {
         g_source_remove(folder->idle_handler);
         folder->idle_handler = 0;
-        if (folder->files_to_add)
-        {
-            g_slist_foreach(folder->files_to_add, (GFunc)fm_path_unref, NULL);
-            g_slist_free(folder->files_to_add);
-            folder->files_to_add = NULL;
-        }
-        if (folder->files_to_update)
-        {
-            g_slist_foreach(folder->files_to_update, (GFunc)fm_path_unref, NULL);
-            g_slist_free(folder->files_to_update);
-            folder->files_to_update = NULL;
-        }
-        if (folder->files_to_del)
-        {
-            g_slist_free(folder->files_to_del);
-            folder->files_to_del = NULL;
-        }
     }
+    pending_queue_clear(&folder->files_to_add, (GDestroyNotify)fm_path_unref);
+    pending_queue_clear(&folder->files_to_update, (GDestroyNotify)fm_path_unref);
+    pending_queue_clear(&folder->files_to_del, NULL);
+    G_UNLOCK(lists);
+    cancel_test_jobs(folder);
+    pending_queue_clear(&folder->files_to_test, (GDestroyNotify)fm_path_unref);
 
     /* remove all items and re-run a dir list job. */
     GList* l = fm_file_info_list_peek_head_link(folder->files);
@@ -1151,6 +1743,8 @@ void fm_folder_reload(FmFolder* folder)
     /* cancel running dir listing job if there is any. */
     if(folder->dirlist_job)
         free_dirlist_job(folder);
+    if(folder->refresh_job)
+        free_refresh_job(folder);
 
     /* remove all existing files */
     if(l)
@@ -1164,26 +1758,14 @@ void fm_folder_reload(FmFolder* folder)
             g_signal_emit(folder, signals[FILES_REMOVED], 0, files_to_del);
             g_slist_free(files_to_del);
         }
+        G_LOCK(lists);
+        g_hash_table_remove_all(folder->files_hash);
+        G_UNLOCK(lists);
         fm_file_info_list_clear(folder->files); /* fm_file_info_unref will be invoked. */
     }
 
     /* also re-create a new file monitor */
-    if(folder->mon)
-    {
-        g_signal_handlers_disconnect_by_func(folder->mon, on_folder_changed, folder);
-        g_object_unref(folder->mon);
-    }
-    folder->mon = fm_monitor_directory(folder->gf, &err);
-    if(folder->mon)
-    {
-        g_signal_connect(folder->mon, "changed", G_CALLBACK(on_folder_changed), folder);
-    }
-    else
-    {
-        g_debug("file monitor cannot be created: %s", err->message);
-        g_error_free(err);
-        folder->mon = NULL;
-    }
+    restart_monitor(folder);
 
     g_signal_emit(folder, signals[CONTENT_CHANGED], 0);
 
@@ -1191,6 +1773,7 @@ void fm_folder_reload(FmFolder* folder)
     folder->defer_content_test = fm_config->defer_content_test;
     folder->dirlist_job = fm_dir_list_job_new2(folder->dir_path,
             folder->defer_content_test ? FM_DIR_LIST_JOB_FAST : FM_DIR_LIST_JOB_DETAILED);
+    fm_dir_list_job_set_attributes(folder->dirlist_job, FOLDER_FILE_ATTRS);
 
     g_signal_connect(folder->dirlist_job, "finished", G_CALLBACK(on_dirlist_job_finished), folder);
     if(folder->wants_incremental)
@@ -1209,6 +1792,58 @@ void fm_folder_reload(FmFolder* folder)
     fm_folder_query_filesystem_info(folder);
 }
 
+/**
+ * fm_folder_refresh
+ * @folder: folder to be refreshed
+ *
+ * Retrieves all data for the @folder again and compares it with files
+ * which are already in the @folder. Unlike fm_folder_reload() the files
+ * are not removed from the @folder first, instead only signals for files
+ * which were actually added, removed, or changed are sent. Files are
+ * compared by name, type, inode, size, and modification time. The
+ * #FmFolder::start-loading and #FmFolder::finish-loading signals are not
+ * sent by this call, and fm_folder_is_loaded() remains %TRUE.
+ *
+ * If @folder is not loaded yet or is incremental then this call is the
+ * same as fm_folder_reload().
+ *
+ * Since: 1.3.2
+ */
+void fm_folder_refresh(FmFolder* folder)
+{
+    g_return_if_fail(FM_IS_FOLDER(folder));
+
+    if(folder->dirlist_job || folder->wants_incremental || !fm_folder_is_valid(folder))
+    {
+        fm_folder_reload(folder);
+        return;
+    }
+    if(folder->refresh_job)
+        free_refresh_job(folder);
+
+    /* the monitor might be lost after unmount or overflow */
+    restart_monitor(folder);
+
+    folder->defer_content_test = fm_config->defer_content_test;
+    folder->refresh_job = fm_dir_list_job_new2(folder->dir_path,
+            folder->defer_content_test ? FM_DIR_LIST_JOB_FAST : FM_DIR_LIST_JOB_DETAILED);
+    fm_dir_list_job_set_attributes(folder->refresh_job, FOLDER_FILE_ATTRS);
+    folder->refresh_failed = FALSE;
+    G_LOCK(lists);
+    folder->refresh_touched = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                    (GDestroyNotify)fm_path_unref, NULL);
+    G_UNLOCK(lists);
+    g_signal_connect(folder->refresh_job, "finished", G_CALLBACK(on_refresh_job_finished), folder);
+    g_signal_connect(folder->refresh_job, "error", G_CALLBACK(on_refresh_job_error), folder);
+    if (!fm_job_run_async(FM_JOB(folder->refresh_job)))
+    {
+        free_refresh_job(folder);
+        g_critical("failed to start directory listing job for the folder");
+    }
+
+    fm_folder_query_filesystem_info(folder);
+}
+
 /**
  * fm_folder_get_files
  * @folder: folder to retrieve file list
@@ -1276,17 +1911,10 @@ FmPath* fm_folder_get_path(FmFolder* folder)
     return folder->dir_path;
 }
 
+/* should be called either from main thread or with G_LOCK(lists) on */
 static GList* _fm_folder_get_file_by_path(FmFolder* folder, FmPath *path)
 {
-    GList* l = fm_file_info_list_peek_head_link(folder->files);
-    for(;l;l=l->next)
-    {
-        FmFileInfo* fi = (FmFileInfo*)l->data;
-        FmPath* lpath = fm_file_info_get_path(fi);
-        if(lpath == path)
-            return l;
-    }
-    return NULL;
+    return (GList*)g_hash_table_lookup(folder->files_hash, path);
 }
 
 /**
@@ -1504,8 +2132,16 @@ FmFolder *fm_folder_find_by_path(FmPath *path)
 
     G_LOCK(hash);
     folder = hash ? (FmFolder*)g_hash_table_lookup(hash, path) : NULL;
+    if (folder)
+    {
+        G_LOCK(cache);
+        if (folder->cache_link) /* it's used again */
+            cache_remove(folder);
+        G_UNLOCK(cache);
+        g_object_ref(folder);
+    }
     G_UNLOCK(hash);
-    return folder ? g_object_ref(folder) : NULL;
+    return folder;
 }
 
 /**
@@ -1542,12 +2178,85 @@ void fm_folder_unblock_updates(FmFolder *folder)
     /* g_debug("fm_folder_unblock_updates %p", folder); */
     G_LOCK(lists);
     folder->stop_emission = FALSE;
-    /* query update now */
-    queue_update(folder);
+    /* query update now, changes were delayed already */
+    if (!folder->idle_handler)
+    {
+        folder->update_flushing = TRUE;
+        /* borrow reference on folder */
+        folder->idle_handler = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)on_idle,
+                                               g_object_ref(folder), NULL);
+    }
     G_UNLOCK(lists);
     /* g_debug("fm_folder_unblock_updates OK"); */
 }
 
+/**
+ * fm_folder_prioritize_files
+ * @folder: folder to apply
+ * @files: (element-type FmFileInfo): files to test first
+ *
+ * If content tests of files in @folder are deferred (see
+ * #FmConfig:defer_content_test) then moves @files to the head of queue
+ * of tests, in the same order, so files visible to the user get their
+ * actual types and icons first. By default files are tested in order of
+ * their names, directories first. Files which were tested already are
+ * ignored. Jobs which test files of @folder are also raised to the
+ * %FM_JOB_PRIORITY_INTERACTIVE class, see fm_job_set_priority().
+ *
+ * This API should be called only from the main thread.
+ *
+ * Since: 1.3.2
+ */
+void fm_folder_prioritize_files(FmFolder *folder, GSList *files)
+{
+    GSList *l;
+
+    g_return_if_fail(FM_IS_FOLDER(folder));
+
+    /* folder is visible so don't let its tests wait after other folders */
+    folder->test_priority = FM_JOB_PRIORITY_INTERACTIVE;
+    for (l = folder->test_jobs; l; l = l->next)
+        fm_job_set_priority(l->data, FM_JOB_PRIORITY_INTERACTIVE);
+    if (g_queue_is_empty(&folder->files_to_test.items))
+        return;
+    /* raise them in reverse order so the first one ends at head */
+    files = g_slist_reverse(g_slist_copy(files));
+    for (l = files; l; l = l->next)
+        pending_queue_raise(&folder->files_to_test,
+                            fm_file_info_get_path(l->data));
+    g_slist_free(files);
+}
+
+/**
+ * fm_folder_set_update_policy
+ * @folder: folder to apply
+ * @debounce: time in milliseconds to wait for more changes after last one
+ * @max_latency: maximum time in milliseconds to delay any change
+ * @max_batch: number of pending changes to apply without waiting
+ *
+ * Sets how changes in @folder reported by file monitor are coalesced
+ * before signals are sent. Changes are collected until there are none
+ * in @debounce milliseconds, but not longer than @max_latency milliseconds
+ * after the first one, or until @max_batch changes are pending. All info
+ * about files changed in that time is retrieved by one job, repeated
+ * changes of the same file are applied once, and if a file was created
+ * and deleted then nothing is sent at all. If @debounce is 0 then changes
+ * are applied as soon as main loop is idle.
+ *
+ * Since: 1.3.2
+ */
+void fm_folder_set_update_policy(FmFolder *folder, guint debounce,
+                                 guint max_latency, guint max_batch)
+{
+    g_return_if_fail(FM_IS_FOLDER(folder));
+
+    G_LOCK(lists);
+    folder->update_debounce = debounce;
+    folder->update_max_latency = MAX(max_latency, debounce);
+    folder->update_max_batch = MAX(max_batch, 1);
+    G_UNLOCK(lists);
+}
+
 /**
  * fm_folder_make_directory
  * @folder: folder to apply
@@ -1611,6 +2320,7 @@ static void on_mount_added(GVolumeMonitor* vm, GMount* mount, gpointer user_data
 
     GFile* gfile = g_mount_get_root(mount);
     /* g_debug("FmFolder::mount_added"); */
+    _fm_file_info_reset_fs_cache();
     if(gfile)
     {
         GHashTableIter it;
@@ -1651,6 +2361,7 @@ static void on_mount_removed(GVolumeMonitor* vm, GMount* mount, gpointer user_da
      * We need to generate the signal ourselves. */
 
     GFile* gfile = g_mount_get_root(mount);
+    _fm_file_info_reset_fs_cache();
     if(gfile)
     {
         GSList* dummy_monitor_folders = NULL, *l;
@@ -1688,10 +2399,63 @@ static void on_mount_removed(GVolumeMonitor* vm, GMount* mount, gpointer user_da
     }
 }
 
+/**
+ * fm_folder_set_cache_limits
+ * @max_folders: maximum number of unused folders to keep, 0 to disable cache
+ * @max_bytes: approximate limit of memory used by kept folders, 0 for no limit
+ *
+ * Sets limits of cache of recently released folders. If cache is enabled
+ * then folders opened after this call aren't destroyed when the last
+ * reference on them is dropped. Instead they are kept loaded and
+ * monitored, so next call to fm_folder_from_path() for the same path
+ * returns them immediately. The least recently released folders are
+ * destroyed when any of limits is exceeded. The cache is disabled by
+ * default.
+ *
+ * Since: 1.3.2
+ */
+void fm_folder_set_cache_limits(guint max_folders, gsize max_bytes)
+{
+    GSList* evicted;
+
+    G_LOCK(cache);
+    cache_max_folders = max_folders;
+    cache_max_bytes = max_bytes;
+    evicted = cache_trim();
+    G_UNLOCK(cache);
+    release_evicted(evicted);
+}
+
+/**
+ * fm_folder_get_cache_stats
+ * @hits: (out) (allow-none): location to store number of folders found in cache
+ * @misses: (out) (allow-none): location to store number of folders created
+ * while cache was enabled
+ * @n_cached: (out) (allow-none): location to store number of folders
+ * currently kept in cache
+ *
+ * Retrieves statistics of cache of recently released folders.
+ *
+ * Since: 1.3.2
+ */
+void fm_folder_get_cache_stats(guint* hits, guint* misses, guint* n_cached)
+{
+    G_LOCK(cache);
+    if (hits)
+        *hits = cache_hits;
+    if (misses)
+        *misses = cache_misses;
+    if (n_cached)
+        *n_cached = cache_lru.length;
+    G_UNLOCK(cache);
+}
+
 void _fm_folder_init()
 {
 }
 
 void _fm_folder_finalize()
 {
+    /* release all cached folders */
+    fm_folder_set_cache_limits(0, 0);
 }
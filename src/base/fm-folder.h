@@ -107,6 +107,7 @@ gboolean fm_folder_is_valid(FmFolder* folder);
 gboolean fm_folder_is_incremental(FmFolder* folder);
 
 void fm_folder_reload(FmFolder* folder);
+void fm_folder_refresh(FmFolder* folder);
 
 gboolean fm_folder_get_filesystem_info(FmFolder* folder, guint64* total_size, guint64* free_size);
 void fm_folder_query_filesystem_info(FmFolder* folder);
@@ -118,6 +119,14 @@ void _fm_folder_event_file_deleted(FmFolder *folder, FmPath *path);
 
 gboolean fm_folder_make_directory(FmFolder *folder, const char *name, GError **error);
 
+void fm_folder_set_update_policy(FmFolder *folder, guint debounce,
+                                 guint max_latency, guint max_batch);
+
+void fm_folder_prioritize_files(FmFolder *folder, GSList *files);
+
+void fm_folder_set_cache_limits(guint max_folders, gsize max_bytes);
+void fm_folder_get_cache_stats(guint *hits, guint *misses, guint *n_cached);
+
 void _fm_folder_init();
 void _fm_folder_finalize();
 
@@ -36,6 +36,8 @@
 #endif
 
 #include "fm-mime-type.h"
+#include "fm-record-cache.h"
+#include "glib-compat.h"
 
 #include <glib/gi18n-lib.h>
 #include <sys/types.h>
@@ -73,6 +75,8 @@ static FmMimeType* shortcut_type = NULL;
 static FmMimeType* desktop_entry_type = NULL;
 
 static FmMimeType* fm_mime_type_new(const char* type_name);
+static void sniff_cache_finalize(void);
+static void glob_tables_finalize(void);
 
 void _fm_mime_type_init()
 {
@@ -91,6 +95,8 @@ void _fm_mime_type_init()
 
 void _fm_mime_type_finalize()
 {
+    sniff_cache_finalize();
+    glob_tables_finalize();
     fm_mime_type_unref(directory_type);
     fm_mime_type_unref(shortcut_type);
     fm_mime_type_unref(mountable_type);
@@ -98,6 +104,481 @@ void _fm_mime_type_finalize()
     g_hash_table_destroy(mime_hash);
 }
 
+/* Table of globs from shared-mime-info for fast guessing by file name.
+ * Globs are loaded from mime/globs2 files of all XDG data dirs and are
+ * split into literal names, simple suffixes like "*.png", and complex
+ * patterns. Lookup of pure ASCII name is few hash probes without any
+ * allocation. Result is used only if globs of exactly one type match the
+ * name, otherwise g_content_type_guess() is asked, so results are the same
+ * as from GIO. As GIO does, the mime database files are checked for
+ * changes at most every 5 seconds and the tables are loaded again if any
+ * of them was changed. */
+#define GLOB_MAX_NAME 256 /* longer names are passed to GIO */
+#define GLOB_MAX_SUFFIX 63 /* longer suffixes are treated as complex globs */
+#define GLOB_CHECK_INTERVAL 5 /* seconds */
+
+typedef struct
+{
+    char *name;
+    FmMimeType *mime_type; /* resolved on first use */
+} GlobType;
+
+typedef struct
+{
+    GPatternSpec *pspec;
+    GlobType *type;
+    gboolean cs : 1; /* case-sensitive */
+    gboolean inexact : 1; /* pspec matches more than the glob */
+} GlobComplex;
+
+typedef struct
+{
+    GHashTable *types; /* name -> GlobType */
+    GHashTable *literals; /* lower case name -> GlobType */
+    GHashTable *literals_cs;
+    GHashTable *suffixes; /* lower case suffix -> GlobType */
+    GHashTable *suffixes_cs;
+    guint64 suffix_lengths; /* bit for each length of suffixes */
+    GPtrArray *complex; /* GlobComplex */
+    GlobType *unknown;
+} GlobTables;
+
+/* state of a mime database file when tables were loaded */
+typedef struct
+{
+    char *path;
+    time_t mtime; /* -1 if file didn't exist */
+    off_t size;
+} GlobFile;
+
+G_LOCK_DEFINE_STATIC(globs);
+static GlobTables *globs = NULL;
+static volatile gint globs_loaded = FALSE;
+/* tables replaced by reload, other threads may still use them */
+static GSList *globs_retired = NULL;
+static GArray *glob_files = NULL; /* GlobFile */
+static volatile gint globs_checked = 0; /* monotonic time in seconds */
+/* marks a glob used by more than one type */
+static GlobType glob_ambiguous;
+
+static void glob_type_free(gpointer data)
+{
+    GlobType *type = data;
+
+    if (type->mime_type)
+        fm_mime_type_unref(type->mime_type);
+    g_free(type->name);
+    g_slice_free(GlobType, type);
+}
+
+static void glob_complex_free(gpointer data)
+{
+    GlobComplex *glob = data;
+
+    g_pattern_spec_free(glob->pspec);
+    g_slice_free(GlobComplex, glob);
+}
+
+static GlobType *glob_type_get(GlobTables *g, const char *name)
+{
+    GlobType *type = g_hash_table_lookup(g->types, name);
+
+    if (type == NULL)
+    {
+        type = g_slice_new0(GlobType);
+        type->name = g_strdup(name);
+        g_hash_table_insert(g->types, type->name, type);
+    }
+    return type;
+}
+
+static void glob_table_insert(GHashTable *table, const char *key, GlobType *type)
+{
+    GlobType *old = g_hash_table_lookup(table, key);
+
+    if (old != NULL && old != type)
+        type = &glob_ambiguous;
+    g_hash_table_replace(table, g_strdup(key), type);
+}
+
+/* GPatternSpec supports only '*' and '?' so replace each [...] and escaped
+   char with '?', that pattern matches everything the glob does and more */
+static char *glob_relax_pattern(const char *glob, gboolean *inexact)
+{
+    GString *str = g_string_sized_new(strlen(glob));
+
+    *inexact = FALSE;
+    while (*glob)
+    {
+        if (*glob == '\\' && glob[1])
+        {
+            glob += 2;
+            g_string_append_c(str, '?');
+            *inexact = TRUE;
+        }
+        else if (*glob == '[')
+        {
+            const char *set = glob + 1;
+            const char *end;
+
+            if (*set == '!' || *set == '^')
+                set++;
+            /* ']' right after '[' is a part of the set */
+            end = *set ? strchr(set + 1, ']') : NULL;
+            if (end == NULL) /* not a set, just a char */
+                g_string_append_c(str, *glob++);
+            else
+            {
+                glob = end + 1;
+                g_string_append_c(str, '?');
+                *inexact = TRUE;
+            }
+        }
+        else
+            g_string_append_c(str, *glob++);
+    }
+    return g_string_free(str, FALSE);
+}
+
+static void glob_tables_add(GlobTables *g, const char *type_name,
+                            const char *glob, gboolean cs)
+{
+    GlobType *type = glob_type_get(g, type_name);
+    char *key = cs ? g_strdup(glob) : g_ascii_strdown(glob, -1);
+    gsize len = strlen(key);
+
+    if (strpbrk(key, "*?[\\") == NULL)
+        glob_table_insert(cs ? g->literals_cs : g->literals, key, type);
+    else if (key[0] == '*' && len > 1 && len <= GLOB_MAX_SUFFIX + 1 &&
+             strpbrk(key + 1, "*?[\\") == NULL)
+    {
+        glob_table_insert(cs ? g->suffixes_cs : g->suffixes, key + 1, type);
+        g->suffix_lengths |= G_GUINT64_CONSTANT(1) << (len - 1);
+    }
+    else
+    {
+        GlobComplex *complex = g_slice_new(GlobComplex);
+        gboolean inexact;
+        char *pattern = glob_relax_pattern(key, &inexact);
+
+        complex->pspec = g_pattern_spec_new(pattern);
+        complex->type = type;
+        complex->cs = cs;
+        complex->inexact = inexact;
+        g_ptr_array_add(g->complex, complex);
+        g_free(pattern);
+    }
+    g_free(key);
+}
+
+static gboolean glob_has_type(gpointer key, gpointer value, gpointer type)
+{
+    return value == type;
+}
+
+/* handles __NOGLOBS__: drops globs of the type loaded from other dirs */
+static void glob_tables_remove_type(GlobTables *g, const char *type_name)
+{
+    GlobType *type = g_hash_table_lookup(g->types, type_name);
+    guint i;
+
+    if (type == NULL)
+        return;
+    g_hash_table_foreach_remove(g->literals, glob_has_type, type);
+    g_hash_table_foreach_remove(g->literals_cs, glob_has_type, type);
+    g_hash_table_foreach_remove(g->suffixes, glob_has_type, type);
+    g_hash_table_foreach_remove(g->suffixes_cs, glob_has_type, type);
+    for (i = 0; i < g->complex->len; )
+        if (((GlobComplex*)g_ptr_array_index(g->complex, i))->type == type)
+            g_ptr_array_remove_index(g->complex, i);
+        else
+            i++;
+}
+
+/* loads globs2 file from mime/ subdir of @data_dir */
+static void glob_tables_load_dir(GlobTables *g, const char *data_dir)
+{
+    char *path = g_build_filename(data_dir, "mime", "globs2", NULL);
+    char *contents;
+    char **lines, **line;
+
+    if (!g_file_get_contents(path, &contents, NULL, NULL))
+    {
+        g_free(path);
+        return;
+    }
+    g_free(path);
+    lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+    /* lines are "weight:type:glob[:flags[:...]]" */
+    for (line = lines; *line; line++)
+        if (**line != '#' && strstr(*line, ":__NOGLOBS__") != NULL)
+        {
+            char **fields = g_strsplit(*line, ":", 4);
+            if (g_strv_length(fields) >= 3 && strcmp(fields[2], "__NOGLOBS__") == 0)
+                glob_tables_remove_type(g, fields[1]);
+            g_strfreev(fields);
+        }
+    for (line = lines; *line; line++)
+    {
+        char **fields;
+
+        if (**line == '#' || **line == '\0')
+            continue;
+        fields = g_strsplit(*line, ":", 5);
+        if (g_strv_length(fields) >= 3 && fields[2][0] != '\0' &&
+            strcmp(fields[2], "__NOGLOBS__") != 0)
+        {
+            gboolean cs = FALSE;
+            if (fields[3] != NULL)
+            {
+                char **flags = g_strsplit(fields[3], ",", -1);
+                char **flag;
+                for (flag = flags; *flag; flag++)
+                    if (strcmp(*flag, "cs") == 0)
+                        cs = TRUE;
+                g_strfreev(flags);
+            }
+            glob_tables_add(g, fields[1], fields[2], cs);
+        }
+        g_strfreev(fields);
+    }
+    g_strfreev(lines);
+}
+
+/* update-mime-database keeps only one of the same globs with and without
+   "cs" flag, so names matching such globs are left to GIO */
+static void glob_mark_cs_conflicts(GHashTable *table, GHashTable *table_cs)
+{
+    GHashTableIter it;
+    gpointer key;
+    GSList *keys = NULL, *l;
+
+    g_hash_table_iter_init(&it, table);
+    while (g_hash_table_iter_next(&it, &key, NULL))
+        if (g_hash_table_lookup(table_cs, key))
+            keys = g_slist_prepend(keys, key);
+    for (l = keys; l; l = l->next)
+        g_hash_table_insert(table, g_strdup(l->data), &glob_ambiguous);
+    g_slist_free(keys);
+}
+
+static void glob_tables_free(GlobTables *g)
+{
+    g_hash_table_destroy(g->literals);
+    g_hash_table_destroy(g->literals_cs);
+    g_hash_table_destroy(g->suffixes);
+    g_hash_table_destroy(g->suffixes_cs);
+    g_ptr_array_free(g->complex, TRUE);
+    g_hash_table_destroy(g->types);
+    g_slice_free(GlobTables, g);
+}
+
+static void glob_file_stat(GlobFile *file)
+{
+    struct stat st;
+
+    if (stat(file->path, &st) == 0)
+    {
+        file->mtime = st.st_mtime;
+        file->size = st.st_size;
+    }
+    else
+    {
+        file->mtime = -1;
+        file->size = 0;
+    }
+}
+
+/* remembers state of mime database files of @data_dir, it should be
+   done before reading them so any later change is noticed */
+static void glob_files_add_dir(const char *data_dir)
+{
+    static const char *names[] = { "mime.cache", "globs2" };
+    GlobFile file;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(names); i++)
+    {
+        file.path = g_build_filename(data_dir, "mime", names[i], NULL);
+        glob_file_stat(&file);
+        g_array_append_val(glob_files, file);
+    }
+}
+
+static void glob_files_free(void)
+{
+    guint i;
+
+    if (glob_files == NULL)
+        return;
+    for (i = 0; i < glob_files->len; i++)
+        g_free(g_array_index(glob_files, GlobFile, i).path);
+    g_array_free(glob_files, TRUE);
+    glob_files = NULL;
+}
+
+/* should be called with lock held */
+static gboolean glob_files_changed(void)
+{
+    guint i;
+
+    for (i = 0; i < glob_files->len; i++)
+    {
+        GlobFile *file = &g_array_index(glob_files, GlobFile, i);
+        GlobFile now = *file;
+
+        glob_file_stat(&now);
+        if (now.mtime != file->mtime || now.size != file->size)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* should be called with lock held */
+static GlobTables *glob_tables_load(void)
+{
+    const gchar * const *dirs = g_get_system_data_dirs();
+    GlobTables *g = g_slice_new0(GlobTables);
+    int i;
+
+    glob_files_free();
+    glob_files = g_array_new(FALSE, FALSE, sizeof(GlobFile));
+
+    g->types = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, glob_type_free);
+    g->literals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g->literals_cs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g->suffixes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g->suffixes_cs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g->complex = g_ptr_array_new_with_free_func(glob_complex_free);
+    /* dirs with lower priority first */
+    for (i = g_strv_length((char**)dirs) - 1; i >= 0; i--)
+    {
+        glob_files_add_dir(dirs[i]);
+        glob_tables_load_dir(g, dirs[i]);
+    }
+    glob_files_add_dir(g_get_user_data_dir());
+    glob_tables_load_dir(g, g_get_user_data_dir());
+    glob_mark_cs_conflicts(g->literals, g->literals_cs);
+    glob_mark_cs_conflicts(g->suffixes, g->suffixes_cs);
+    g->unknown = glob_type_get(g, "application/octet-stream");
+    if (g_hash_table_size(g->types) == 1) /* no globs found */
+    {
+        g_debug("no shared-mime-info globs found, using GIO only");
+        glob_tables_free(g);
+        return NULL;
+    }
+    return g;
+}
+
+static GlobTables *glob_tables_get(void)
+{
+    gint now = (gint)(g_get_monotonic_time() / G_USEC_PER_SEC);
+
+    if (G_UNLIKELY(!g_atomic_int_get(&globs_loaded) ||
+                   now - g_atomic_int_get(&globs_checked) >= GLOB_CHECK_INTERVAL))
+    {
+        G_LOCK(globs);
+        if (!globs_loaded)
+        {
+            globs = glob_tables_load();
+            g_atomic_int_set(&globs_loaded, TRUE);
+        }
+        else if (now - globs_checked >= GLOB_CHECK_INTERVAL && glob_files_changed())
+        {
+            g_debug("shared-mime-info database changed, reloading globs");
+            /* lookups in other threads may be using old tables right now
+               so they are freed only on finalization */
+            if (globs)
+                globs_retired = g_slist_prepend(globs_retired, globs);
+            g_atomic_pointer_set(&globs, glob_tables_load());
+        }
+        g_atomic_int_set(&globs_checked, now);
+        G_UNLOCK(globs);
+    }
+    return g_atomic_pointer_get(&globs);
+}
+
+static inline gboolean glob_add_match(GlobType **found, GlobType *type)
+{
+    if (type == NULL)
+        return TRUE;
+    if (type == &glob_ambiguous || (*found != NULL && *found != type))
+        return FALSE;
+    *found = type;
+    return TRUE;
+}
+
+/* returns type of file @name (basename) if its globs are the only ones
+   matching @name, or %NULL if g_content_type_guess() should be used */
+static FmMimeType *mime_type_from_globs(const char *name, gboolean *uncertain)
+{
+    GlobTables *g = glob_tables_get();
+    GlobType *found = NULL;
+    char lower[GLOB_MAX_NAME];
+    gsize len, l;
+    guint i;
+
+    if (g == NULL)
+        return NULL;
+    for (len = 0; name[len]; len++)
+    {
+        if (len == GLOB_MAX_NAME - 1 || (guchar)name[len] >= 0x80)
+            return NULL;
+        lower[len] = g_ascii_tolower(name[len]);
+    }
+    if (len == 0)
+        return NULL;
+    lower[len] = '\0';
+    /* literal names have precedence over anything else */
+    if (!glob_add_match(&found, g_hash_table_lookup(g->literals_cs, name)))
+        return NULL;
+    if (found == NULL &&
+        !glob_add_match(&found, g_hash_table_lookup(g->literals, lower)))
+        return NULL;
+    if (found == NULL)
+    {
+        for (l = 1; l <= MIN(len, GLOB_MAX_SUFFIX); l++)
+            if (g->suffix_lengths & (G_GUINT64_CONSTANT(1) << l))
+            {
+                if (!glob_add_match(&found, g_hash_table_lookup(g->suffixes_cs, name + len - l)) ||
+                    !glob_add_match(&found, g_hash_table_lookup(g->suffixes, lower + len - l)))
+                    return NULL;
+            }
+        for (i = 0; i < g->complex->len; i++)
+        {
+            GlobComplex *glob = g_ptr_array_index(g->complex, i);
+            if (g_pattern_match(glob->pspec, len, glob->cs ? name : lower, NULL) &&
+                (glob->inexact || !glob_add_match(&found, glob->type)))
+                return NULL;
+        }
+    }
+    *uncertain = (found == NULL);
+    if (found == NULL)
+        found = g->unknown;
+    if (G_UNLIKELY(g_atomic_pointer_get(&found->mime_type) == NULL))
+    {
+        FmMimeType *mime_type = fm_mime_type_from_name(found->name);
+        if (!g_atomic_pointer_compare_and_exchange(&found->mime_type, NULL, mime_type))
+            fm_mime_type_unref(mime_type); /* another thread was faster */
+    }
+    return fm_mime_type_ref(found->mime_type);
+}
+
+static void glob_tables_finalize(void)
+{
+    G_LOCK(globs);
+    if (globs)
+        glob_tables_free(globs);
+    globs = NULL;
+    g_slist_free_full(globs_retired, (GDestroyNotify)glob_tables_free);
+    globs_retired = NULL;
+    glob_files_free();
+    globs_loaded = FALSE;
+    globs_checked = 0;
+    G_UNLOCK(globs);
+}
+
 /**
  * fm_mime_type_from_file_name
  * @ufile_name: file name to guess
@@ -121,12 +602,402 @@ FmMimeType* fm_mime_type_from_file_name(const char* ufile_name)
         ufile_name = strchr(&type[3], '/');
     if (ufile_name == NULL)
         ufile_name = "unknown";
+    type = strrchr(ufile_name, '/');
+    mime_type = mime_type_from_globs(type ? &type[1] : ufile_name, &uncertain);
+    if (mime_type)
+        return mime_type;
     type = g_content_type_guess(ufile_name, NULL, 0, &uncertain);
     mime_type = fm_mime_type_from_name(type);
     g_free(type);
     return mime_type;
 }
 
+/* Persistent cache of content types detected by reading file contents.
+ * It is stored in $XDG_CACHE_HOME/libfm/sniff.cache, see fm-record-cache.h
+ * for its format, and is mapped into memory on first use. Record is valid
+ * while modification time and size of the file are the same. New results
+ * are kept in a hash table and merged into the file in batches, the least
+ * recently used records are dropped if limit of the cache is reached. */
+#define SNIFF_CACHE_NAME "sniff.cache"
+#define SNIFF_CACHE_MAGIC "LIBFMSC1"
+#define SNIFF_CACHE_DEFAULT_LIMIT 65536
+#define SNIFF_CACHE_BATCH 4096
+
+typedef struct
+{
+    FmRecordKey key;
+    guint32 type; /* offset of type name in the table of names */
+    guint32 stamp; /* value of clock when it was used last time */
+} SniffCacheRecord;
+
+typedef struct
+{
+    FmRecordKey key;
+    const char *type;
+    guint32 stamp;
+} SniffCacheEntry;
+
+G_LOCK_DEFINE_STATIC(sniff_cache);
+static guint sniff_limit = SNIFF_CACHE_DEFAULT_LIMIT;
+static gboolean sniff_loaded = FALSE;
+static FmRecordFile sniff_file = { NULL, NULL, sizeof(SniffCacheRecord), 0, NULL, 0, 0 };
+static guint32 *sniff_stamps = NULL; /* in-memory stamps of mapped records */
+static guint32 sniff_clock = 0;
+static GHashTable *sniff_pending = NULL; /* new results: SniffCacheEntry */
+static GHashTable *sniff_writing = NULL; /* batch being written, read-only */
+static guint sniff_next_save = SNIFF_CACHE_BATCH; /* size of sniff_pending */
+static guint sniff_hits = 0;
+static guint sniff_misses = 0;
+
+static void sniff_entry_free(gpointer data)
+{
+    g_slice_free(SniffCacheEntry, data);
+}
+
+static inline const SniffCacheRecord *sniff_record(const FmRecordFile *rf, guint i)
+{
+    return (const SniffCacheRecord*)_fm_record_file_get(rf, i);
+}
+
+static void sniff_cache_unload(void)
+{
+    _fm_record_file_unload(&sniff_file);
+    g_free(sniff_stamps);
+    sniff_stamps = NULL;
+}
+
+/* should be called with lock held */
+static void sniff_cache_load(void)
+{
+    guint i;
+
+    sniff_cache_unload();
+    if (!_fm_record_file_load(&sniff_file, SNIFF_CACHE_NAME, SNIFF_CACHE_MAGIC,
+                              sizeof(SniffCacheRecord)))
+        return;
+    sniff_stamps = g_new(guint32, sniff_file.n_records);
+    for (i = 0; i < sniff_file.n_records; i++)
+        sniff_stamps[i] = sniff_record(&sniff_file, i)->stamp;
+    /* the clock of the cache is saved in the header */
+    if (sniff_file.extra > sniff_clock)
+        sniff_clock = sniff_file.extra;
+}
+
+static int sniff_entry_cmp_stamp(const void *a, const void *b)
+{
+    const SniffCacheEntry *entry_a = *(const SniffCacheEntry**)a;
+    const SniffCacheEntry *entry_b = *(const SniffCacheEntry**)b;
+    /* most recent first */
+    if (entry_a->stamp != entry_b->stamp)
+        return entry_a->stamp > entry_b->stamp ? -1 : 1;
+    return 0;
+}
+
+/* state of the cache taken for writing it without lock held */
+typedef struct
+{
+    GHashTable *batch;
+    FmRecordFile file;
+    guint32 *stamps;
+    guint32 clock;
+    guint limit;
+} SniffCacheSnapshot;
+
+/* merges @snap->batch with records of @snap into new file,
+   it doesn't use any global state so it's called without lock */
+static gboolean sniff_cache_write(SniffCacheSnapshot *snap)
+{
+    GArray *from_file;
+    GPtrArray *entries;
+    FmRecordWriter *writer;
+    GHashTableIter it;
+    SniffCacheEntry *entry;
+    guint i;
+
+    from_file = g_array_sized_new(FALSE, FALSE, sizeof(SniffCacheEntry),
+                                  snap->file.n_records);
+    for (i = 0; i < snap->file.n_records; i++)
+    {
+        const SniffCacheRecord *rec = sniff_record(&snap->file, i);
+        SniffCacheEntry tmp;
+
+        tmp.key = rec->key;
+        if (rec->type >= snap->file.strings_size ||
+            g_hash_table_lookup(snap->batch, &tmp) != NULL) /* replaced */
+            continue;
+        tmp.type = _fm_record_file_get_string(&snap->file, rec->type);
+        tmp.stamp = snap->stamps[i];
+        g_array_append_val(from_file, tmp);
+    }
+    entries = g_ptr_array_sized_new(from_file->len + g_hash_table_size(snap->batch));
+    for (i = 0; i < from_file->len; i++)
+        g_ptr_array_add(entries, &g_array_index(from_file, SniffCacheEntry, i));
+    g_hash_table_iter_init(&it, snap->batch);
+    while (g_hash_table_iter_next(&it, (gpointer*)&entry, NULL))
+        g_ptr_array_add(entries, entry);
+    if (entries->len > snap->limit)
+        qsort(entries->pdata, entries->len, sizeof(gpointer), sniff_entry_cmp_stamp);
+    _fm_record_keep_recent(entries, snap->limit);
+
+    writer = _fm_record_writer_new(sizeof(SniffCacheRecord), entries->len);
+    for (i = 0; i < entries->len; i++)
+    {
+        SniffCacheRecord rec;
+
+        entry = g_ptr_array_index(entries, i);
+        rec.key = entry->key;
+        rec.type = _fm_record_writer_add_string(writer, entry->type);
+        rec.stamp = entry->stamp;
+        _fm_record_writer_add(writer, &rec);
+    }
+    g_ptr_array_free(entries, TRUE);
+    g_array_free(from_file, TRUE);
+    return _fm_record_writer_save(writer, SNIFF_CACHE_NAME, SNIFF_CACHE_MAGIC,
+                                  snap->clock);
+}
+
+/* hands new results over to sniff_cache_write() and maps the new file
+   after that; should be called with lock held, unlocks it meanwhile */
+static void sniff_cache_save(void)
+{
+    SniffCacheSnapshot snap;
+    GHashTableIter it;
+    SniffCacheEntry *entry;
+    gboolean ok;
+
+    snap.batch = sniff_pending;
+    _fm_record_file_copy(&snap.file, &sniff_file);
+    /* stamps are changed by lookups so copy them */
+    snap.stamps = g_new(guint32, sniff_file.n_records + 1);
+    if (sniff_file.n_records > 0)
+        memcpy(snap.stamps, sniff_stamps, sniff_file.n_records * sizeof(guint32));
+    snap.clock = sniff_clock;
+    snap.limit = sniff_limit;
+    sniff_writing = sniff_pending;
+    sniff_pending = g_hash_table_new_full(_fm_record_key_hash, _fm_record_key_equal,
+                                          NULL, sniff_entry_free);
+    G_UNLOCK(sniff_cache);
+
+    ok = sniff_cache_write(&snap);
+
+    G_LOCK(sniff_cache);
+    sniff_writing = NULL;
+    if (!sniff_loaded) /* finalized meanwhile */
+        ;
+    else if (ok)
+    {
+        sniff_cache_load();
+        sniff_next_save = SNIFF_CACHE_BATCH;
+    }
+    else
+    {
+        /* keep results to try again with the next batch unless there are
+           too many of them already */
+        g_hash_table_iter_init(&it, snap.batch);
+        while (g_hash_table_size(sniff_pending) < sniff_limit &&
+               g_hash_table_iter_next(&it, (gpointer*)&entry, NULL))
+        {
+            if (g_hash_table_lookup(sniff_pending, entry) != NULL)
+                continue; /* replaced by newer one */
+            g_hash_table_iter_steal(&it);
+            g_hash_table_insert(sniff_pending, entry, entry);
+        }
+        sniff_next_save = g_hash_table_size(sniff_pending) + SNIFF_CACHE_BATCH;
+    }
+    /* type names of entries are owned by mime types */
+    g_hash_table_destroy(snap.batch);
+    _fm_record_file_unload(&snap.file);
+    g_free(snap.stamps);
+}
+
+/* should be called with lock held */
+static gboolean sniff_cache_ready(void)
+{
+    if (sniff_limit == 0)
+        return FALSE;
+    if (G_UNLIKELY(!sniff_loaded))
+    {
+        sniff_pending = g_hash_table_new_full(_fm_record_key_hash, _fm_record_key_equal,
+                                              NULL, sniff_entry_free);
+        sniff_cache_load();
+        sniff_loaded = TRUE;
+    }
+    return TRUE;
+}
+
+static inline gboolean sniff_key_valid(const FmRecordKey *key, const struct stat *pstat)
+{
+    return key->mtime == pstat->st_mtime && key->size == pstat->st_size;
+}
+
+static FmMimeType *sniff_cache_lookup(const struct stat *pstat)
+{
+    SniffCacheEntry key, *entry;
+    FmMimeType *mime_type = NULL;
+    const char *type = NULL;
+    gint i;
+
+    G_LOCK(sniff_cache);
+    if (!sniff_cache_ready())
+    {
+        G_UNLOCK(sniff_cache);
+        return NULL;
+    }
+    key.key.dev = pstat->st_dev;
+    key.key.ino = pstat->st_ino;
+    entry = g_hash_table_lookup(sniff_pending, &key);
+    if (entry)
+    {
+        if (sniff_key_valid(&entry->key, pstat))
+        {
+            entry->stamp = ++sniff_clock;
+            type = entry->type;
+        }
+    }
+    /* entries being written are fresh, their stamps aren't updated */
+    else if (sniff_writing && (entry = g_hash_table_lookup(sniff_writing, &key)))
+    {
+        if (sniff_key_valid(&entry->key, pstat))
+            type = entry->type;
+    }
+    else if ((i = _fm_record_file_find(&sniff_file, key.key.dev, key.key.ino)) >= 0)
+    {
+        const SniffCacheRecord *rec = sniff_record(&sniff_file, i);
+        if (sniff_key_valid(&rec->key, pstat) && rec->type < sniff_file.strings_size)
+        {
+            /* new stamps are saved with the next batch only, it's not
+               worth rewriting the file just for them */
+            sniff_stamps[i] = ++sniff_clock;
+            type = _fm_record_file_get_string(&sniff_file, rec->type);
+        }
+    }
+    if (type)
+    {
+        sniff_hits++;
+        /* mapping may be replaced by another thread so do it under lock */
+        mime_type = fm_mime_type_from_name(type);
+    }
+    else
+        sniff_misses++;
+    G_UNLOCK(sniff_cache);
+    return mime_type;
+}
+
+static void sniff_cache_insert(const struct stat *pstat, FmMimeType *mime_type)
+{
+    SniffCacheEntry key, *entry;
+
+    G_LOCK(sniff_cache);
+    if (!sniff_cache_ready())
+    {
+        G_UNLOCK(sniff_cache);
+        return;
+    }
+    key.key.dev = pstat->st_dev;
+    key.key.ino = pstat->st_ino;
+    entry = g_hash_table_lookup(sniff_pending, &key);
+    if (entry == NULL)
+    {
+        entry = g_slice_new(SniffCacheEntry);
+        entry->key.dev = key.key.dev;
+        entry->key.ino = key.key.ino;
+        g_hash_table_insert(sniff_pending, entry, entry);
+    }
+    entry->key.mtime = pstat->st_mtime;
+    entry->key.size = pstat->st_size;
+    /* mime types are never freed before _fm_mime_type_finalize() */
+    entry->type = mime_type->type;
+    entry->stamp = ++sniff_clock;
+    if (g_hash_table_size(sniff_pending) >= sniff_next_save && sniff_writing == NULL)
+        sniff_cache_save();
+    G_UNLOCK(sniff_cache);
+}
+
+static gboolean sniff_cache_contains(const struct stat *pstat)
+{
+    SniffCacheEntry key, *entry;
+    gboolean found = FALSE;
+    gint i;
+
+    G_LOCK(sniff_cache);
+    if (sniff_cache_ready())
+    {
+        key.key.dev = pstat->st_dev;
+        key.key.ino = pstat->st_ino;
+        if ((entry = g_hash_table_lookup(sniff_pending, &key)) != NULL ||
+            (sniff_writing && (entry = g_hash_table_lookup(sniff_writing, &key)) != NULL))
+            found = sniff_key_valid(&entry->key, pstat);
+        else if ((i = _fm_record_file_find(&sniff_file, key.key.dev, key.key.ino)) >= 0)
+            found = sniff_key_valid(&sniff_record(&sniff_file, i)->key, pstat);
+    }
+    G_UNLOCK(sniff_cache);
+    return found;
+}
+
+/* saves changes and releases the cache */
+static void sniff_cache_finalize(void)
+{
+    G_LOCK(sniff_cache);
+    if (sniff_loaded)
+    {
+        /* if another thread writes the cache right now then results which
+           came after that batch are lost */
+        if (sniff_limit > 0 && sniff_writing == NULL &&
+            g_hash_table_size(sniff_pending) > 0)
+            sniff_cache_save();
+        sniff_cache_unload();
+        g_hash_table_destroy(sniff_pending);
+        sniff_pending = NULL;
+        sniff_loaded = FALSE;
+        sniff_next_save = SNIFF_CACHE_BATCH;
+    }
+    G_UNLOCK(sniff_cache);
+}
+
+/**
+ * fm_mime_type_set_sniff_cache_limit
+ * @max_entries: maximum number of files in the cache, 0 to disable it
+ *
+ * Sets limit of persistent cache of content types which were detected
+ * by reading contents of files. The cache is stored in user cache
+ * directory and is valid until size or modification time of the file
+ * is changed. If the limit is reached then the least recently used files
+ * are dropped from the cache. Default limit is 65536 files.
+ *
+ * Since: 1.3.2
+ */
+void fm_mime_type_set_sniff_cache_limit(guint max_entries)
+{
+    G_LOCK(sniff_cache);
+    sniff_limit = max_entries;
+    G_UNLOCK(sniff_cache);
+}
+
+/**
+ * fm_mime_type_get_sniff_cache_stats
+ * @hits: (out) (allow-none): location to store number of files found in cache
+ * @misses: (out) (allow-none): location to store number of files which
+ * contents were read
+ * @n_entries: (out) (allow-none): location to store number of files in cache
+ *
+ * Retrieves statistics of persistent cache of content types, see
+ * fm_mime_type_set_sniff_cache_limit() for details.
+ *
+ * Since: 1.3.2
+ */
+void fm_mime_type_get_sniff_cache_stats(guint *hits, guint *misses, guint *n_entries)
+{
+    G_LOCK(sniff_cache);
+    if (hits)
+        *hits = sniff_hits;
+    if (misses)
+        *misses = sniff_misses;
+    if (n_entries)
+        *n_entries = sniff_file.n_records +
+                     (sniff_pending ? g_hash_table_size(sniff_pending) : 0);
+    G_UNLOCK(sniff_cache);
+}
+
 /**
  * fm_mime_type_from_native_file
  * @file_path: full path to file
@@ -139,6 +1010,8 @@ FmMimeType* fm_mime_type_from_file_name(const char* ufile_name)
  * Before 1.0.0 this API had name fm_mime_type_get_for_native_file.
  *
  * Note that this call does I/O and therefore can block.
+ * Since 1.3.2 types detected by file contents are cached, see
+ * fm_mime_type_set_sniff_cache_limit() for details.
  *
  * Returns: (transfer full): a #FmMimeType object.
  *
@@ -148,7 +1021,6 @@ FmMimeType* fm_mime_type_from_native_file(const char* file_path,
                                         const char* base_name,
                                         struct stat* pstat)
 {
-    FmMimeType* mime_type;
     struct stat st;
 
     if(!pstat)
@@ -157,11 +1029,33 @@ FmMimeType* fm_mime_type_from_native_file(const char* file_path,
         if(stat(file_path, &st) == -1)
             return NULL;
     }
+    return _fm_mime_type_from_native_file_at(AT_FDCWD, file_path, base_name, pstat);
+}
+
+/* the same as fm_mime_type_from_native_file() but @name is relative to
+   directory @dirfd and @pstat is required, so listing doesn't need to
+   build full path of each file */
+FmMimeType* _fm_mime_type_from_native_file_at(int dirfd, const char* name,
+                                              const char* base_name,
+                                              struct stat* pstat)
+{
+    FmMimeType* mime_type;
 
     if(S_ISREG(pstat->st_mode))
     {
         gboolean uncertain;
-        char* type = g_content_type_guess(base_name, NULL, 0, &uncertain);
+        char* type;
+
+        mime_type = mime_type_from_globs(base_name, &uncertain);
+        if (mime_type != NULL && !uncertain)
+            return mime_type;
+        if (mime_type != NULL) /* unknown by name */
+        {
+            type = g_strdup(mime_type->type);
+            fm_mime_type_unref(mime_type);
+        }
+        else
+            type = g_content_type_guess(base_name, NULL, 0, &uncertain);
         if(uncertain)
         {
             int fd, len;
@@ -170,7 +1064,13 @@ FmMimeType* fm_mime_type_from_native_file(const char* file_path,
                 g_free(type);
                 return fm_mime_type_from_name("text/plain");
             }
-            fd = open(file_path, O_RDONLY);
+            mime_type = sniff_cache_lookup(pstat);
+            if (mime_type)
+            {
+                g_free(type);
+                return mime_type;
+            }
+            fd = openat(dirfd, name, O_RDONLY);
             if(fd >= 0)
             {
                 /* #3086703 - PCManFM crashes on non existent directories.
@@ -216,8 +1116,13 @@ FmMimeType* fm_mime_type_from_native_file(const char* file_path,
                     strncmp(tmp, "[Desktop Entry]\n", 16) == 0)
                 {
                     g_free(type);
-                    return fm_mime_type_ref(desktop_entry_type);
+                    type = g_strdup(desktop_entry_type->type);
                 }
+                mime_type = fm_mime_type_from_name(type);
+                g_free(type);
+                if (len >= 0)
+                    sniff_cache_insert(pstat, mime_type);
+                return mime_type;
             /* #endif */
             }
         }
@@ -247,6 +1152,41 @@ FmMimeType* fm_mime_type_from_native_file(const char* file_path,
     return fm_mime_type_from_name("application/octet-stream");
 }
 
+/* asks system to start reading the beginning of file which contents will
+   be tested by fm_mime_type_from_native_file() soon, so reads of many files
+   may go in parallel; this call doesn't block on I/O of file contents */
+void _fm_mime_type_read_ahead_native_file(const char *file_path)
+{
+#ifdef HAVE_POSIX_FADVISE
+    const char *base_name = strrchr(file_path, '/');
+    FmMimeType *mime_type;
+    gboolean uncertain;
+    struct stat st;
+    int fd;
+
+    /* files known by name are not read by _fm_mime_type_from_native_file_at()
+       so don't touch them at all, the same as it does */
+    base_name = base_name ? base_name + 1 : file_path;
+    mime_type = mime_type_from_globs(base_name, &uncertain);
+    if (mime_type != NULL)
+        fm_mime_type_unref(mime_type);
+    else
+        g_free(g_content_type_guess(base_name, NULL, 0, &uncertain));
+    if (!uncertain)
+        return;
+    if (stat(file_path, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+        sniff_cache_contains(&st))
+        return;
+    /* O_NONBLOCK: the file might be replaced with a FIFO since stat() */
+    fd = open(file_path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0)
+        return;
+    /* the same amount as fm_mime_type_from_native_file() reads */
+    posix_fadvise(fd, 0, 4096, POSIX_FADV_WILLNEED);
+    close(fd);
+#endif
+}
+
 /**
  * fm_mime_type_from_name
  * @type: MIME type name
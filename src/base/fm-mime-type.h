@@ -45,12 +45,20 @@ FmMimeType* fm_mime_type_from_native_file(const char* file_path,  /* Should be o
                                           const char* base_name,  /* Should be in UTF-8 */
                                           struct stat* pstat);   /* Can be NULL */
 
+FmMimeType* _fm_mime_type_from_native_file_at(int dirfd, const char* name,
+                                              const char* base_name,
+                                              struct stat* pstat);
+
 FmMimeType* fm_mime_type_from_name(const char* type);
 
+void fm_mime_type_set_sniff_cache_limit(guint max_entries);
+void fm_mime_type_get_sniff_cache_stats(guint *hits, guint *misses, guint *n_entries);
+
 FmMimeType* _fm_mime_type_get_inode_directory();
 FmMimeType* _fm_mime_type_get_inode_x_shortcut();
 FmMimeType* _fm_mime_type_get_inode_mount_point();
 FmMimeType* _fm_mime_type_get_application_x_desktop();
+void _fm_mime_type_read_ahead_native_file(const char *file_path);
 
 FmMimeType* fm_mime_type_ref(FmMimeType* mime_type);
 void fm_mime_type_unref(gpointer mime_type_);
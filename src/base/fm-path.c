@@ -49,10 +49,13 @@
 struct _FmPath
 {
     gint n_ref;
+    guint hash; /* hash of full path, see fm_path_hash() */
     FmPath* parent;
     char *disp_name;
-    GSequenceIter *iter; /* iterator in parent, NULL for root path */
-    GSequence *children; /* children to reuse paths */
+    GHashTable *children; /* name -> child, to reuse paths */
+    GHashTable *disp_children; /* disp_name -> child, built on demand */
+    guint str_len; /* length of fm_path_to_str() result */
+    guint16 depth; /* number of elements in path */
     guchar flags; /* FmPathFlags flags : 8; */
     char name[1]; /* basename: in local encoding if native, uri-escaped otherwise */
 };
@@ -80,36 +83,108 @@ static FmPath* apps_root_path = NULL;
 
 static GSList* roots = NULL;
 
-/* a lock for access to changeable data: roots list, and
-   members of FmPath struct: disp_name, iter, children */
+/* a lock for access to roots list */
 G_LOCK_DEFINE_STATIC(roots);
 
+/* locks for changeable members of FmPath struct are striped by address so
+   threads creating paths in different directories don't wait for each
+   other: children and disp_children tables of a path are protected by its
+   children lock, so a child is added or removed under the lock of its
+   parent, while disp_name is protected by disp_name lock of the path
+   itself; if both are needed then children lock of the parent should be
+   taken first */
+#if GLIB_CHECK_VERSION(2, 32, 0)
+#define N_PATH_LOCKS 64 /* should be power of 2 */
+static GMutex children_locks[N_PATH_LOCKS];
+static GMutex disp_name_locks[N_PATH_LOCKS];
+#define _PATH_LOCK_INDEX(path) \
+    ((GPOINTER_TO_SIZE(path) >> 4 ^ GPOINTER_TO_SIZE(path) >> 10) & (N_PATH_LOCKS - 1))
+#define CHILDREN_LOCK(parent) g_mutex_lock(&children_locks[_PATH_LOCK_INDEX(parent)])
+#define CHILDREN_UNLOCK(parent) g_mutex_unlock(&children_locks[_PATH_LOCK_INDEX(parent)])
+#define DISP_NAME_LOCK(path) g_mutex_lock(&disp_name_locks[_PATH_LOCK_INDEX(path)])
+#define DISP_NAME_UNLOCK(path) g_mutex_unlock(&disp_name_locks[_PATH_LOCK_INDEX(path)])
+#else
+G_LOCK_DEFINE_STATIC(children);
+G_LOCK_DEFINE_STATIC(disp_name);
+#define CHILDREN_LOCK(parent) G_LOCK(children)
+#define CHILDREN_UNLOCK(parent) G_UNLOCK(children)
+#define DISP_NAME_LOCK(path) G_LOCK(disp_name)
+#define DISP_NAME_UNLOCK(path) G_UNLOCK(disp_name)
+#endif
+
+/* takes reference on @path found in children of its parent or in roots
+   unless it is being destroyed right now; should be called with the lock
+   of that list on */
+static inline FmPath *_fm_path_ref_if_alive(FmPath *path)
+{
+    int n_ref;
+
+    do
+    {
+        n_ref = g_atomic_int_get(&path->n_ref);
+        if (n_ref == 0)
+            return NULL;
+    }
+    while (!g_atomic_int_compare_and_exchange(&path->n_ref, n_ref, n_ref + 1));
+    return path;
+}
+
 static FmPath* _fm_path_alloc(FmPath* parent, int name_len, int flags)
 {
     FmPath* path;
-    path = (FmPath*)g_malloc(sizeof(FmPath) + name_len);
+    path = (FmPath*)_fm_object_alloc(sizeof(FmPath) + name_len);
     path->n_ref = 1;
     path->flags = flags;
     path->parent = parent ? fm_path_ref(parent) : NULL;
     path->disp_name = NULL;
     path->children = NULL;
-    path->iter = NULL;
+    path->disp_children = NULL;
     return path;
 }
 
+/* should be called once path->name is filled */
+static void _fm_path_init_cached(FmPath *path)
+{
+    FmPath *parent = path->parent;
+    guint hash = g_str_hash(path->name);
+
+    path->str_len = strlen(path->name);
+    if (parent)
+    {
+        /* this is learned from g_str_hash() of glib. */
+        hash = (hash << 5) - hash + '/';
+        /* this is learned from g_icon_hash() of gio. */
+        hash ^= parent->hash;
+        path->str_len += parent->str_len;
+        if (parent->parent) /* if parent dir is not root_path */
+            path->str_len++;
+        path->depth = parent->depth + 1;
+    }
+    else
+        path->depth = 1;
+    path->hash = hash;
+}
+
+/* should be called with CHILDREN_LOCK(parent) on */
+static inline void _fm_path_add_child(FmPath *parent, FmPath *path)
+{
+    if (parent->children == NULL)
+        parent->children = g_hash_table_new(g_str_hash, g_str_equal);
+    /* it may replace a path which is being destroyed right now */
+    g_hash_table_replace(parent->children, path->name, path);
+}
+
 static inline FmPath* _fm_path_new_internal(FmPath* parent, const char* name, int name_len, int flags)
 {
     FmPath* path = _fm_path_alloc(parent, name_len, flags);
     memcpy(path->name, name, name_len);
     path->name[name_len] = '\0';
+    _fm_path_init_cached(path);
     if (parent)
     {
-        G_LOCK(roots);
-        if (parent->children == NULL)
-            parent->children = g_sequence_new(NULL);
-        path->iter = g_sequence_insert_sorted(parent->children, path,
-                                              (GCompareDataFunc)fm_path_compare, NULL);
-        G_UNLOCK(roots);
+        CHILDREN_LOCK(parent);
+        _fm_path_add_child(parent, path);
+        CHILDREN_UNLOCK(parent);
     }
     return path;
 }
@@ -227,16 +302,14 @@ static FmPath* _fm_path_new_uri_root(const char* uri, int len, const char** rema
         path = l->data;
         if(strncmp(path->name, uri, scheme_len) == 0 &&
            (!host_len || !strncmp(&path->name[scheme_len + 3], host, host_len)) &&
-           strcmp(&path->name[len-1], "/") == 0)
+           strcmp(&path->name[len-1], "/") == 0 &&
+           _fm_path_ref_if_alive(path))
         {
-            fm_path_ref(path);
             G_UNLOCK(roots);
             return path;
         }
     }
     path = _fm_path_alloc(NULL, len, flags);
-    roots = g_slist_append(roots, path);
-    G_UNLOCK(roots);
     buf = path->name;
     memcpy(buf, uri, scheme_len); /* the scheme */
     buf += scheme_len;
@@ -249,6 +322,10 @@ static FmPath* _fm_path_new_uri_root(const char* uri, int len, const char** rema
     }
     buf[0] = '/'; /* the trailing / */
     buf[1] = '\0';
+    _fm_path_init_cached(path);
+    /* publish it only when it is complete */
+    roots = g_slist_append(roots, path);
+    G_UNLOCK(roots);
     if (disp_name)
         path->disp_name = g_strdup(disp_name); /* no lock required, it's new data */
     return path;
@@ -280,6 +357,9 @@ FmPath* _fm_path_new_child_len(FmPath* parent, const char* basename, int name_le
 {
     FmPath* path;
     int flags;
+    char name_buf[256];
+    const char *name;
+    char *escaped = NULL;
 
     /* skip empty basename */
     if(G_UNLIKELY(!basename || name_len == 0))
@@ -321,67 +401,49 @@ FmPath* _fm_path_new_child_len(FmPath* parent, const char* basename, int name_le
     if(name_len == 0)
         return fm_path_ref(parent);
 
-    /* create path data first */
+    /* prepare the name to look for */
     if(dont_escape)
     {
-        path = _fm_path_alloc(parent, name_len, flags);
-        memcpy(path->name, basename, name_len);
+        if(name_len < (int)sizeof(name_buf))
+        {
+            memcpy(name_buf, basename, name_len);
+            name_buf[name_len] = '\0';
+            name = name_buf;
+        }
+        else
+            name = escaped = g_strndup(basename, name_len);
+        /* size of FmPath is derived from length of name on free */
+        name_len = strlen(name);
     }
     else
     {
         GString *str = g_string_new_len(basename, name_len);
         /* remote file names don't come escaped from gvfs; isn't that a bug of gvfs? */
-        char *escaped = g_uri_escape_string(str->str, G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
+        escaped = g_uri_escape_string(str->str, G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
         /* g_debug("got child %s", escaped); */
         name_len = strlen(escaped);
-        path = _fm_path_alloc(parent, name_len, flags);
-        memcpy(path->name, escaped, name_len);
-        g_free(escaped);
+        name = escaped;
         g_string_free(str, TRUE);
     }
-    path->name[name_len] = '\0';
 
-    G_LOCK(roots);
-    if (parent->children)
+    CHILDREN_LOCK(parent);
+    /* try to reuse existing path */
+    if (parent->children &&
+        (path = g_hash_table_lookup(parent->children, name)) != NULL &&
+        _fm_path_ref_if_alive(path))
     {
-        GSequenceIter *iter;
-
-        /* try to reuse existing path */
-#if GLIB_CHECK_VERSION(2, 28, 0)
-        iter = g_sequence_lookup(parent->children, path,
-                                 (GCompareDataFunc)fm_path_compare, NULL);
-#else
-        iter = g_sequence_search(parent->children, path,
-                                 (GCompareDataFunc)fm_path_compare, NULL);
-        if (iter)
-        {
-            FmPath *pp = NULL;
-            iter = g_sequence_iter_prev(iter);
-            if (iter)
-                pp = g_sequence_get(iter);
-            if (fm_path_compare(pp, path) != 0)
-                iter = NULL;
-        }
-#endif
-        if (iter)
-        {
-                /* g_debug("found reusable path '%.*s'", name_len, basename); */
-            FmPath *np = fm_path_ref(g_sequence_get(iter));
-            G_UNLOCK(roots); /* we should not unref with lock up */
-            fm_path_unref(path); /* drop this path and reuse found one */
-            return np;
-        }
-        else
-            path->iter = g_sequence_insert_sorted(parent->children, path,
-                                                  (GCompareDataFunc)fm_path_compare,
-                                                  NULL);
+        /* g_debug("found reusable path '%.*s'", name_len, basename); */
     }
     else
     {
-        parent->children = g_sequence_new(NULL);
-        path->iter = g_sequence_append(parent->children, path);
+        path = _fm_path_alloc(parent, name_len, flags);
+        memcpy(path->name, name, name_len);
+        path->name[name_len] = '\0';
+        _fm_path_init_cached(path);
+        _fm_path_add_child(parent, path);
     }
-    G_UNLOCK(roots);
+    CHILDREN_UNLOCK(parent);
+    g_free(escaped);
     return path;
 }
 
@@ -565,34 +627,40 @@ FmPath* fm_path_new_for_uri(const char* uri)
 }
 
 /* looks for known display_name, returns referenced child */
-static FmPath *_lookup_in_children(FmPath *path, const char *display_name)
+static FmPath *_lookup_in_children(FmPath *parent, const char *display_name)
 {
-    FmPath *subpath = NULL;
-
-    G_LOCK(roots);
-    if (path->children != NULL)
+    FmPath *path, *subpath = NULL;
+
+    CHILDREN_LOCK(parent);
+    if (parent->children == NULL)
+        goto _out;
+    /* usually display name is the same as basename */
+    path = g_hash_table_lookup(parent->children, display_name);
+    if (path && g_atomic_pointer_get(&path->disp_name) == BASENAME_AS_DISP_NAME)
     {
-        GSequenceIter *iter = g_sequence_get_begin_iter(path->children);
-        const char *name;
+        subpath = _fm_path_ref_if_alive(path);
+        goto _out;
+    }
+    /* otherwise look in index of other display names */
+    if (parent->disp_children == NULL)
+    {
+        GHashTableIter it;
 
-        while (!g_sequence_iter_is_end(iter))
+        parent->disp_children = g_hash_table_new(g_str_hash, g_str_equal);
+        g_hash_table_iter_init(&it, parent->children);
+        while (g_hash_table_iter_next(&it, NULL, (gpointer*)&path))
         {
-            path = (FmPath*)g_sequence_get(iter);
-            name = path->disp_name;
-            if (name)
-            {
-                if (name == BASENAME_AS_DISP_NAME)
-                    name = path->name;
-                if (strcmp(display_name, name) == 0)
-                {
-                    subpath = fm_path_ref(path);
-                    break;
-                }
-            }
-            iter = g_sequence_iter_next(iter);
+            /* disp_name cannot be freed while we hold CHILDREN_LOCK(parent) */
+            char *name = g_atomic_pointer_get(&path->disp_name);
+            if (name && name != BASENAME_AS_DISP_NAME)
+                g_hash_table_insert(parent->disp_children, name, path);
         }
     }
-    G_UNLOCK(roots);
+    path = g_hash_table_lookup(parent->disp_children, display_name);
+    if (path)
+        subpath = _fm_path_ref_if_alive(path);
+_out:
+    CHILDREN_UNLOCK(parent);
     return subpath;
 }
 
@@ -795,17 +863,24 @@ void fm_path_unref(FmPath* path)
     /* g_debug("fm_path_unref: %s, n_ref = %d", fm_path_to_str(path), path->n_ref); */
     if(g_atomic_int_dec_and_test(&path->n_ref))
     {
-        G_LOCK(roots);
         if(G_LIKELY(path->parent))
         {
-            if (G_LIKELY(path->iter))
-                g_sequence_remove(path->iter);
-                /* otherwise it's fresh abandoned one, see above */
-            G_UNLOCK(roots); /* we should not unref with lock up */
+            FmPath *parent = path->parent;
+            char *disp_name = path->disp_name;
+
+            CHILDREN_LOCK(parent);
+            /* it might be replaced already by new path with the same name */
+            if (G_LIKELY(g_hash_table_lookup(parent->children, path->name) == path))
+                g_hash_table_remove(parent->children, path->name);
+            if (parent->disp_children && disp_name && disp_name != BASENAME_AS_DISP_NAME &&
+                g_hash_table_lookup(parent->disp_children, disp_name) == path)
+                g_hash_table_remove(parent->disp_children, disp_name);
+            CHILDREN_UNLOCK(parent); /* we should not unref with lock up */
             fm_path_unref(path->parent);
         }
         else
         {
+            G_LOCK(roots);
             roots = g_slist_remove(roots, path);
             G_UNLOCK(roots);
         }
@@ -814,10 +889,13 @@ void fm_path_unref(FmPath* path)
             g_free(path->disp_name);
         if (G_UNLIKELY(path->children))
         {
-            g_assert(g_sequence_get_length(path->children) == 0);
-            g_sequence_free(path->children);
+            g_assert(g_hash_table_size(path->children) == 0);
+            g_hash_table_destroy(path->children);
         }
-        g_free(path);
+        if (G_UNLIKELY(path->disp_children))
+            g_hash_table_destroy(path->disp_children);
+        /* name was allocated exactly for its length, see _fm_path_alloc() */
+        _fm_object_free(path, sizeof(FmPath) + strlen(path->name));
     }
 }
 
@@ -909,26 +987,30 @@ gboolean fm_path_has_prefix(FmPath* path, FmPath* prefix)
     return FALSE;
 }
 
-/* recursive internal implem. of fm_path_to_str returns end of current
-   build string */
-static gchar* fm_path_to_str_int(FmPath* path, gchar** ret, gint str_len)
+/* internal implem. of fm_path_to_str: fills @buf which should have at
+   least path->str_len + 1 bytes, from the end to the beginning */
+static void fm_path_to_str_int(FmPath* path, gchar* buf)
 {
-    gint name_len = strlen(path->name);
-    gchar* pbuf;
+    gchar* pbuf = buf + path->str_len;
 
-    if (!path->parent)
-    {
-        *ret = g_new0(gchar, str_len + name_len + 1 );
-        pbuf = *ret;
-    }
-    else
+    *pbuf = '\0';
+    for (; path->parent; path = path->parent)
     {
-        pbuf = fm_path_to_str_int( path->parent, ret, str_len + name_len + 1 );
+        guint name_len = path->str_len - path->parent->str_len;
         if (path->parent->parent) /* if parent dir is not root_path */
-            *pbuf++ = G_DIR_SEPARATOR;
+        {
+            name_len--;
+            pbuf -= name_len;
+            memcpy(pbuf, path->name, name_len);
+            *--pbuf = G_DIR_SEPARATOR;
+        }
+        else
+        {
+            pbuf -= name_len;
+            memcpy(pbuf, path->name, name_len);
+        }
     }
-    memcpy( pbuf, path->name, name_len );
-    return pbuf + name_len;
+    memcpy(buf, path->name, path->str_len);
 }
 
 /**
@@ -945,11 +1027,33 @@ static gchar* fm_path_to_str_int(FmPath* path, gchar** ret, gint str_len)
  */
 char* fm_path_to_str(FmPath* path)
 {
-    gchar *ret;
-    fm_path_to_str_int( path, &ret, 0 );
+    gchar *ret = g_new(gchar, path->str_len + 1);
+    fm_path_to_str_int(path, ret);
     return ret;
 }
 
+/**
+ * fm_path_to_str_buf
+ * @path: a path
+ * @buf: (out caller-allocates): buffer to write to
+ * @size: size of @buf
+ *
+ * Writes string representation of @path into @buf the same way as
+ * fm_path_to_str() does but without allocating memory. If @buf is too
+ * small to contain the string and trailing zero then nothing is written.
+ *
+ * Returns: length of string representation of @path, excluding trailing
+ * zero.
+ *
+ * Since: 1.3.2
+ */
+gsize fm_path_to_str_buf(FmPath* path, char* buf, gsize size)
+{
+    if (size > path->str_len)
+        fm_path_to_str_int(path, buf);
+    return path->str_len;
+}
+
 /**
  * fm_path_to_uri
  * @path: a path
@@ -1072,21 +1176,25 @@ char* fm_path_display_name(FmPath* path, gboolean human_readable)
 /* FIXME: maybe we can support different encoding for different mount points? */
 char* fm_path_display_basename(FmPath* path)
 {
+    char *disp_name;
+
     if(G_UNLIKELY(!path->parent)) /* root_path element */
         return g_strdup(path->name);
-    G_LOCK(roots);
-    if (G_LIKELY(path->disp_name == BASENAME_AS_DISP_NAME))
-    {
-        G_UNLOCK(roots);
+    disp_name = g_atomic_pointer_get(&path->disp_name);
+    if (G_LIKELY(disp_name == BASENAME_AS_DISP_NAME))
         return g_strdup(path->name);
-    }
-    if (path->disp_name)
+    if (disp_name)
     {
-        char *name = g_strdup(path->disp_name);
-        G_UNLOCK(roots);
+        char *name;
+        DISP_NAME_LOCK(path);
+        /* it might be changed since we checked it */
+        if (path->disp_name == BASENAME_AS_DISP_NAME)
+            name = g_strdup(path->name);
+        else
+            name = g_strdup(path->disp_name);
+        DISP_NAME_UNLOCK(path);
         return name;
     }
-    G_UNLOCK(roots);
     if(!fm_path_is_native(path))
         return g_uri_unescape_string(path->name, NULL);
     return g_filename_display_name(path->name);
@@ -1105,15 +1213,24 @@ void _fm_path_set_display_name(FmPath *path, const char *disp_name)
         g_free(_name);
         return;
     }
-    G_LOCK(roots);
+    /* fast path: display name is the same as basename, it is never
+       changed usually so no lock is needed for that */
+    if (strcmp(disp_name, path->name) == 0)
+    {
+        if (g_atomic_pointer_get(&path->disp_name) == BASENAME_AS_DISP_NAME ||
+            g_atomic_pointer_compare_and_exchange(&path->disp_name, NULL,
+                                                  BASENAME_AS_DISP_NAME))
+            return;
+    }
+    /* parent's index of display names refers to disp_name string */
+    if (path->parent)
+        CHILDREN_LOCK(path->parent);
+    DISP_NAME_LOCK(path);
     if (path->disp_name != BASENAME_AS_DISP_NAME)
     {
         /* check if it is set already */
         if (g_strcmp0(disp_name, path->disp_name) == 0)
-        {
-            G_UNLOCK(roots);
-            return;
-        }
+            goto _out;
         g_free(path->disp_name);
     }
     /* g_debug("set display name of %s to %s", path->name, disp_name); */
@@ -1122,10 +1239,19 @@ void _fm_path_set_display_name(FmPath *path, const char *disp_name)
      * need to convert it to UTF-8 for display and save its
      * UTF-8 version in fi->disp_name */
     if (g_strcmp0(disp_name, path->name) == 0)
-        path->disp_name = BASENAME_AS_DISP_NAME;
+        g_atomic_pointer_set(&path->disp_name, BASENAME_AS_DISP_NAME);
     else
-        path->disp_name = g_strdup(disp_name);
-    G_UNLOCK(roots);
+        g_atomic_pointer_set(&path->disp_name, g_strdup(disp_name));
+    if (path->parent && path->parent->disp_children)
+    {
+        /* it will be rebuilt on demand */
+        g_hash_table_destroy(path->parent->disp_children);
+        path->parent->disp_children = NULL;
+    }
+_out:
+    DISP_NAME_UNLOCK(path);
+    if (path->parent)
+        CHILDREN_UNLOCK(path->parent);
 }
 
 /* use this to avoid change from another thread */
@@ -1134,10 +1260,12 @@ static char *_display_name_static_keeper = NULL;
 /* this API is not thread capable! */
 const char *_fm_path_get_display_name(FmPath *path)
 {
-    G_LOCK(roots);
+    if (g_atomic_pointer_get(&path->disp_name) == BASENAME_AS_DISP_NAME)
+        return path->name;
+    DISP_NAME_LOCK(path);
     if (path->disp_name == BASENAME_AS_DISP_NAME)
     {
-        G_UNLOCK(roots);
+        DISP_NAME_UNLOCK(path);
         return path->name;
     }
     g_free(_display_name_static_keeper);
@@ -1145,7 +1273,7 @@ const char *_fm_path_get_display_name(FmPath *path)
        thread may change it at that time, although _display_name_static_keeper
        isn't protected by lock so should be protected by general glib lock */
     _display_name_static_keeper = g_strdup(path->disp_name);
-    G_UNLOCK(roots);
+    DISP_NAME_UNLOCK(path);
     return _display_name_static_keeper;
 }
 
@@ -1342,15 +1470,8 @@ void _fm_path_finalize(void)
 /* FIXME: is this good enough? */
 guint fm_path_hash(FmPath* path)
 {
-    guint hash = g_str_hash(path->name);
-    if(path->parent)
-    {
-        /* this is learned from g_str_hash() of glib. */
-        hash = (hash << 5) - hash + '/';
-        /* this is learned from g_icon_hash() of gio. */
-        hash ^= fm_path_hash(path->parent);
-    }
-    return hash;
+    /* it is computed on creation, see _fm_path_init_cached() */
+    return path->hash;
 }
 
 /**
@@ -1468,13 +1589,7 @@ gboolean fm_path_equal_str(FmPath *path, const gchar *str, int n)
  */
 int fm_path_depth(FmPath* path)
 {
-    int depth = 1;
-    while(path->parent)
-    {
-        ++depth;
-        path = path->parent;
-    }
-    return depth;
+    return path->depth;
 }
 
 
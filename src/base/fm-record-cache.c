@@ -0,0 +1,235 @@
+/*
+ *      fm-record-cache.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "fm-record-cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_CACHE_BYTE_ORDER 0x01020304
+
+typedef struct
+{
+    char magic[8];
+    guint32 byte_order;
+    guint32 n_records;
+    guint32 strings_size;
+    guint32 extra;
+} FmRecordHeader;
+
+struct _FmRecordWriter
+{
+    GByteArray *out; /* header and records */
+    GString *strings;
+    GHashTable *offsets; /* string -> offset in strings */
+    gsize record_size;
+};
+
+static char *record_cache_path(const char *name)
+{
+    return g_build_filename(g_get_user_cache_dir(), "libfm", name, NULL);
+}
+
+/* maps file @name from user cache directory into @rf; if file doesn't exist
+   or is invalid then @rf is left empty and FALSE is returned */
+gboolean _fm_record_file_load(FmRecordFile *rf, const char *name,
+                              const char *magic, gsize record_size)
+{
+    char *path = record_cache_path(name);
+    const FmRecordHeader *header;
+    const char *data;
+    gsize len;
+
+    memset(rf, 0, sizeof(*rf));
+    rf->record_size = record_size;
+    rf->file = g_mapped_file_new(path, FALSE, NULL);
+    g_free(path);
+    if (rf->file == NULL)
+        return FALSE;
+    data = g_mapped_file_get_contents(rf->file);
+    len = g_mapped_file_get_length(rf->file);
+    header = (const FmRecordHeader*)data;
+    if (len < sizeof(FmRecordHeader) ||
+        memcmp(header->magic, magic, sizeof(header->magic)) != 0 ||
+        header->byte_order != RECORD_CACHE_BYTE_ORDER ||
+        header->strings_size == 0 ||
+        len != sizeof(FmRecordHeader) + header->strings_size
+               + (gsize)header->n_records * record_size ||
+        data[len - 1] != '\0')
+    {
+        g_debug("ignoring invalid cache file %s", name);
+        _fm_record_file_unload(rf);
+        return FALSE;
+    }
+    rf->records = data + sizeof(FmRecordHeader);
+    rf->n_records = header->n_records;
+    rf->strings = rf->records + (gsize)rf->n_records * record_size;
+    rf->strings_size = header->strings_size;
+    rf->extra = header->extra;
+    return TRUE;
+}
+
+/* makes @dst refer the same mapping as @src, @dst should be unloaded later */
+void _fm_record_file_copy(FmRecordFile *dst, const FmRecordFile *src)
+{
+    *dst = *src;
+    if (dst->file)
+        g_mapped_file_ref(dst->file);
+}
+
+void _fm_record_file_unload(FmRecordFile *rf)
+{
+    gsize record_size = rf->record_size;
+
+    if (rf->file)
+        g_mapped_file_unref(rf->file);
+    memset(rf, 0, sizeof(*rf));
+    rf->record_size = record_size;
+}
+
+/* returns index of record for device @dev and inode @ino or -1 */
+gint _fm_record_file_find(const FmRecordFile *rf, guint64 dev, guint64 ino)
+{
+    gint lo = 0, hi = (gint)rf->n_records - 1;
+
+    while (lo <= hi)
+    {
+        gint mid = (lo + hi) / 2;
+        const FmRecordKey *rec = _fm_record_file_get(rf, mid);
+        if (rec->dev == dev && rec->ino == ino)
+            return mid;
+        if (rec->dev < dev || (rec->dev == dev && rec->ino < ino))
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+gboolean _fm_record_file_string_valid(const FmRecordFile *rf, guint32 offset)
+{
+    return offset == FM_RECORD_NO_STRING || offset < rf->strings_size;
+}
+
+/* hash and equal functions for tables of entries beginning with FmRecordKey */
+guint _fm_record_key_hash(gconstpointer key)
+{
+    const FmRecordKey *rk = key;
+    return (guint)(rk->ino ^ (rk->ino >> 32) ^ (rk->dev * 31));
+}
+
+gboolean _fm_record_key_equal(gconstpointer a, gconstpointer b)
+{
+    const FmRecordKey *rk_a = a, *rk_b = b;
+    return rk_a->ino == rk_b->ino && rk_a->dev == rk_b->dev;
+}
+
+static int record_key_cmp_inode(const void *a, const void *b)
+{
+    const FmRecordKey *rk_a = *(const FmRecordKey**)a;
+    const FmRecordKey *rk_b = *(const FmRecordKey**)b;
+    if (rk_a->dev != rk_b->dev)
+        return rk_a->dev < rk_b->dev ? -1 : 1;
+    if (rk_a->ino != rk_b->ino)
+        return rk_a->ino < rk_b->ino ? -1 : 1;
+    return 0;
+}
+
+/* @entries should be sorted most recently used first; drops the least
+   recently used ones above @limit and sorts the rest for writing */
+void _fm_record_keep_recent(GPtrArray *entries, guint limit)
+{
+    if (entries->len > limit)
+        g_ptr_array_set_size(entries, limit);
+    qsort(entries->pdata, entries->len, sizeof(gpointer), record_key_cmp_inode);
+}
+
+FmRecordWriter *_fm_record_writer_new(gsize record_size, guint n_records)
+{
+    FmRecordWriter *writer = g_slice_new(FmRecordWriter);
+    FmRecordHeader header;
+
+    writer->out = g_byte_array_sized_new(sizeof(header) + n_records * record_size);
+    memset(&header, 0, sizeof(header));
+    g_byte_array_append(writer->out, (guint8*)&header, sizeof(header));
+    writer->strings = g_string_new("");
+    writer->offsets = g_hash_table_new(g_str_hash, g_str_equal);
+    writer->record_size = record_size;
+    return writer;
+}
+
+/* adds @str to the table once, returns its offset; @str should be valid
+   until _fm_record_writer_save() */
+guint32 _fm_record_writer_add_string(FmRecordWriter *writer, const char *str)
+{
+    gpointer offset;
+
+    if (str == NULL)
+        return FM_RECORD_NO_STRING;
+    if (!g_hash_table_lookup_extended(writer->offsets, str, NULL, &offset))
+    {
+        offset = GUINT_TO_POINTER(writer->strings->len);
+        g_string_append_len(writer->strings, str, strlen(str) + 1);
+        g_hash_table_insert(writer->offsets, (gpointer)str, offset);
+    }
+    return GPOINTER_TO_UINT(offset);
+}
+
+/* records should be added sorted by device and inode */
+void _fm_record_writer_add(FmRecordWriter *writer, gconstpointer record)
+{
+    g_byte_array_append(writer->out, record, writer->record_size);
+}
+
+/* replaces file @name in user cache directory and frees @writer */
+gboolean _fm_record_writer_save(FmRecordWriter *writer, const char *name,
+                                const char *magic, guint32 extra)
+{
+    FmRecordHeader *header = (FmRecordHeader*)writer->out->data;
+    char *path, *dir;
+    gboolean ok;
+
+    if (writer->strings->len == 0) /* keep the file valid */
+        g_string_append_c(writer->strings, '\0');
+    memcpy(header->magic, magic, sizeof(header->magic));
+    header->byte_order = RECORD_CACHE_BYTE_ORDER;
+    header->n_records = (writer->out->len - sizeof(FmRecordHeader)) / writer->record_size;
+    header->strings_size = writer->strings->len;
+    header->extra = extra;
+    g_byte_array_append(writer->out, (guint8*)writer->strings->str,
+                        writer->strings->len);
+
+    path = record_cache_path(name);
+    dir = g_path_get_dirname(path);
+    /* g_file_set_contents() writes a temporary file and renames it */
+    ok = (g_mkdir_with_parents(dir, 0700) == 0 &&
+          g_file_set_contents(path, (char*)writer->out->data, writer->out->len, NULL));
+    g_free(dir);
+    g_free(path);
+    g_byte_array_free(writer->out, TRUE);
+    g_string_free(writer->strings, TRUE);
+    g_hash_table_destroy(writer->offsets);
+    g_slice_free(FmRecordWriter, writer);
+    return ok;
+}
@@ -0,0 +1,91 @@
+/*
+ *      fm-record-cache.h
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Persistent caches of data found for files, such as content types and
+ * parsed desktop entries. Each cache is a file in $XDG_CACHE_HOME/libfm
+ * made of a header, fixed size records sorted by device and inode, and a
+ * table of strings. The file is mapped into memory and is replaced
+ * atomically so other processes may keep using their old mapping.
+ * This API is internal for libfm and never exported. */
+
+#ifndef __FM_RECORD_CACHE_H__
+#define __FM_RECORD_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* offset of string in the table which means no string */
+#define FM_RECORD_NO_STRING G_MAXUINT32
+
+/* every record and every entry of cache in memory should begin with it,
+   record is valid while mtime and size of the file are the same */
+typedef struct
+{
+    guint64 dev;
+    guint64 ino;
+    gint64 mtime;
+    gint64 size;
+} FmRecordKey;
+
+typedef struct
+{
+    GMappedFile *file;
+    const char *records;
+    gsize record_size;
+    guint n_records;
+    const char *strings;
+    guint strings_size;
+    guint32 extra; /* value saved in header by the cache */
+} FmRecordFile;
+
+typedef struct _FmRecordWriter FmRecordWriter;
+
+gboolean _fm_record_file_load(FmRecordFile *rf, const char *name,
+                              const char *magic, gsize record_size);
+void _fm_record_file_copy(FmRecordFile *dst, const FmRecordFile *src);
+void _fm_record_file_unload(FmRecordFile *rf);
+gint _fm_record_file_find(const FmRecordFile *rf, guint64 dev, guint64 ino);
+gboolean _fm_record_file_string_valid(const FmRecordFile *rf, guint32 offset);
+
+static inline const FmRecordKey *_fm_record_file_get(const FmRecordFile *rf, guint i)
+{
+    return (const FmRecordKey*)(rf->records + (gsize)i * rf->record_size);
+}
+
+static inline const char *_fm_record_file_get_string(const FmRecordFile *rf,
+                                                     guint32 offset)
+{
+    return offset == FM_RECORD_NO_STRING ? NULL : rf->strings + offset;
+}
+
+guint _fm_record_key_hash(gconstpointer key);
+gboolean _fm_record_key_equal(gconstpointer a, gconstpointer b);
+void _fm_record_keep_recent(GPtrArray *entries, guint limit);
+
+FmRecordWriter *_fm_record_writer_new(gsize record_size, guint n_records);
+guint32 _fm_record_writer_add_string(FmRecordWriter *writer, const char *str);
+void _fm_record_writer_add(FmRecordWriter *writer, gconstpointer record);
+gboolean _fm_record_writer_save(FmRecordWriter *writer, const char *name,
+                                const char *magic, guint32 extra);
+
+G_END_DECLS
+
+#endif /* __FM_RECORD_CACHE_H__ */
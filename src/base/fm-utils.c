@@ -607,3 +607,66 @@ void fm_strcatv(char ***strvp, char * const *astrv)
     g_free(*strvp);
     *strvp = new_strv;
 }
+
+/* ---- small objects allocator ---- */
+/* FmPath and FmFileInfo objects are created by millions while big trees
+   are listed, they are allocated with GSlice which keeps per-thread
+   magazines of freed blocks, and only counted here. */
+static volatile gsize objects_in_use = 0;
+static volatile gint objects_n = 0;
+#if !GLIB_CHECK_VERSION(2, 30, 0)
+G_LOCK_DEFINE_STATIC(objects_in_use);
+#endif
+
+static inline void _fm_object_count(gssize size, gint n)
+{
+#if GLIB_CHECK_VERSION(2, 30, 0)
+    g_atomic_pointer_add(&objects_in_use, size);
+#else
+    G_LOCK(objects_in_use);
+    objects_in_use += size;
+    G_UNLOCK(objects_in_use);
+#endif
+    g_atomic_int_add(&objects_n, n);
+}
+
+/* allocates @size bytes for FmPath or FmFileInfo object, the memory is
+   not initialized; should be freed with _fm_object_free() with the same size */
+gpointer _fm_object_alloc(gsize size)
+{
+    _fm_object_count(size, 1);
+    return g_slice_alloc(size);
+}
+
+void _fm_object_free(gpointer mem, gsize size)
+{
+    g_slice_free1(size, mem);
+    _fm_object_count(-(gssize)size, -1);
+}
+
+/**
+ * fm_get_allocator_stats
+ * @in_use: (out) (allow-none): location to store size of live objects
+ * @n_objects: (out) (allow-none): location to store number of live objects
+ *
+ * Retrieves memory usage of #FmPath and #FmFileInfo objects. The @in_use
+ * is total size of objects which are alive now, not including overhead
+ * of the allocator.
+ *
+ * Since: 1.3.2
+ */
+void fm_get_allocator_stats(gsize *in_use, guint *n_objects)
+{
+    if (in_use)
+#if GLIB_CHECK_VERSION(2, 30, 0)
+        *in_use = (gsize)g_atomic_pointer_get(&objects_in_use);
+#else
+    {
+        G_LOCK(objects_in_use);
+        *in_use = objects_in_use;
+        G_UNLOCK(objects_in_use);
+    }
+#endif
+    if (n_objects)
+        *n_objects = g_atomic_int_get(&objects_n);
+}
@@ -80,6 +80,12 @@ const char *fm_get_home_dir(void);
 char *fm_uri_subpath_to_native_subpath(const char *subpath, GError **error);
 void fm_strcatv(char ***strvp, char * const *astrv);
 
+void fm_get_allocator_stats(gsize *in_use, guint *n_objects);
+
+/* for internal usage by FmPath and FmFileInfo - never use in applications */
+gpointer _fm_object_alloc(gsize size);
+void _fm_object_free(gpointer mem, gsize size);
+
 G_END_DECLS
 
 #endif
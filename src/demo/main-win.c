@@ -887,7 +887,7 @@ void on_go_apps(GtkAction* act, FmMainWin* win)
 static void on_reload(GtkAction* act, FmMainWin* win)
 {
     if(win->folder)
-        fm_folder_reload(win->folder);
+        fm_folder_refresh(win->folder);
 }
 
 void fm_main_win_chdir_by_name(FmMainWin* win, const char* path_str)
@@ -89,6 +89,16 @@ static inline GSList *g_slist_copy_deep(GSList *list, GCopyFunc func, gpointer u
 }
 #endif
 
+#if !GLIB_CHECK_VERSION(2, 28, 0)
+/* This API was added in glib 2.28, use wall clock as the best guess */
+static inline gint64 g_get_monotonic_time(void)
+{
+    GTimeVal tv;
+    g_get_current_time(&tv);
+    return (gint64)tv.tv_sec * G_USEC_PER_SEC + tv.tv_usec;
+}
+#endif
+
 G_END_DECLS
 
 #endif
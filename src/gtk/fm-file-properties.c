@@ -1469,6 +1469,8 @@ GtkDialog* fm_file_properties_widget_new(FmFileInfoList* files, gboolean topleve
     g_signal_connect(data->icon_eventbox, "key-press-event",
                      G_CALLBACK(_icon_press_event), data);
 
+    /* the user is waiting for the result in the dialog */
+    fm_job_set_priority(FM_JOB(data->dc_job), FM_JOB_PRIORITY_INTERACTIVE);
     if (!fm_job_run_async(FM_JOB(data->dc_job)))
     {
         g_object_unref(data->dc_job);
@@ -89,6 +89,7 @@ static void fm_deep_count_job_dispose(GObject *object)
 static void fm_deep_count_job_init(FmDeepCountJob *self)
 {
     fm_job_init_cancellable(FM_JOB(self));
+    fm_job_set_priority(FM_JOB(self), FM_JOB_PRIORITY_BACKGROUND);
 }
 
 /**
@@ -40,7 +40,16 @@
 #include <glib/gi18n-lib.h>
 #include <gio/gio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <glib/gstdio.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #include "fm-mime-type.h"
 #include "fm-file-info-job.h"
 #include "glib-compat.h"
@@ -52,7 +61,89 @@ enum {
     N_SIGNALS
 };
 
+/* worker thread hands found files to the main thread by chunks: either
+   when chunk reaches this size or when this time has passed since the
+   last handoff, whichever comes first; worker never waits on UI */
+#define FILES_CHUNK_SIZE        256
+#define FILES_CHUNK_USEC        (50 * 1000)
+/* main thread emits FmDirListJob::files-found with at most that many files
+   at once, the next batch will be emitted after the interval below */
+#define FILES_FOUND_MAX_BATCH   4096
+#define FILES_FOUND_INTERVAL    200 /* msec */
+
+#ifndef DT_UNKNOWN
+# define DT_UNKNOWN 0
+# define DT_DIR 4
+# define DT_LNK 10
+#endif
+#ifndef O_CLOEXEC
+# define O_CLOEXEC 0
+#endif
+#ifndef DTTOIF
+# define DTTOIF(dirtype) ((dirtype) << 12)
+#endif
+
+#if defined(__linux__) && defined(SYS_getdents64)
+# define USE_GETDENTS64 1
+/* size of buffer for directory entries, it's much larger than readdir() uses
+   so it needs less syscalls for large directories */
+# define NATIVE_DIR_BUF_SIZE (128 * 1024)
+struct native_dirent64
+{
+    guint64 d_ino;
+    gint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+/* enumerator of native directory, opens it once and reads entries in large
+   chunks, giving entry type if file system supports it; if gvfs-metadata
+   is available then entries are read via GIO instead so emblems of each
+   entry come with its name in the same pass */
+typedef struct
+{
+    int fd;
+#ifdef USE_GETDENTS64
+    char *buf;
+    long len;
+    long pos;
+#else
+    DIR *dir;
+#endif
+    GFileEnumerator *enu;
+    GFileInfo *inf; /* current entry if enu is used */
+} FmNativeDir;
+
+typedef struct _FmDirListJobPrivate FmDirListJobPrivate;
+struct _FmDirListJobPrivate
+{
+#if GLIB_CHECK_VERSION(2, 32, 0)
+    GMutex lock; /* guards files handed off to main thread */
+#else
+    GStaticMutex lock;
+#endif
+    GSList* files_to_add_tail; /* handed off to main thread, under lock */
+    guint n_files_to_add;
+    guint n_batches;
+    GSList* files_pending; /* collected by worker, not yet handed off */
+    GSList* files_pending_tail;
+    guint n_pending;
+    gint64 last_flush;
+    FmFileInfoAttrMask attrs;
+};
+
+#define FM_DIR_LIST_JOB_GET_PRIVATE(job) \
+    G_TYPE_INSTANCE_GET_PRIVATE((job), FM_TYPE_DIR_LIST_JOB, FmDirListJobPrivate)
+
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+#define g_mutex_lock g_static_mutex_lock
+#define g_mutex_unlock g_static_mutex_unlock
+#endif
+
 static void fm_dir_list_job_dispose              (GObject *object);
+static void fm_dir_list_job_finalize             (GObject *object);
 G_DEFINE_TYPE(FmDirListJob, fm_dir_list_job, FM_TYPE_JOB);
 
 static int signals[N_SIGNALS];
@@ -61,6 +152,7 @@ static gboolean fm_dir_list_job_run(FmJob *job);
 static void fm_dir_list_job_finished(FmJob* job);
 
 static gboolean emit_found_files(gpointer user_data);
+static void flush_pending_files(FmDirListJob* job);
 
 static void fm_dir_list_job_class_init(FmDirListJobClass *klass)
 {
@@ -68,7 +160,8 @@ static void fm_dir_list_job_class_init(FmDirListJobClass *klass)
     FmJobClass* job_class = FM_JOB_CLASS(klass);
     g_object_class = G_OBJECT_CLASS(klass);
     g_object_class->dispose = fm_dir_list_job_dispose;
-    /* use finalize from parent class */
+    g_object_class->finalize = fm_dir_list_job_finalize;
+    g_type_class_add_private(klass, sizeof(FmDirListJobPrivate));
 
     job_class->run = fm_dir_list_job_run;
     job_class->finished = fm_dir_list_job_finished;
@@ -78,10 +171,13 @@ static void fm_dir_list_job_class_init(FmDirListJobClass *klass)
      * @job: a job that emitted the signal
      * @files: (element-type FmFileInfo): #GSList of found files
      *
-     * The #FmDirListJob::files-found signal is emitted for every file
-     * found during directory listing. By default the signal is not
-     * emitted for performance reason. This can be turned on by calling
-     * fm_dir_list_job_set_incremental().
+     * The #FmDirListJob::files-found signal is emitted for files found
+     * during directory listing. Files are collected by the worker thread
+     * and delivered in batches: the first batch is emitted as soon as the
+     * main loop is idle, and the next ones are emitted at most every
+     * 200 milliseconds with no more than 4096 files each. By default the
+     * signal is not emitted for performance reason. This can be turned on
+     * by calling fm_dir_list_job_set_incremental().
      *
      * Since: 1.0.2
      */
@@ -99,7 +195,15 @@ static void fm_dir_list_job_class_init(FmDirListJobClass *klass)
 
 static void fm_dir_list_job_init(FmDirListJob *job)
 {
+    FmDirListJobPrivate *priv = FM_DIR_LIST_JOB_GET_PRIVATE(job);
+
     job->files = fm_file_info_list_new();
+    priv->attrs = FM_FILE_INFO_ATTR_ALL;
+#if GLIB_CHECK_VERSION(2, 32, 0)
+    g_mutex_init(&priv->lock);
+#else
+    g_static_mutex_init(&priv->lock);
+#endif
     fm_job_init_cancellable(FM_JOB(job));
 }
 
@@ -167,11 +271,13 @@ FmDirListJob* fm_dir_list_job_new_for_gfile(GFile* gf)
 static void fm_dir_list_job_dispose(GObject *object)
 {
     FmDirListJob *job;
+    FmDirListJobPrivate *priv;
 
     g_return_if_fail(object != NULL);
     g_return_if_fail(FM_IS_DIR_LIST_JOB(object));
 
     job = (FmDirListJob*)object;
+    priv = FM_DIR_LIST_JOB_GET_PRIVATE(job);
 
     if(job->dir_path)
     {
@@ -191,18 +297,38 @@ static void fm_dir_list_job_dispose(GObject *object)
         job->files = NULL;
     }
 
+    g_mutex_lock(&priv->lock);
     if(job->delay_add_files_handler)
     {
         g_source_remove(job->delay_add_files_handler);
         job->delay_add_files_handler = 0;
-        g_slist_free_full(job->files_to_add, (GDestroyNotify)fm_file_info_unref);
-        job->files_to_add = NULL;
     }
+    g_slist_free_full(job->files_to_add, (GDestroyNotify)fm_file_info_unref);
+    job->files_to_add = priv->files_to_add_tail = NULL;
+    priv->n_files_to_add = 0;
+    g_mutex_unlock(&priv->lock);
+
+    g_slist_free_full(priv->files_pending, (GDestroyNotify)fm_file_info_unref);
+    priv->files_pending = priv->files_pending_tail = NULL;
+    priv->n_pending = 0;
 
     if (G_OBJECT_CLASS(fm_dir_list_job_parent_class)->dispose)
         (* G_OBJECT_CLASS(fm_dir_list_job_parent_class)->dispose)(object);
 }
 
+static void fm_dir_list_job_finalize(GObject *object)
+{
+    FmDirListJobPrivate *priv = FM_DIR_LIST_JOB_GET_PRIVATE(object);
+
+#if GLIB_CHECK_VERSION(2, 32, 0)
+    g_mutex_clear(&priv->lock);
+#else
+    g_static_mutex_free(&priv->lock);
+#endif
+
+    G_OBJECT_CLASS(fm_dir_list_job_parent_class)->finalize(object);
+}
+
 static inline FmFileInfo *_new_info_for_native_file(FmDirListJob* job, FmPath* path, const char* path_str, GError** err)
 {
     FmFileInfo *fi;
@@ -219,13 +345,184 @@ static inline FmFileInfo *_new_info_for_native_file(FmDirListJob* job, FmPath* p
     return NULL;
 }
 
+static inline FmFileInfo *_new_info_for_native_child(FmDirListJob* job, FmPath* path,
+                                                     int dirfd, const char* name,
+                                                     const char* dir_path, GError** err)
+{
+    FmDirListJobPrivate *priv = FM_DIR_LIST_JOB_GET_PRIVATE(job);
+
+    if (fm_job_is_cancelled(FM_JOB(job)))
+        return NULL;
+    return _fm_file_info_new_from_native_file_at(path, dirfd, name, dir_path, err,
+                                                 !(job->flags & FM_DIR_LIST_JOB_DETAILED),
+                                                 priv->attrs);
+}
+
+/* returns TRUE if gvfs-metadata store is available for the directory */
+static gboolean native_dir_has_metadata(GFile *gf, GCancellable *cancellable)
+{
+    GFileAttributeInfoList *list;
+    gboolean ret = FALSE;
+
+    list = g_file_query_writable_namespaces(gf, cancellable, NULL);
+    if (list)
+    {
+        ret = (g_file_attribute_info_list_lookup(list, "metadata") != NULL);
+        g_file_attribute_info_list_unref(list);
+    }
+    return ret;
+}
+
+static gboolean native_dir_open(FmNativeDir *nd, const char *path,
+                                gboolean with_emblems,
+                                GCancellable *cancellable, GError **err)
+{
+    int errsv;
+
+    nd->enu = NULL;
+    nd->inf = NULL;
+    nd->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (nd->fd < 0)
+        goto _failed;
+    if (with_emblems)
+    {
+        GFile *gf = g_file_new_for_path(path);
+
+        if (native_dir_has_metadata(gf, cancellable))
+            nd->enu = g_file_enumerate_children(gf, G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                                G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                                "metadata::emblems",
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                cancellable, NULL);
+        g_object_unref(gf);
+        if (nd->enu)
+            return TRUE;
+        /* fallback to reading directory without emblems */
+    }
+#ifdef USE_GETDENTS64
+    nd->buf = g_malloc(NATIVE_DIR_BUF_SIZE);
+    nd->len = nd->pos = 0;
+#else
+    nd->dir = fdopendir(nd->fd);
+    if (nd->dir == NULL)
+    {
+        errsv = errno;
+        close(nd->fd);
+        errno = errsv;
+        goto _failed;
+    }
+#endif
+    return TRUE;
+
+_failed:
+    errsv = errno;
+    g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errsv),
+                _("Error opening directory '%s': %s"), path, g_strerror(errsv));
+    return FALSE;
+}
+
+/* returns name of next entry or NULL at end of directory, "." and ".." are
+   skipped; name is valid only until next call */
+static const char *native_dir_read_name(FmNativeDir *nd, unsigned char *type,
+                                        GCancellable *cancellable)
+{
+#ifdef USE_GETDENTS64
+    struct native_dirent64 *de;
+#else
+    struct dirent *de;
+#endif
+
+    if (nd->enu)
+    {
+        if (nd->inf)
+            g_object_unref(nd->inf);
+        nd->inf = g_file_enumerator_next_file(nd->enu, cancellable, NULL);
+        if (nd->inf == NULL)
+            return NULL;
+        switch (g_file_info_get_file_type(nd->inf))
+        {
+        case G_FILE_TYPE_DIRECTORY:
+            *type = DT_DIR;
+            break;
+        case G_FILE_TYPE_SYMBOLIC_LINK:
+            *type = DT_LNK;
+            break;
+        default:
+            /* it isn't needed to know exact type of other files */
+            *type = DT_UNKNOWN;
+        }
+        return g_file_info_get_name(nd->inf);
+    }
+#ifdef USE_GETDENTS64
+
+    for (;;)
+    {
+        if (nd->pos >= nd->len)
+        {
+            nd->len = syscall(SYS_getdents64, nd->fd, nd->buf, NATIVE_DIR_BUF_SIZE);
+            nd->pos = 0;
+            if (nd->len <= 0) /* end of directory or error */
+                return NULL;
+        }
+        de = (struct native_dirent64 *)(nd->buf + nd->pos);
+        nd->pos += de->d_reclen;
+        if (de->d_name[0] == '.' && (de->d_name[1] == '\0' ||
+            (de->d_name[1] == '.' && de->d_name[2] == '\0')))
+            continue;
+        *type = de->d_type;
+        return de->d_name;
+    }
+#else
+    while ((de = readdir(nd->dir)) != NULL)
+    {
+        if (de->d_name[0] == '.' && (de->d_name[1] == '\0' ||
+            (de->d_name[1] == '.' && de->d_name[2] == '\0')))
+            continue;
+#ifdef _DIRENT_HAVE_D_TYPE
+        *type = de->d_type;
+#else
+        *type = DT_UNKNOWN;
+#endif
+        return de->d_name;
+    }
+    return NULL;
+#endif
+}
+
+/* returns emblem names of entry last returned by native_dir_read_name() */
+static inline char **native_dir_get_emblems(FmNativeDir *nd)
+{
+    if (nd->inf)
+        return g_file_info_get_attribute_stringv(nd->inf, "metadata::emblems");
+    return NULL;
+}
+
+static void native_dir_close(FmNativeDir *nd)
+{
+    if (nd->enu)
+    {
+        if (nd->inf)
+            g_object_unref(nd->inf);
+        g_file_enumerator_close(nd->enu, NULL, NULL);
+        g_object_unref(nd->enu);
+        close(nd->fd);
+        return;
+    }
+#ifdef USE_GETDENTS64
+    g_free(nd->buf);
+    close(nd->fd);
+#else
+    closedir(nd->dir); /* closes nd->fd as well */
+#endif
+}
+
 static gboolean fm_dir_list_job_run_posix(FmDirListJob* job)
 {
     FmJob* fmjob = FM_JOB(job);
     FmFileInfo* fi;
     GError *err = NULL;
     char* path_str;
-    GDir* dir;
+    FmNativeDir dir;
 
     path_str = fm_path_to_str(job->dir_path);
 
@@ -256,36 +553,36 @@ static gboolean fm_dir_list_job_run_posix(FmDirListJob* job)
         return FALSE;
     }
 
-    dir = g_dir_open(path_str, 0, &err);
-    if( dir )
+    /* views of directories only don't show emblems at all */
+    if(native_dir_open(&dir, path_str, !(job->flags & FM_DIR_LIST_JOB_DIR_ONLY),
+                       fm_job_get_cancellable(fmjob), &err))
     {
         const char* name;
-        GString* fpath = g_string_sized_new(4096);
-        int dir_len = strlen(path_str);
-        g_string_append_len(fpath, path_str, dir_len);
-        if(fpath->str[dir_len-1] != '/')
-        {
-            g_string_append_c(fpath, '/');
-            ++dir_len;
-        }
-        while( ! fm_job_is_cancelled(fmjob) && (name = g_dir_read_name(dir)) )
+        unsigned char type;
+
+        while( ! fm_job_is_cancelled(fmjob) &&
+               (name = native_dir_read_name(&dir, &type, fm_job_get_cancellable(fmjob))) )
         {
             FmPath* new_path;
-            g_string_truncate(fpath, dir_len);
-            g_string_append(fpath, name);
 
             if(job->flags & FM_DIR_LIST_JOB_DIR_ONLY) /* if we only want directories */
             {
-                struct stat st;
-                /* FIXME: this results in an additional stat() call, which is inefficient */
-                if(stat(fpath->str, &st) == -1 || !S_ISDIR(st.st_mode))
+                /* trust d_type if file system provides it, so we stat()
+                   only symlinks and entries of unknown type */
+                if(type == DT_UNKNOWN || type == DT_LNK)
+                {
+                    struct stat st;
+                    if(fstatat(dir.fd, name, &st, 0) == -1 || !S_ISDIR(st.st_mode))
+                        continue;
+                }
+                else if(type != DT_DIR)
                     continue;
             }
 
             new_path = fm_path_new_child(job->dir_path, name);
 
         _retry:
-            fi = _new_info_for_native_file(job, new_path, fpath->str, &err);
+            fi = _new_info_for_native_child(job, new_path, dir.fd, name, path_str, &err);
             if (fi == NULL && !fm_job_is_cancelled(fmjob)) /* we got a damaged file */
             {
                 FmJobErrorAction act = fm_job_emit_error(fmjob, err, FM_JOB_ERROR_MILD);
@@ -303,7 +600,7 @@ static gboolean fm_dir_list_job_run_posix(FmDirListJob* job)
                 gf = fm_path_to_gfile(new_path);
                 g_file_info_set_file_type(inf, G_FILE_TYPE_UNKNOWN);
                 g_file_info_set_name(inf, name);
-                disp_basename = g_filename_display_basename(fpath->str);
+                disp_basename = g_filename_display_name(name);
                 g_file_info_set_display_name(inf, disp_basename);
                 g_free(disp_basename);
                 g_file_info_set_content_type(inf, "inode/x-corrupted");
@@ -311,12 +608,15 @@ static gboolean fm_dir_list_job_run_posix(FmDirListJob* job)
                 g_object_unref(inf);
                 g_object_unref(gf);
             }
-            fm_dir_list_job_add_found_file(job, fi);
-            fm_file_info_unref(fi);
+            if(fi) /* it's NULL if job was cancelled */
+            {
+                _fm_file_info_add_emblems(fi, native_dir_get_emblems(&dir));
+                fm_dir_list_job_add_found_file(job, fi);
+                fm_file_info_unref(fi);
+            }
             fm_path_unref(new_path);
         }
-        g_string_free(fpath, TRUE);
-        g_dir_close(dir);
+        native_dir_close(&dir);
     }
     else
     {
@@ -464,20 +764,37 @@ static gboolean fm_dir_list_job_run(FmJob* fmjob)
         ret = fm_dir_list_job_run_posix(job);
     else /* this is a virtual path or remote file system path */
         ret = fm_dir_list_job_run_gio(job);
+    /* hand off the rest of files to the main thread */
+    if(job->emit_files_found)
+        flush_pending_files(job);
     return ret;
 }
 
 static void fm_dir_list_job_finished(FmJob* job)
 {
     FmDirListJob* dirlist_job = FM_DIR_LIST_JOB(job);
+    FmDirListJobPrivate *priv = FM_DIR_LIST_JOB_GET_PRIVATE(dirlist_job);
     FmJobClass* job_class = FM_JOB_CLASS(fm_dir_list_job_parent_class);
 
     if(dirlist_job->emit_files_found)
     {
+        GSList *files;
+
+        /* the worker is done so emit everything left at once */
+        g_mutex_lock(&priv->lock);
         if(dirlist_job->delay_add_files_handler)
         {
             g_source_remove(dirlist_job->delay_add_files_handler);
-            emit_found_files(dirlist_job);
+            dirlist_job->delay_add_files_handler = 0;
+        }
+        files = dirlist_job->files_to_add;
+        dirlist_job->files_to_add = priv->files_to_add_tail = NULL;
+        priv->n_files_to_add = 0;
+        g_mutex_unlock(&priv->lock);
+        if(files)
+        {
+            g_signal_emit(dirlist_job, signals[FILES_FOUND], 0, files);
+            g_slist_free_full(files, (GDestroyNotify)fm_file_info_unref);
         }
     }
     if(job_class->finished)
@@ -558,28 +875,62 @@ static gboolean emit_found_files(gpointer user_data)
 {
     /* this callback is called from the main thread */
     FmDirListJob* job = FM_DIR_LIST_JOB(user_data);
-    /* g_print("emit_found_files: %d\n", g_slist_length(job->files_to_add)); */
+    FmDirListJobPrivate *priv = FM_DIR_LIST_JOB_GET_PRIVATE(job);
+    GSList *files, *last;
 
     if(g_source_is_destroyed(g_main_current_source()))
         return FALSE;
-    g_signal_emit(job, signals[FILES_FOUND], 0, job->files_to_add);
-    g_slist_free_full(job->files_to_add, (GDestroyNotify)fm_file_info_unref);
-    job->files_to_add = NULL;
-    job->delay_add_files_handler = 0;
+    g_mutex_lock(&priv->lock);
+    files = job->files_to_add;
+    if(priv->n_files_to_add > FILES_FOUND_MAX_BATCH)
+    {
+        /* emit only first part now, leave the rest for the next call;
+           the first timer has no delay so always re-arm it throttled */
+        last = g_slist_nth(files, FILES_FOUND_MAX_BATCH - 1);
+        job->files_to_add = last->next;
+        last->next = NULL;
+        priv->n_files_to_add -= FILES_FOUND_MAX_BATCH;
+        job->delay_add_files_handler = g_timeout_add_full(G_PRIORITY_LOW,
+                        FILES_FOUND_INTERVAL, emit_found_files,
+                        g_object_ref(job), g_object_unref);
+    }
+    else
+    {
+        job->files_to_add = priv->files_to_add_tail = NULL;
+        priv->n_files_to_add = 0;
+        job->delay_add_files_handler = 0;
+    }
+    priv->n_batches++;
+    g_mutex_unlock(&priv->lock);
+    /* g_print("emit_found_files: %d\n", g_slist_length(files)); */
+    g_signal_emit(job, signals[FILES_FOUND], 0, files);
+    g_slist_free_full(files, (GDestroyNotify)fm_file_info_unref);
     return FALSE;
 }
 
-static gpointer queue_add_file(FmJob* fmjob, gpointer user_data)
+/* this is called from the worker thread, it never waits for main thread */
+static void flush_pending_files(FmDirListJob* job)
 {
-    FmDirListJob* job = FM_DIR_LIST_JOB(fmjob);
-    FmFileInfo* file = FM_FILE_INFO(user_data);
-    /* this callback is called from the main thread */
-    /* g_print("queue_add_file: %s\n", fm_file_info_get_disp_name(file)); */
-    job->files_to_add = g_slist_prepend(job->files_to_add, fm_file_info_ref(file));
+    FmDirListJobPrivate *priv = FM_DIR_LIST_JOB_GET_PRIVATE(job);
+
+    if(priv->files_pending == NULL)
+        return;
+    g_mutex_lock(&priv->lock);
+    if(priv->files_to_add_tail)
+        priv->files_to_add_tail->next = priv->files_pending;
+    else
+        job->files_to_add = priv->files_pending;
+    priv->files_to_add_tail = priv->files_pending_tail;
+    priv->n_files_to_add += priv->n_pending;
     if(job->delay_add_files_handler == 0)
-        job->delay_add_files_handler = g_timeout_add_seconds_full(G_PRIORITY_LOW,
-                        1, emit_found_files, g_object_ref(job), g_object_unref);
-    return NULL;
+        /* deliver the first batch ASAP, then throttle */
+        job->delay_add_files_handler = g_timeout_add_full(G_PRIORITY_LOW,
+                        priv->n_batches ? FILES_FOUND_INTERVAL : 0,
+                        emit_found_files, g_object_ref(job), g_object_unref);
+    g_mutex_unlock(&priv->lock);
+    priv->files_pending = priv->files_pending_tail = NULL;
+    priv->n_pending = 0;
+    priv->last_flush = g_get_monotonic_time();
 }
 
 /**
@@ -596,15 +947,32 @@ static gpointer queue_add_file(FmJob* fmjob, gpointer user_data)
  * If emission of the #FmDirListJob::files-found signal is turned on by
  * fm_dir_list_job_set_incremental(), the signal will be emitted
  * for the newly found files after several new files are added.
+ * This call never waits for the main thread.
  * See the document for the signal for more detail.
  *
  * Since: 1.0.2
  */
 void fm_dir_list_job_add_found_file(FmDirListJob* job, FmFileInfo* file)
 {
+    FmDirListJobPrivate *priv = FM_DIR_LIST_JOB_GET_PRIVATE(job);
+
+    _fm_file_info_prepare_collate_keys(file, priv->attrs);
     fm_file_info_list_push_tail(job->files, file);
     if(G_UNLIKELY(job->emit_files_found))
-        fm_job_call_main_thread(FM_JOB(job), queue_add_file, file);
+    {
+        GSList *l = g_slist_alloc();
+
+        /* append to the local chunk, lock is not needed for it */
+        l->data = fm_file_info_ref(file);
+        if(priv->files_pending_tail)
+            priv->files_pending_tail->next = l;
+        else
+            priv->files_pending = l;
+        priv->files_pending_tail = l;
+        if(++priv->n_pending >= FILES_CHUNK_SIZE ||
+           g_get_monotonic_time() - priv->last_flush >= FILES_CHUNK_USEC)
+            flush_pending_files(job);
+    }
 }
 
 #if 0
@@ -658,3 +1026,25 @@ void fm_dir_list_job_set_incremental(FmDirListJob* job, gboolean set)
 {
     job->emit_files_found = set;
 }
+
+/**
+ * fm_dir_list_job_set_attributes
+ * @job: the job descriptor
+ * @attrs: attributes to retrieve
+ *
+ * Sets which attributes of native files should be retrieved by the @job.
+ * Attributes not in @attrs are not queried from the file system and
+ * will be reported as zero by #FmFileInfo getters. For example, a
+ * view which shows only name, size, and modification time may use
+ * %FM_FILE_INFO_ATTR_SIZE | %FM_FILE_INFO_ATTR_MTIME here. Default is
+ * %FM_FILE_INFO_ATTR_ALL. Collate keys requested in @attrs are computed
+ * for files of any file system before they are handed to the main thread.
+ * This should only be called before the @job is launched.
+ *
+ * Since: 1.3.2
+ */
+void fm_dir_list_job_set_attributes(FmDirListJob *job, FmFileInfoAttrMask attrs)
+{
+    FM_DIR_LIST_JOB_GET_PRIVATE(job)->attrs = attrs;
+}
+
@@ -96,6 +96,7 @@ FmDirListJob   *fm_dir_list_job_new2(FmPath *path, FmDirListJobFlags flags);
 FmDirListJob*   fm_dir_list_job_new_for_gfile(GFile* gf);
 FmFileInfoList* fm_dir_list_job_get_files(FmDirListJob* job);
 void            fm_dir_list_job_set_incremental(FmDirListJob* job, gboolean set);
+void            fm_dir_list_job_set_attributes(FmDirListJob *job, FmFileInfoAttrMask attrs);
 
 /*
 FmPath* fm_dir_list_job_get_dir_path(FmDirListJob* job);
@@ -38,6 +38,7 @@
 #include <sys/stat.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "fm-file-info.h"
 
@@ -53,6 +54,16 @@ enum {
 
 static int signals[N_SIGNALS];
 
+typedef struct _FmFileInfoJobPrivate FmFileInfoJobPrivate;
+struct _FmFileInfoJobPrivate
+{
+    FmFileInfoAttrMask attrs;
+    FmPath* reported; /* path of file in #FmFileInfoJob::got-info emission */
+};
+
+#define FM_FILE_INFO_JOB_GET_PRIVATE(job) \
+    G_TYPE_INSTANCE_GET_PRIVATE((job), FM_TYPE_FILE_INFO_JOB, FmFileInfoJobPrivate)
+
 G_DEFINE_TYPE(FmFileInfoJob, fm_file_info_job, FM_TYPE_JOB);
 
 static void fm_file_info_job_class_init(FmFileInfoJobClass *klass)
@@ -60,6 +71,8 @@ static void fm_file_info_job_class_init(FmFileInfoJobClass *klass)
     GObjectClass *g_object_class;
     FmJobClass* job_class;
 
+    g_type_class_add_private(klass, sizeof(FmFileInfoJobPrivate));
+
     g_object_class = G_OBJECT_CLASS(klass);
     g_object_class->dispose = fm_file_info_job_dispose;
     /* use finalize from parent class */
@@ -75,6 +88,11 @@ static void fm_file_info_job_class_init(FmFileInfoJobClass *klass)
      * The #FmDirInfoJob::got-info signal is emitted for every file info
      * during a job with FM_FILE_INFO_JOB_EMIT_FOR_EACH_FILE flag set.
      * This signal may be emitted only if info retrieving was successful.
+     * Since 1.3.2 the job doesn't wait for handlers of the signal, it is
+     * emitted in batches but still before the #FmJob::finished signal.
+     * Handlers should use @info, the job may be already processing other
+     * files by that time. fm_file_info_job_get_current() returns path of
+     * @info while the signal is emitted.
      *
      * Since: 1.2.0
      */
@@ -115,7 +133,9 @@ static void fm_file_info_job_dispose(GObject *object)
 static void fm_file_info_job_init(FmFileInfoJob *self)
 {
     self->file_infos = fm_file_info_list_new();
+    FM_FILE_INFO_JOB_GET_PRIVATE(self)->attrs = FM_FILE_INFO_ATTR_ALL;
     fm_job_init_cancellable(FM_JOB(self));
+    fm_job_set_priority(FM_JOB(self), FM_JOB_PRIORITY_REFRESH);
 }
 
 /**
@@ -192,25 +212,60 @@ static void _check_gfile_display_names(FmPath *path, GFile *child)
 static gpointer _emit_current_file(FmJob* job, gpointer user_data)
 {
     /* this callback is called from the main thread */
+    FmFileInfoJobPrivate *priv = FM_FILE_INFO_JOB_GET_PRIVATE(job);
+    FmPath *saved = priv->reported;
+
+    /* job->current is already changed by worker thread, so keep path of
+       reported file for fm_file_info_job_get_current() */
+    priv->reported = fm_file_info_get_path(user_data);
     g_signal_emit(job, signals[GOT_INFO], 0, user_data);
+    priv->reported = saved;
     return NULL;
 }
 
+/* number of next files kept being read with FM_FILE_INFO_JOB_READAHEAD */
+#define READAHEAD_WINDOW 32
+
+static void _read_ahead(FmFileInfo *fi)
+{
+    FmPath *path = fm_file_info_get_path(fi);
+
+    if (fm_path_is_native(path))
+    {
+        char *path_str = fm_path_to_str(path);
+        _fm_mime_type_read_ahead_native_file(path_str);
+        g_free(path_str);
+    }
+}
+
 static gboolean fm_file_info_job_run(FmJob* fmjob)
 {
     GList* l;
+    GList* ahead; /* the first file not read ahead yet */
+    guint n_ahead = 0; /* number of files from l to ahead */
     FmFileInfoJob* job = (FmFileInfoJob*)fmjob;
+    FmFileInfoAttrMask attrs = FM_FILE_INFO_JOB_GET_PRIVATE(job)->attrs;
     GError* err = NULL;
 
     if(job->file_infos == NULL)
         return FALSE;
 
-    for(l = fm_file_info_list_peek_head_link(job->file_infos); !fm_job_is_cancelled(fmjob) && l;)
+    l = fm_file_info_list_peek_head_link(job->file_infos);
+    ahead = (job->flags & FM_FILE_INFO_JOB_READAHEAD) ? l : NULL;
+    for(; !fm_job_is_cancelled(fmjob) && l;)
     {
         FmFileInfo* fi = (FmFileInfo*)l->data;
         GList* next = l->next;
         FmPath* path = fm_file_info_get_path(fi);
 
+        /* links before ahead are never deleted except current one */
+        while(ahead && n_ahead < READAHEAD_WINDOW)
+        {
+            _read_ahead(ahead->data);
+            ahead = ahead->next;
+            n_ahead++;
+        }
+
         if(job->current)
             fm_path_unref(job->current);
         job->current = fm_path_ref(path);
@@ -218,7 +273,9 @@ static gboolean fm_file_info_job_run(FmJob* fmjob)
         if(fm_path_is_native(path))
         {
             char* path_str = fm_path_to_str(path);
-            if(!_fm_file_info_job_get_info_for_native_file(fmjob, fi, path_str, &err))
+            if(!fm_job_is_cancelled(fmjob) &&
+               !_fm_file_info_set_from_native_file_at(fi, AT_FDCWD, path_str, NULL,
+                                                      &err, FALSE, attrs))
             {
                 FmJobErrorAction act = fm_job_emit_error(fmjob, err, FM_JOB_ERROR_MILD);
                 g_error_free(err);
@@ -231,8 +288,15 @@ static gboolean fm_file_info_job_run(FmJob* fmjob)
 
                 fm_file_info_list_delete_link(job->file_infos, l); /* also calls unref */
             }
-            else if(G_UNLIKELY(job->flags & FM_FILE_INFO_JOB_EMIT_FOR_EACH_FILE))
-                fm_job_call_main_thread(fmjob, _emit_current_file, fi);
+            else
+            {
+                _fm_file_info_prepare_collate_keys(fi, attrs);
+                if(G_UNLIKELY(job->flags & FM_FILE_INFO_JOB_EMIT_FOR_EACH_FILE))
+                    fm_job_post_main_thread(fmjob, _emit_current_file,
+                                            fm_file_info_ref(fi),
+                                            (GDestroyNotify)fm_file_info_unref,
+                                            FALSE);
+            }
             g_free(path_str);
             /* recursively set display names for path parents */
             _check_native_display_names(fm_path_get_parent(path));
@@ -259,6 +323,7 @@ static gboolean fm_file_info_job_run(FmJob* fmjob)
                 g_file_info_set_display_name(inf, fm_path_get_basename(path));
                 fm_file_info_set_from_g_file_data(fi, gf, inf);
                 g_object_unref(inf);
+                _fm_file_info_prepare_collate_keys(fi, attrs);
               }
               else
               {
@@ -275,13 +340,22 @@ static gboolean fm_file_info_job_run(FmJob* fmjob)
                 goto _next;
               }
             }
-            else if(G_UNLIKELY(job->flags & FM_FILE_INFO_JOB_EMIT_FOR_EACH_FILE))
-                    fm_job_call_main_thread(fmjob, _emit_current_file, fi);
+            else
+            {
+                _fm_file_info_prepare_collate_keys(fi, attrs);
+                if(G_UNLIKELY(job->flags & FM_FILE_INFO_JOB_EMIT_FOR_EACH_FILE))
+                    fm_job_post_main_thread(fmjob, _emit_current_file,
+                                            fm_file_info_ref(fi),
+                                            (GDestroyNotify)fm_file_info_unref,
+                                            FALSE);
+            }
             /* recursively set display names for path parents */
             _check_gfile_display_names(fm_path_get_parent(path), gf);
 _next:
             g_object_unref(gf);
         }
+        if(n_ahead > 0)
+            n_ahead--;
         l = next;
     }
     return TRUE;
@@ -332,7 +406,9 @@ void fm_file_info_job_add_gfile(FmFileInfoJob* job, GFile* gf)
  * Retrieves current the #FmPath which caused the error.
  * Returned data are owned by @job and shouldn't be freed by caller.
  *
- * This API may only be called in error handler.
+ * This API may only be called in error handler. Since 1.3.2 it may be
+ * called in #FmFileInfoJob::got-info handler as well and returns path
+ * of the file the signal was emitted for.
  *
  * Returns: (transfer none): the current processing file path.
  *
@@ -340,5 +416,28 @@ void fm_file_info_job_add_gfile(FmFileInfoJob* job, GFile* gf)
  */
 FmPath* fm_file_info_job_get_current(FmFileInfoJob* job)
 {
+    FmFileInfoJobPrivate *priv = FM_FILE_INFO_JOB_GET_PRIVATE(job);
+
+    if(priv->reported)
+        return priv->reported;
     return job->current;
 }
+
+/**
+ * fm_file_info_job_set_attributes
+ * @job: a job to set
+ * @attrs: attributes to retrieve
+ *
+ * Sets which attributes of native files should be retrieved by the @job.
+ * Attributes not in @attrs are not queried and will be reported as zero.
+ * Default is %FM_FILE_INFO_ATTR_ALL. Collate keys requested in @attrs are
+ * computed for files of any file system in the job thread.
+ *
+ * This API may only be called before starting the @job.
+ *
+ * Since: 1.3.2
+ */
+void fm_file_info_job_set_attributes(FmFileInfoJob *job, FmFileInfoAttrMask attrs)
+{
+    FM_FILE_INFO_JOB_GET_PRIVATE(job)->attrs = attrs;
+}
@@ -48,11 +48,14 @@ typedef struct _FmFileInfoJobClass      FmFileInfoJobClass;
  * @FM_FILE_INFO_JOB_NONE: default
  * @FM_FILE_INFO_JOB_FOLLOW_SYMLINK: not yet implemented
  * @FM_FILE_INFO_JOB_EMIT_FOR_EACH_FILE: emit #FmFileInfoJob::got-info for each file
+ * @FM_FILE_INFO_JOB_READAHEAD: (since 1.3.2) ask system to read contents of
+ * next native files in the list while current one is tested
  */
 typedef enum {
     FM_FILE_INFO_JOB_NONE = 0,
     FM_FILE_INFO_JOB_FOLLOW_SYMLINK = 1 << 0, /* FIXME: not yet implemented */
-    FM_FILE_INFO_JOB_EMIT_FOR_EACH_FILE = 1 << 1
+    FM_FILE_INFO_JOB_EMIT_FOR_EACH_FILE = 1 << 1,
+    FM_FILE_INFO_JOB_READAHEAD = 1 << 2
 } FmFileInfoJobFlags;
 
 /**
@@ -95,6 +98,8 @@ void fm_file_info_job_add_gfile(FmFileInfoJob* job, GFile* gf);
 /* This API should only be called in error handler */
 FmPath* fm_file_info_job_get_current(FmFileInfoJob* job);
 
+void fm_file_info_job_set_attributes(FmFileInfoJob *job, FmFileInfoAttrMask attrs);
+
 #ifndef __GTK_DOC_IGNORE__
 /* useful inline routines for FmJob classes */
 static inline gboolean
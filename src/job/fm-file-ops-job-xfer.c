@@ -27,12 +27,30 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_COPY_FILE_RANGE
+# define _GNU_SOURCE 1 /* for copy_file_range() */
+#endif
+
+#define FM_DISABLE_SEAL
+
 #include "fm-file-ops-job-xfer.h"
 #include "fm-file-ops-job-delete.h"
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h> /* for FICLONE */
+#endif
+#if defined(HAVE_SENDFILE) && defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_SYS_XATTR_H
+#include <sys/xattr.h>
+#endif
 #include "fm-utils.h"
 #include <glib/gi18n-lib.h>
 
@@ -86,6 +104,483 @@ static gboolean _fm_file_ops_job_check_paths(FmFileOpsJob* job, GFile* src, GFil
     return (err == NULL);
 }
 
+/* ---- native copy engine ---- */
+/* size of chunk copied between progress updates */
+#define NATIVE_COPY_CHUNK (8 * 1024 * 1024)
+#define NATIVE_COPY_BUFFER (256 * 1024)
+
+static void _set_error_from_errno(GError **err, int errsv, const char *message,
+                                  const char *path)
+{
+    char *dname = g_filename_display_name(path);
+    g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errsv), message,
+                dname, g_strerror(errsv));
+    g_free(dname);
+}
+
+/* copies contents of @sfd into @dfd cloning or copying it in kernel if
+   possible, returns 0 or errno; progress is reported if @progress is set */
+static int _native_copy_data(FmFileOpsJob *job, int sfd, int dfd, goffset size,
+                             gboolean progress)
+{
+    FmJob *fmjob = FM_JOB(job);
+    goffset done = 0;
+    char *buf;
+    ssize_t n = 0;
+
+#ifdef FICLONE
+    /* btrfs, XFS and others can share extents so nothing is copied */
+    if (ioctl(dfd, FICLONE, sfd) == 0)
+    {
+        if (progress)
+            progress_cb(size, size, job);
+        return 0;
+    }
+#endif
+    /* kernel copies don't trust @size: procfs, sysfs and some FUSE file
+       systems report 0 and file might be growing, so each of them runs
+       until it copies nothing and the rest is read until EOF anyway */
+#ifdef HAVE_COPY_FILE_RANGE
+    for (;;)
+    {
+        if (fm_job_is_cancelled(fmjob))
+            return ECANCELED;
+        n = copy_file_range(sfd, NULL, dfd, NULL, NATIVE_COPY_CHUNK, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+        if (progress && done <= size)
+            progress_cb(done, size, job);
+    }
+    /* file systems of different types or old kernel; if some data is
+       copied already then continue from that offset */
+    if (n < 0 && errno != ENOSYS && errno != EXDEV && errno != EINVAL &&
+        errno != EOPNOTSUPP && errno != ENOTSUP)
+        return errno;
+#endif
+#if defined(HAVE_SENDFILE) && defined(__linux__)
+    for (;;)
+    {
+        if (fm_job_is_cancelled(fmjob))
+            return ECANCELED;
+        n = sendfile(dfd, sfd, NULL, NATIVE_COPY_CHUNK);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+        if (progress && done <= size)
+            progress_cb(done, size, job);
+    }
+    if (n < 0 && errno != EINVAL && errno != ENOSYS)
+        return errno;
+#endif
+    /* plain copy of the rest, file might be growing so copy until EOF */
+    if (lseek(sfd, done, SEEK_SET) < 0 || lseek(dfd, done, SEEK_SET) < 0)
+        return errno;
+    buf = g_malloc(NATIVE_COPY_BUFFER);
+    for (;;)
+    {
+        char *ptr = buf;
+
+        if (fm_job_is_cancelled(fmjob))
+        {
+            g_free(buf);
+            return ECANCELED;
+        }
+        n = read(sfd, buf, NATIVE_COPY_BUFFER);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        while (n > 0)
+        {
+            ssize_t w = write(dfd, ptr, n);
+            if (w < 0)
+            {
+                int errsv = errno;
+                if (errsv == EINTR)
+                    continue;
+                g_free(buf);
+                return errsv;
+            }
+            ptr += w;
+            n -= w;
+        }
+        done += ptr - buf;
+        if (progress && done <= size)
+            progress_cb(done, size, job);
+    }
+    g_free(buf);
+    return (n < 0) ? errno : 0;
+}
+
+/* copies ownership, mode, times, and user extended attributes of the
+   file as G_FILE_COPY_ALL_METADATA does, errors are ignored */
+static void _native_copy_metadata(int sfd, int dfd, const struct stat *st)
+{
+#ifdef HAVE_FUTIMENS
+    struct timespec times[2];
+#endif
+#ifdef HAVE_SYS_XATTR_H
+    char *names, *name, *value = NULL;
+    ssize_t len, vlen, vsize = 0;
+#endif
+
+    /* GIO ignores failures on ownership too, user may be not permitted */
+    if (fchown(dfd, st->st_uid, st->st_gid) < 0)
+    {
+        /* ignore */
+    }
+    if (fchmod(dfd, st->st_mode & 07777) < 0)
+    {
+        /* ignore */
+    }
+#ifdef HAVE_FUTIMENS
+    times[0] = st->st_atim;
+    times[1] = st->st_mtim;
+    futimens(dfd, times);
+#endif
+#ifdef HAVE_SYS_XATTR_H
+    len = flistxattr(sfd, NULL, 0);
+    if (len <= 0)
+        return;
+    names = g_malloc(len);
+    len = flistxattr(sfd, names, len);
+    for (name = names; len > 0 && name < names + len; name += strlen(name) + 1)
+    {
+        /* GIO copies only user namespace */
+        if (strncmp(name, "user.", 5) != 0)
+            continue;
+        vlen = fgetxattr(sfd, name, NULL, 0);
+        if (vlen < 0)
+            continue;
+        if (vlen > vsize)
+        {
+            vsize = vlen;
+            value = g_realloc(value, vsize);
+        }
+        vlen = fgetxattr(sfd, name, value, vlen);
+        if (vlen >= 0)
+            fsetxattr(dfd, name, value, vlen, 0);
+    }
+    g_free(value);
+    g_free(names);
+#endif
+}
+
+/*
+ * _fm_file_ops_job_copy_native_file
+ * @job: the job
+ * @src: native regular file to copy
+ * @dest: native destination file
+ * @flags: G_FILE_COPY_OVERWRITE is checked only
+ * @progress: %TRUE to report progress of the file
+ * @err: location to store error
+ *
+ * Copies regular file the same way g_file_copy() does with flags
+ * G_FILE_COPY_ALL_METADATA and G_FILE_COPY_NOFOLLOW_SYMLINKS, and sets
+ * the same errors, but tries to clone the file first, then to copy in
+ * kernel with copy_file_range() or sendfile(), and only then copies it
+ * via buffer. Existing file is replaced only after the copy is done.
+ *
+ * Returns: %TRUE if file was copied.
+ */
+static gboolean _fm_file_ops_job_copy_native_file(FmFileOpsJob *job, GFile *src,
+                                                  GFile *dest, GFileCopyFlags flags,
+                                                  gboolean progress, GError **err)
+{
+    char *src_path = g_file_get_path(src);
+    char *dest_path = g_file_get_path(dest);
+    char *tmp_path = NULL;
+    struct stat st, dest_st;
+    int sfd, dfd = -1, errsv;
+    gboolean created = FALSE, ret = FALSE;
+
+    sfd = open(src_path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (sfd < 0 || fstat(sfd, &st) < 0)
+    {
+        _set_error_from_errno(err, errno, _("Error opening file '%s': %s"), src_path);
+        goto _out;
+    }
+    if (flags & G_FILE_COPY_OVERWRITE)
+    {
+        if (lstat(dest_path, &dest_st) == 0 && S_ISDIR(dest_st.st_mode))
+        {
+            g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY,
+                                _("Can't copy over directory"));
+            goto _out;
+        }
+        /* keep old file until the new one is complete */
+        tmp_path = g_strconcat(dest_path, ".XXXXXX", NULL);
+        dfd = g_mkstemp_full(tmp_path, O_WRONLY | O_CLOEXEC, 0600);
+    }
+    else
+        dfd = open(dest_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (dfd < 0)
+    {
+        _set_error_from_errno(err, errno, _("Error opening file '%s': %s"), dest_path);
+        goto _out;
+    }
+    created = TRUE;
+    errsv = _native_copy_data(job, sfd, dfd, st.st_size, progress);
+    if (errsv == ECANCELED)
+    {
+        g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                            _("Operation was cancelled"));
+        goto _out;
+    }
+    if (errsv != 0)
+    {
+        _set_error_from_errno(err, errsv, _("Error writing to file '%s': %s"), dest_path);
+        goto _out;
+    }
+    _native_copy_metadata(sfd, dfd, &st);
+    if (close(dfd) < 0) /* delayed write errors such as NFS quota */
+    {
+        dfd = -1;
+        _set_error_from_errno(err, errno, _("Error writing to file '%s': %s"), dest_path);
+        goto _out;
+    }
+    dfd = -1;
+    if (tmp_path && rename(tmp_path, dest_path) < 0)
+    {
+        _set_error_from_errno(err, errno, _("Error renaming file '%s': %s"), dest_path);
+        goto _out;
+    }
+    ret = TRUE;
+_out:
+    if (dfd >= 0)
+        close(dfd);
+    /* remove incomplete file */
+    if (!ret && created)
+        unlink(tmp_path ? tmp_path : dest_path);
+    if (sfd >= 0)
+        close(sfd);
+    g_free(tmp_path);
+    g_free(dest_path);
+    g_free(src_path);
+    return ret;
+}
+
+/* ---- concurrent copying of small files ---- */
+/* files are copied by workers only if they aren't larger than this */
+#define PIPELINE_MAX_SIZE (1024 * 1024)
+/* maximum number of files submitted to workers but not handled yet */
+#define PIPELINE_WINDOW 256
+#define PIPELINE_DEFAULT_CONCURRENCY 4
+
+typedef struct
+{
+    GFile* src;
+    GFile* dest;
+    FmFolder* src_folder;
+    FmFolder* dest_folder;
+    goffset size;
+    gboolean delete_src;
+    gboolean ok; /* set by worker */
+    gboolean done; /* set by job thread when worker returned it */
+} FmCopyItem;
+
+typedef struct _FmFileOpsJobXfer FmFileOpsJobXfer;
+
+struct _FmFileOpsJobXfer
+{
+    guint concurrency;
+    GThreadPool* pool; /* workers, exists while job runs */
+    GAsyncQueue* copied; /* FmCopyItem returned by workers */
+    GQueue pending; /* FmCopyItem in order of submission */
+    gint sync; /* > 0 while failed file is copied in job thread again */
+    guint n_failed;
+};
+
+static FmFileOpsJobXfer* _get_xfer(FmFileOpsJob* job)
+{
+    if(G_UNLIKELY(job->xfer == NULL))
+    {
+        FmFileOpsJobXfer* xfer = g_slice_new0(FmFileOpsJobXfer);
+        xfer->concurrency = PIPELINE_DEFAULT_CONCURRENCY;
+        job->xfer = xfer;
+    }
+    return job->xfer;
+}
+
+void _fm_file_ops_job_xfer_free(FmFileOpsJob* job)
+{
+    if(job->xfer)
+        g_slice_free(FmFileOpsJobXfer, job->xfer);
+    job->xfer = NULL;
+}
+
+/**
+ * fm_file_ops_job_set_concurrency
+ * @job: a job to set
+ * @n_files: maximum number of files copied at once
+ *
+ * Sets how many small files may be copied at once by copy or move
+ * operation between native file systems. The files are copied in
+ * parallel but errors and conflicts are still handled one by one, in
+ * order. Value 1 disables concurrent copying. Default is 4. Files are
+ * copied one by one anyway if source or destination is on rotational,
+ * removable, or remote device (see fm_job_add_io_path()).
+ *
+ * This API may be used only before @job is started.
+ *
+ * Since: 1.3.2
+ */
+void fm_file_ops_job_set_concurrency(FmFileOpsJob* job, guint n_files)
+{
+    _get_xfer(job)->concurrency = MAX(n_files, 1);
+}
+
+static void _pipeline_worker(gpointer data, gpointer user_data)
+{
+    FmCopyItem* item = data;
+    FmFileOpsJob* job = user_data;
+    FmFileOpsJobXfer* xfer = job->xfer;
+
+    /* errors aren't reported here, failed file will be copied again */
+    item->ok = !fm_job_is_cancelled(FM_JOB(job)) &&
+               _fm_file_ops_job_copy_native_file(job, item->src, item->dest,
+                                                 0, FALSE, NULL);
+    g_async_queue_push(xfer->copied, item);
+}
+
+static gboolean _fm_file_ops_job_copy_file(FmFileOpsJob* job, GFile* src,
+                                           GFileInfo* inf, GFile* dest,
+                                           FmFolder *src_folder,
+                                           FmFolder *dest_folder);
+
+/* finishes copying of the item in job thread */
+static void _pipeline_handle(FmFileOpsJob* job, FmCopyItem* item)
+{
+    FmFileOpsJobXfer* xfer = job->xfer;
+    FmJob* fmjob = FM_JOB(job);
+
+    if(item->ok)
+    {
+        job->finished += item->size;
+        if(item->dest_folder)
+        {
+            FmPath* fm_dest = fm_path_new_for_gfile(item->dest);
+            if(!_fm_folder_event_file_added(item->dest_folder, fm_dest))
+                fm_path_unref(fm_dest);
+        }
+        fm_file_ops_job_emit_percent(job);
+        if(item->delete_src && !fm_job_is_cancelled(fmjob) &&
+           !_fm_file_ops_job_delete_file(fmjob, item->src, NULL, item->src_folder, TRUE))
+            xfer->n_failed++;
+    }
+    else if(!fm_job_is_cancelled(fmjob))
+    {
+        /* copy it again the usual way so the user can resolve the problem */
+        xfer->sync++;
+        if(!_fm_file_ops_job_copy_file(job, item->src, NULL, item->dest,
+                                       item->src_folder, item->dest_folder))
+            xfer->n_failed++;
+        xfer->sync--;
+    }
+    g_object_unref(item->src);
+    g_object_unref(item->dest);
+    if(item->src_folder)
+        g_object_unref(item->src_folder);
+    if(item->dest_folder)
+        g_object_unref(item->dest_folder);
+    g_slice_free(FmCopyItem, item);
+}
+
+/* handles copied files in order of submission until no more than
+   @max_pending files are left */
+static void _pipeline_collect(FmFileOpsJob* job, guint max_pending)
+{
+    FmFileOpsJobXfer* xfer = job->xfer;
+    FmCopyItem* item;
+
+    while((item = g_async_queue_try_pop(xfer->copied)) != NULL)
+        item->done = TRUE;
+    while((item = g_queue_peek_head(&xfer->pending)) != NULL)
+    {
+        if(!item->done)
+        {
+            if(g_queue_get_length(&xfer->pending) <= max_pending)
+                break;
+            /* wait for workers */
+            item = g_async_queue_pop(xfer->copied);
+            item->done = TRUE;
+            continue;
+        }
+        g_queue_pop_head(&xfer->pending);
+        _pipeline_handle(job, item);
+    }
+}
+
+/* waits for all submitted files, returns %FALSE if any of them failed */
+static gboolean _pipeline_flush(FmFileOpsJob* job)
+{
+    FmFileOpsJobXfer* xfer = job->xfer;
+    guint n_failed;
+
+    if(xfer == NULL || xfer->pool == NULL)
+        return TRUE;
+    n_failed = xfer->n_failed;
+    _pipeline_collect(job, 0);
+    return (xfer->n_failed == n_failed);
+}
+
+static void _pipeline_start(FmFileOpsJob* job)
+{
+    FmFileOpsJobXfer* xfer = _get_xfer(job);
+
+    /* parallel writes would thrash rotational or removable device */
+    if(xfer->concurrency < 2 || _fm_job_uses_serial_device(FM_JOB(job)))
+        return;
+    xfer->copied = g_async_queue_new();
+    xfer->pool = g_thread_pool_new(_pipeline_worker, job, xfer->concurrency,
+                                   FALSE, NULL);
+    xfer->n_failed = 0;
+}
+
+/* stops workers, returns %FALSE if any file failed since the start */
+static gboolean _pipeline_finish(FmFileOpsJob* job)
+{
+    FmFileOpsJobXfer* xfer = job->xfer;
+
+    if(xfer->pool == NULL)
+        return TRUE;
+    _pipeline_collect(job, 0);
+    g_thread_pool_free(xfer->pool, FALSE, TRUE);
+    xfer->pool = NULL;
+    g_async_queue_unref(xfer->copied);
+    xfer->copied = NULL;
+    return (xfer->n_failed == 0);
+}
+
+/* submits regular file to workers if possible */
+static gboolean _pipeline_submit(FmFileOpsJob* job, GFile* src, GFile* dest,
+                                 goffset size, gboolean delete_src,
+                                 FmFolder* src_folder, FmFolder* dest_folder)
+{
+    FmFileOpsJobXfer* xfer = job->xfer;
+    FmCopyItem* item;
+
+    if(xfer == NULL || xfer->pool == NULL || xfer->sync > 0 ||
+       size > PIPELINE_MAX_SIZE || !g_file_is_native(src) || !g_file_is_native(dest))
+        return FALSE;
+    item = g_slice_new0(FmCopyItem);
+    item->src = g_object_ref(src);
+    item->dest = g_object_ref(dest);
+    item->src_folder = src_folder ? g_object_ref(src_folder) : NULL;
+    item->dest_folder = dest_folder ? g_object_ref(dest_folder) : NULL;
+    item->size = size;
+    item->delete_src = delete_src;
+    g_queue_push_tail(&xfer->pending, item);
+    g_thread_pool_push(xfer->pool, item, NULL);
+    _pipeline_collect(job, PIPELINE_WINDOW);
+    return TRUE;
+}
+
 static gboolean _fm_file_ops_job_copy_file(FmFileOpsJob* job, GFile* src,
                                            GFileInfo* inf, GFile* dest,
                                            FmFolder *src_folder, /* if move */
@@ -350,6 +845,9 @@ _retry_enum_children:
                     if(act == FM_JOB_RETRY)
                         goto _retry_enum_children;
                 }
+                /* source dir may be deleted only after its files are moved */
+                if(delete_src && !_pipeline_flush(job))
+                    ret = FALSE;
                 if (sub_src)
                     g_object_unref(sub_src);
                 if (sub_folder)
@@ -396,10 +894,20 @@ _retry_enum_children:
         goto _file_copied;
 
     default:
+        if(type == G_FILE_TYPE_REGULAR &&
+           _pipeline_submit(job, src, dest, size, delete_src, src_folder, dest_folder))
+        {
+            /* progress and deletion of source are handled once it's copied */
+            ret = TRUE;
+            delete_src = FALSE;
+            break;
+        }
         flags = G_FILE_COPY_ALL_METADATA|G_FILE_COPY_NOFOLLOW_SYMLINKS;
 _retry_copy:
-        if( !g_file_copy(src, dest, flags, fm_job_get_cancellable(fmjob),
-                         progress_cb, fmjob, &err) )
+        if( (type == G_FILE_TYPE_REGULAR && g_file_is_native(src) && g_file_is_native(dest))
+            ? !_fm_file_ops_job_copy_native_file(job, src, dest, flags, TRUE, &err)
+            : !g_file_copy(src, dest, flags, fm_job_get_cancellable(fmjob),
+                           progress_cb, fmjob, &err) )
         {
             flags &= ~G_FILE_COPY_OVERWRITE;
 
@@ -712,6 +1220,7 @@ gboolean _fm_file_ops_job_copy_run(FmFileOpsJob* job)
         fm_folder_block_updates(df);
 
     fm_file_ops_job_emit_prepared(job);
+    _pipeline_start(job);
 
     for(l = fm_path_list_peek_head_link(job->srcs); !fm_job_is_cancelled(fmjob) && l; l=l->next)
     {
@@ -759,6 +1268,8 @@ gboolean _fm_file_ops_job_copy_run(FmFileOpsJob* job)
             g_object_unref(dest);
     }
 
+    if(!_pipeline_finish(job))
+        ret = FALSE;
     /* g_debug("finished: %llu, total: %llu", job->finished, job->total); */
     fm_file_ops_job_emit_percent(job);
 
@@ -835,6 +1346,7 @@ _retry_query_dest_info:
     df = fm_folder_find_by_path(job->dest);
     if (df)
         fm_folder_block_updates(df);
+    _pipeline_start(job);
 
     for(l = fm_path_list_peek_head_link(job->srcs); !fm_job_is_cancelled(fmjob) && l; l=l->next)
     {
@@ -853,6 +1365,9 @@ _retry_query_dest_info:
             {
                 if (sf)
                 {
+                    /* files in it may still be copied */
+                    if (!_pipeline_flush(job))
+                        ret = FALSE;
                     fm_folder_unblock_updates(sf);
                     g_object_unref(sf);
                 }
@@ -890,6 +1405,8 @@ _retry_query_dest_info:
         if(!ret)
             break;
     }
+    if(!_pipeline_finish(job))
+        ret = FALSE;
     /* restore updates for destination and source */
     if (df)
     {
@@ -143,6 +143,8 @@ static void fm_file_ops_job_class_init(FmFileOpsJobClass *klass)
      *
      * The #FmFileOpsJob::cur-file signal is emitted when @job is about
      * to start operation on the @file.
+     * Since 1.3.2 the signal is emitted asynchronously and at limited
+     * rate, so some of files may be not reported.
      *
      * Since: 0.1.0
      */
@@ -162,6 +164,8 @@ static void fm_file_ops_job_class_init(FmFileOpsJobClass *klass)
      *
      * The #FmFileOpsJob::percent signal is emitted when one more file
      * operation is completed.
+     * Since 1.3.2 the signal is emitted asynchronously and at limited
+     * rate, only the latest value is reported.
      *
      * Since: 0.1.0
      */
@@ -211,6 +215,8 @@ static void fm_file_ops_job_finalize(GObject *object)
     g_return_if_fail(object != NULL);
     g_return_if_fail(FM_IS_FILE_OPS_JOB(object));
 
+    _fm_file_ops_job_xfer_free(FM_FILE_OPS_JOB(object));
+
     G_OBJECT_CLASS(fm_file_ops_job_parent_class)->finalize(object);
 }
 
@@ -218,6 +224,7 @@ static void fm_file_ops_job_finalize(GObject *object)
 static void fm_file_ops_job_init(FmFileOpsJob *self)
 {
     fm_job_init_cancellable(FM_JOB(self));
+    fm_job_set_priority(FM_JOB(self), FM_JOB_PRIORITY_BULK);
 
     /* for chown */
     self->uid = -1;
@@ -241,6 +248,9 @@ FmFileOpsJob *fm_file_ops_job_new(FmFileOpType type, FmPathList* files)
     FmFileOpsJob* job = (FmFileOpsJob*)g_object_new(FM_FILE_OPS_JOB_TYPE, NULL);
     job->srcs = fm_path_list_ref(files);
     job->type = type;
+    /* sources are usually in the same directory so check only first one */
+    if(!fm_path_list_is_empty(files))
+        fm_job_add_io_path(FM_JOB(job), fm_path_list_peek_head(files));
     return job;
 }
 
@@ -290,6 +300,7 @@ static gboolean fm_file_ops_job_run(FmJob* fm_job)
 void fm_file_ops_job_set_dest(FmFileOpsJob* job, FmPath* dest)
 {
     job->dest = fm_path_ref(dest);
+    fm_job_add_io_path(FM_JOB(job), dest);
 }
 
 /**
@@ -391,7 +402,9 @@ static gpointer emit_cur_file(FmJob* job, gpointer cur_file)
  */
 void fm_file_ops_job_emit_cur_file(FmFileOpsJob* job, const char* cur_file)
 {
-    fm_job_call_main_thread(FM_JOB(job), emit_cur_file, (gpointer)cur_file);
+    /* only the latest file is interesting, don't wait for UI */
+    fm_job_post_main_thread(FM_JOB(job), emit_cur_file, g_strdup(cur_file),
+                            g_free, TRUE);
 }
 
 static gpointer emit_percent(FmJob* job, gpointer percent)
@@ -430,7 +443,8 @@ void fm_file_ops_job_emit_percent(FmFileOpsJob* job)
 
     if( percent > job->percent )
     {
-        fm_job_call_main_thread(FM_JOB(job), emit_percent, GUINT_TO_POINTER(percent));
+        fm_job_post_main_thread(FM_JOB(job), emit_percent,
+                                GUINT_TO_POINTER(percent), NULL, TRUE);
         job->percent = percent;
     }
 }
@@ -131,7 +131,7 @@ struct _FmFileOpsJob
     FmFileOpOption supported_options;
 
     /*< private >*/
-    gpointer _reserved1;
+    gpointer FM_SEAL(xfer); /* concurrent copying data, since 1.3.2 */
     gpointer _reserved2;
 };
 
@@ -169,6 +169,8 @@ void fm_file_ops_job_set_icon(FmFileOpsJob *job, GIcon *icon);
 void fm_file_ops_job_set_hidden(FmFileOpsJob *job, gboolean hidden);
 void fm_file_ops_job_set_target(FmFileOpsJob *job, const char *url);
 
+void fm_file_ops_job_set_concurrency(FmFileOpsJob* job, guint n_files);
+
 void fm_file_ops_job_emit_prepared(FmFileOpsJob* job);
 void fm_file_ops_job_emit_cur_file(FmFileOpsJob* job, const char* cur_file);
 void fm_file_ops_job_emit_percent(FmFileOpsJob* job);
@@ -32,6 +32,14 @@
 #include "glib-compat.h"
 #include "fm-utils.h"
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sysmacros.h> /* for major(), minor() and makedev() */
+#include <stdio.h>
+#include <string.h>
+#endif
+
 /**
  * SECTION:fm-job
  * @short_description: Base class of all kinds of asynchronous jobs.
@@ -79,6 +87,8 @@ G_DEFINE_ABSTRACT_TYPE(FmJob, fm_job, G_TYPE_OBJECT);
 static gboolean fm_job_real_run_async(FmJob* job);
 static gboolean on_idle_cleanup(gpointer unused);
 static void job_thread(FmJob* job, gpointer unused);
+static gboolean has_posts(FmJob* job);
+static gpointer flush_in_main_thread(FmJob* job, gpointer unused);
 
 static guint idle_handler = 0;
 static GSList* finished = NULL;
@@ -89,6 +99,499 @@ static guint n_jobs = 0;
 
 static guint signals[N_SIGNALS];
 
+/* ---- scheduling of jobs by priority ---- */
+#define N_PRIORITIES (FM_JOB_PRIORITY_BACKGROUND + 1)
+
+typedef struct _FmJobSched
+{
+    FmJobPriority priority;
+    gint slot; /* priority which running job is counted in, or -1 */
+    gint64 queued_time;
+    GList* link; /* in sched_queues[priority] while job is waiting */
+    GSList* devices; /* FmIoDevice which job reads or writes */
+    GSList* io_paths; /* native FmPath which devices aren't resolved yet */
+    gboolean resolving; /* io_paths are resolved in thread pool */
+    gboolean holds_devices; /* counted in n_bulk of devices */
+    gboolean bypass; /* caller waits for it so don't queue it */
+}FmJobSched;
+
+/* device which bulk jobs are admitted to one by one */
+typedef struct
+{
+    guint64 key; /* st_dev or hash of remote scheme path */
+    gboolean serial; /* rotational, removable or remote */
+    guint n_bulk; /* running bulk jobs */
+}FmIoDevice;
+
+typedef struct
+{
+    GQueue waiting;
+    guint max_running; /* 0 means unlimited */
+    guint n_running;
+    guint n_started;
+    gint64 total_wait;
+    gint64 max_wait;
+}FmJobQueue;
+
+static FmJobQueue sched_queues[N_PRIORITIES] = {
+    { G_QUEUE_INIT, 8, 0, 0, 0, 0 }, /* FM_JOB_PRIORITY_INTERACTIVE */
+    { G_QUEUE_INIT, 4, 0, 0, 0, 0 }, /* FM_JOB_PRIORITY_REFRESH */
+    { G_QUEUE_INIT, 2, 0, 0, 0, 0 }, /* FM_JOB_PRIORITY_BULK */
+    { G_QUEUE_INIT, 1, 0, 0, 0, 0 }  /* FM_JOB_PRIORITY_BACKGROUND */
+};
+/* known devices, never freed */
+static GHashTable* io_devices = NULL;
+static guint io_device_max_bulk = 1;
+G_LOCK_DEFINE_STATIC(scheduler);
+
+/* checks if bulk jobs can be admitted to all devices of the job */
+static gboolean sched_devices_free(FmJobSched* sched, gint slot)
+{
+    GSList* l;
+
+    if(slot != FM_JOB_PRIORITY_BULK || io_device_max_bulk == 0)
+        return TRUE;
+    for(l = sched->devices; l; l = l->next)
+    {
+        FmIoDevice* dev = l->data;
+        if(dev->serial && dev->n_bulk >= io_device_max_bulk)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void sched_hold_devices(FmJobSched* sched, gboolean hold)
+{
+    GSList* l;
+
+    for(l = sched->devices; l; l = l->next)
+    {
+        FmIoDevice* dev = l->data;
+        if(hold)
+            dev->n_bulk++;
+        else
+            dev->n_bulk--;
+    }
+    sched->holds_devices = hold;
+}
+
+/* starts the job in thread pool, should be called with lock held */
+static void sched_start(FmJob* job, gint slot)
+{
+    FmJobSched* sched = job->sched;
+    FmJobQueue* queue = &sched_queues[sched->priority];
+    gint64 wait = g_get_monotonic_time() - sched->queued_time;
+
+    sched->slot = slot;
+    if(slot >= 0)
+        sched_queues[slot].n_running++;
+    if(slot == FM_JOB_PRIORITY_BULK)
+        sched_hold_devices(sched, TRUE);
+    queue->n_started++;
+    queue->total_wait += wait;
+    if(wait > queue->max_wait)
+        queue->max_wait = wait;
+    g_thread_pool_push(thread_pool, job, NULL);
+}
+
+static inline gboolean sched_has_slot(FmJobQueue* queue)
+{
+    return queue->max_running == 0 || queue->n_running < queue->max_running;
+}
+
+/* starts waiting jobs while there are free slots, higher priorities
+   first, should be called with lock held */
+static void sched_dispatch(void)
+{
+    gint i;
+
+    for(i = 0; i < N_PRIORITIES; i++)
+    {
+        FmJobQueue* queue = &sched_queues[i];
+        GList *l, *next;
+
+        /* jobs waiting for busy device are skipped */
+        for(l = queue->waiting.head; l && sched_has_slot(queue); l = next)
+        {
+            FmJob* job = l->data;
+            FmJobSched* sched = job->sched;
+
+            next = l->next;
+            if(!sched_devices_free(sched, i))
+                continue;
+            g_queue_delete_link(&queue->waiting, l);
+            sched->link = NULL;
+            sched_start(job, i);
+        }
+    }
+}
+
+/* releases slot of the job which is done, called from working thread */
+static void sched_release(FmJob* job)
+{
+    FmJobSched* sched = job->sched;
+
+    G_LOCK(scheduler);
+    if(sched->holds_devices)
+        sched_hold_devices(sched, FALSE);
+    if(sched->slot >= 0)
+    {
+        sched_queues[sched->slot].n_running--;
+        sched->slot = -1;
+        sched_dispatch();
+    }
+    G_UNLOCK(scheduler);
+}
+
+/**
+ * fm_job_set_priority
+ * @job: a job to apply
+ * @priority: new priority class for @job
+ *
+ * Sets priority class of @job. Jobs started with fm_job_run_async() are
+ * running concurrently up to limit set for their class, others are
+ * waiting and jobs of higher priority classes are started first. The
+ * default class of #FmJob is %FM_JOB_PRIORITY_INTERACTIVE, derived
+ * classes may set another one on creation.
+ *
+ * This API may be used at any time. If @job is waiting for start then
+ * it is moved into the queue of new class, so it can be used to promote
+ * the job when its result becomes visible to the user. Running job
+ * still holds slot of the class it was started in.
+ *
+ * Since: 1.3.2
+ */
+void fm_job_set_priority(FmJob* job, FmJobPriority priority)
+{
+    FmJobSched* sched;
+
+    g_return_if_fail(job != NULL && FM_IS_JOB(job));
+    g_return_if_fail((guint)priority < N_PRIORITIES);
+    sched = job->sched;
+    G_LOCK(scheduler);
+    if(sched->link && sched->priority != priority)
+    {
+        g_queue_delete_link(&sched_queues[sched->priority].waiting, sched->link);
+        g_queue_push_tail(&sched_queues[priority].waiting, job);
+        sched->link = sched_queues[priority].waiting.tail;
+        sched->priority = priority;
+        sched_dispatch();
+    }
+    else
+        sched->priority = priority;
+    G_UNLOCK(scheduler);
+}
+
+/**
+ * fm_job_get_priority
+ * @job: the job to inspect
+ *
+ * Retrieves priority class of @job set by fm_job_set_priority().
+ *
+ * Returns: priority class of @job.
+ *
+ * Since: 1.3.2
+ */
+FmJobPriority fm_job_get_priority(FmJob* job)
+{
+    g_return_val_if_fail(job != NULL && FM_IS_JOB(job), FM_JOB_PRIORITY_INTERACTIVE);
+    return ((FmJobSched*)job->sched)->priority;
+}
+
+/**
+ * fm_job_set_max_running
+ * @priority: priority class to change
+ * @max_running: maximum number of concurrently running jobs, 0 for no limit
+ *
+ * Sets limit of jobs of class @priority which may run at once. Default
+ * limits are 8 jobs for %FM_JOB_PRIORITY_INTERACTIVE, 4 jobs for
+ * %FM_JOB_PRIORITY_REFRESH, 2 jobs for %FM_JOB_PRIORITY_BULK and one
+ * job for %FM_JOB_PRIORITY_BACKGROUND.
+ *
+ * Since: 1.3.2
+ */
+void fm_job_set_max_running(FmJobPriority priority, guint max_running)
+{
+    g_return_if_fail((guint)priority < N_PRIORITIES);
+    G_LOCK(scheduler);
+    sched_queues[priority].max_running = max_running;
+    sched_dispatch();
+    G_UNLOCK(scheduler);
+}
+
+/**
+ * fm_job_get_scheduler_stats
+ * @priority: priority class to inspect
+ * @n_running: (out) (allow-none): location to store number of running jobs
+ * @n_waiting: (out) (allow-none): location to store number of waiting jobs
+ * @n_started: (out) (allow-none): location to store number of jobs started
+ * @total_wait: (out) (allow-none): location to store total time in
+ *      microseconds which started jobs were waiting in queue
+ * @max_wait: (out) (allow-none): location to store the longest time in
+ *      microseconds which some job was waiting in queue
+ *
+ * Retrieves statistics of scheduling of jobs of class @priority since
+ * start of the application. Jobs are counted in the class they have at
+ * the start.
+ *
+ * Since: 1.3.2
+ */
+void fm_job_get_scheduler_stats(FmJobPriority priority, guint* n_running,
+                                guint* n_waiting, guint* n_started,
+                                gint64* total_wait, gint64* max_wait)
+{
+    FmJobQueue* queue;
+
+    g_return_if_fail((guint)priority < N_PRIORITIES);
+    queue = &sched_queues[priority];
+    G_LOCK(scheduler);
+    if(n_running)
+        *n_running = queue->n_running;
+    if(n_waiting)
+        *n_waiting = g_queue_get_length(&queue->waiting);
+    if(n_started)
+        *n_started = queue->n_started;
+    if(total_wait)
+        *total_wait = queue->total_wait;
+    if(max_wait)
+        *max_wait = queue->max_wait;
+    G_UNLOCK(scheduler);
+}
+
+#ifdef __linux__
+/* reads flag of block device from sysfs, partitions have it in parent */
+static gboolean io_device_read_flag(dev_t dev, const char *name, gboolean *flag)
+{
+    char path[64], *contents;
+    gboolean ok;
+
+    g_snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/%s",
+               major(dev), minor(dev), name);
+    ok = g_file_get_contents(path, &contents, NULL, NULL);
+    if(!ok)
+    {
+        g_snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../%s",
+                   major(dev), minor(dev), name);
+        ok = g_file_get_contents(path, &contents, NULL, NULL);
+    }
+    if(ok)
+    {
+        *flag = (contents[0] == '1');
+        g_free(contents);
+    }
+    return ok;
+}
+#endif
+
+#ifdef __linux__
+/* finds block device which file systems with anonymous device number,
+   such as btrfs, have in /proc/self/mountinfo as mount source */
+static gboolean io_device_find_backing(dev_t dev, dev_t *backing)
+{
+    char *contents, *line, *next, source[256];
+    unsigned int dev_major, dev_minor;
+    gboolean found = FALSE;
+    struct stat st;
+
+    if(!g_file_get_contents("/proc/self/mountinfo", &contents, NULL, NULL))
+        return FALSE;
+    for(line = contents; line && !found; line = next)
+    {
+        next = strchr(line, '\n');
+        if(next)
+            *next++ = '\0';
+        if(sscanf(line, "%*u %*u %u:%u", &dev_major, &dev_minor) != 2 ||
+           makedev(dev_major, dev_minor) != dev)
+            continue;
+        /* optional fields are terminated by " - ", then type and source */
+        line = strstr(line, " - ");
+        if(line && sscanf(line, " - %*s %255s", source) == 1 &&
+           g_str_has_prefix(source, "/dev/") &&
+           stat(source, &st) == 0 && S_ISBLK(st.st_mode))
+        {
+            *backing = st.st_rdev;
+            found = TRUE;
+        }
+    }
+    g_free(contents);
+    return found;
+}
+#endif
+
+/* checks if parallel bulk transfers would thrash the device */
+static gboolean io_device_is_serial(dev_t dev)
+{
+#ifdef __linux__
+    gboolean flag;
+
+    /* major 0 is anonymous device which has no sysfs entry, try the mount
+       source instead; overlayfs, ZFS, FUSE and tmpfs have no block device
+       there so are treated as non-serial */
+    if(major(dev) == 0 && !io_device_find_backing(dev, &dev))
+        return FALSE;
+    if(io_device_read_flag(dev, "queue/rotational", &flag) && flag)
+        return TRUE;
+    /* USB sticks are usually not rotational but slow on parallel writes */
+    if(io_device_read_flag(dev, "removable", &flag) && flag)
+        return TRUE;
+#endif
+    return FALSE;
+}
+
+/* returns known device or adds new one, should be called with lock held */
+static FmIoDevice* io_device_get(guint64 key, gboolean serial)
+{
+    FmIoDevice* dev;
+
+    if(G_UNLIKELY(io_devices == NULL))
+        io_devices = g_hash_table_new(g_int64_hash, g_int64_equal);
+    dev = g_hash_table_lookup(io_devices, &key);
+    if(dev == NULL)
+    {
+        dev = g_slice_new0(FmIoDevice);
+        dev->key = key;
+        dev->serial = serial;
+        g_hash_table_insert(io_devices, &dev->key, dev);
+    }
+    return dev;
+}
+
+/* finds devices of native io_paths and frees them, called from
+   working thread */
+static void sched_resolve_devices(FmJobSched* sched)
+{
+    GSList* l;
+
+    for(l = sched->io_paths; l; l = l->next)
+    {
+        FmPath* path = l->data;
+        FmIoDevice* dev;
+        struct stat st;
+        char* path_str;
+        guint64 key;
+        gboolean serial;
+
+        /* destination might be not created yet so try its parents */
+        while(path != NULL)
+        {
+            path_str = fm_path_to_str(path);
+            if(stat(path_str, &st) == 0)
+                break;
+            g_free(path_str);
+            path = fm_path_get_parent(path);
+        }
+        if(path == NULL)
+            continue;
+        g_free(path_str);
+        key = st.st_dev;
+        G_LOCK(scheduler);
+        dev = io_devices ? g_hash_table_lookup(io_devices, &key) : NULL;
+        G_UNLOCK(scheduler);
+        serial = dev ? dev->serial : io_device_is_serial(st.st_dev);
+        G_LOCK(scheduler);
+        dev = io_device_get(key, serial);
+        if(!g_slist_find(sched->devices, dev))
+            sched->devices = g_slist_prepend(sched->devices, dev);
+        G_UNLOCK(scheduler);
+    }
+    G_LOCK(scheduler);
+    l = sched->io_paths;
+    sched->io_paths = NULL;
+    G_UNLOCK(scheduler);
+    g_slist_foreach(l, (GFunc)fm_path_unref, NULL);
+    g_slist_free(l);
+}
+
+/* for usage by FmFileOpsJob - checks if any device of running @job is
+   serial, see fm_job_add_io_path(); called from working thread */
+gboolean _fm_job_uses_serial_device(FmJob* job)
+{
+    FmJobSched* sched = job->sched;
+    gboolean serial = FALSE;
+    GSList* l;
+
+    /* devices of job started by fm_job_run_sync() aren't resolved yet */
+    if(sched->io_paths)
+        sched_resolve_devices(sched);
+    G_LOCK(scheduler);
+    for(l = sched->devices; l && !serial; l = l->next)
+        serial = ((FmIoDevice*)l->data)->serial;
+    G_UNLOCK(scheduler);
+    return serial;
+}
+
+/**
+ * fm_job_add_io_path
+ * @job: a job to apply
+ * @path: a file which @job reads or writes
+ *
+ * Adds the device where @path is located into list of devices used by
+ * @job. Jobs of class %FM_JOB_PRIORITY_BULK are admitted to rotational,
+ * removable, or remote devices only one at a time (see also the
+ * fm_job_set_max_running_per_device()), other jobs are not limited
+ * by devices. For remote files the device is the remote host. Local
+ * file systems without own block device, such as btrfs subvolumes, are
+ * checked by device of their mount source, those which have no block
+ * device at all, such as overlayfs or ZFS, are never limited.
+ *
+ * This API should be called before @job is started. It doesn't query
+ * the file system, devices of local files are found by fm_job_run_async()
+ * in a working thread before @job is admitted.
+ *
+ * Since: 1.3.2
+ */
+void fm_job_add_io_path(FmJob* job, FmPath* path)
+{
+    FmJobSched* sched;
+    FmIoDevice* dev;
+    guint64 key;
+
+    g_return_if_fail(job != NULL && FM_IS_JOB(job) && path != NULL);
+    sched = job->sched;
+    if(fm_path_is_native(path))
+    {
+        G_LOCK(scheduler);
+        if(!sched->link && sched->slot < 0 && !sched->resolving)
+            sched->io_paths = g_slist_prepend(sched->io_paths, fm_path_ref(path));
+        G_UNLOCK(scheduler);
+        return;
+    }
+    else if(fm_path_is_trash(path) || fm_path_is_xdg_menu(path))
+        /* those are just views of native files */
+        return;
+    else
+    {
+        char* path_str = fm_path_to_str(fm_path_get_scheme_path(path));
+        /* keep it apart from values of st_dev */
+        key = g_str_hash(path_str) | G_GUINT64_CONSTANT(0x8000000000000000);
+        g_free(path_str);
+    }
+    G_LOCK(scheduler);
+    dev = io_device_get(key, TRUE);
+    if(!sched->link && sched->slot < 0 && !sched->resolving &&
+       !g_slist_find(sched->devices, dev))
+        sched->devices = g_slist_prepend(sched->devices, dev);
+    G_UNLOCK(scheduler);
+}
+
+/**
+ * fm_job_set_max_running_per_device
+ * @max_running: maximum number of bulk jobs per device, 0 for no limit
+ *
+ * Sets how many jobs of class %FM_JOB_PRIORITY_BULK may run at once on
+ * the same rotational, removable, or remote device, see the function
+ * fm_job_add_io_path() for details. Default limit is 1.
+ *
+ * Since: 1.3.2
+ */
+void fm_job_set_max_running_per_device(guint max_running)
+{
+    G_LOCK(scheduler);
+    io_device_max_bulk = max_running;
+    sched_dispatch();
+    G_UNLOCK(scheduler);
+}
+
 static void fm_job_emit_finished(FmJob* job)
 {
     g_signal_emit(job, signals[FINISHED], 0);
@@ -227,7 +730,13 @@ static void fm_job_class_init(FmJobClass *klass)
 
 static void fm_job_init(FmJob *self)
 {
-    /* create the thread pool if it doesn't exist. */
+    FmJobSched* sched = g_slice_new0(FmJobSched);
+
+    sched->priority = FM_JOB_PRIORITY_INTERACTIVE;
+    sched->slot = -1;
+    self->sched = sched;
+    /* create the thread pool if it doesn't exist. threads are limited by
+       the scheduler per priority class instead of the pool */
     if( G_UNLIKELY(!thread_pool) )
         thread_pool = g_thread_pool_new((GFunc)job_thread, NULL, -1, FALSE, NULL);
     ++n_jobs;
@@ -250,9 +759,17 @@ FmJob* fm_job_new(void)
 
 static void fm_job_finalize(GObject *object)
 {
+    FmJobSched* sched;
+
     g_return_if_fail(object != NULL);
     g_return_if_fail(FM_IS_JOB(object));
 
+    sched = FM_JOB(object)->sched;
+    g_slist_free(sched->devices);
+    g_slist_foreach(sched->io_paths, (GFunc)fm_path_unref, NULL);
+    g_slist_free(sched->io_paths);
+    g_slice_free(FmJobSched, sched);
+
     if (G_OBJECT_CLASS(fm_job_parent_class)->finalize)
         (* G_OBJECT_CLASS(fm_job_parent_class)->finalize)(object);
 
@@ -264,9 +781,41 @@ static void fm_job_finalize(GObject *object)
     }
 }
 
+/* admits the job or puts it into queue, should be called with lock held */
+static void sched_enqueue(FmJob* job)
+{
+    FmJobSched* sched = job->sched;
+    FmJobQueue* queue = &sched_queues[sched->priority];
+
+    /* cancelled job will finish at once; a job someone is blocked on
+       shouldn't wait behind hung jobs so it doesn't take a slot either */
+    if(job->cancel || sched->bypass)
+        sched_start(job, -1);
+    else if(sched_has_slot(queue) && sched_devices_free(sched, sched->priority))
+        sched_start(job, sched->priority);
+    else
+    {
+        g_queue_push_tail(&queue->waiting, job);
+        sched->link = queue->waiting.tail;
+    }
+}
+
 static gboolean fm_job_real_run_async(FmJob* job)
 {
-    g_thread_pool_push(thread_pool, job, NULL);
+    FmJobSched* sched = job->sched;
+
+    G_LOCK(scheduler);
+    sched->queued_time = g_get_monotonic_time();
+    /* stat() of slow device shouldn't block the caller so find devices
+       in working thread, see job_thread() */
+    if(sched->io_paths)
+    {
+        sched->resolving = TRUE;
+        g_thread_pool_push(thread_pool, job, NULL);
+    }
+    else
+        sched_enqueue(job);
+    G_UNLOCK(scheduler);
     return TRUE;
 }
 
@@ -319,6 +868,8 @@ gboolean fm_job_run_sync(FmJob* job)
     job->running = TRUE;
     ret = klass->run(job);
     job->running = FALSE;
+    if(has_posts(job)) /* deliver them before finishing */
+        fm_job_call_main_thread(job, flush_in_main_thread, NULL);
     if(job->cancel)
         fm_job_emit_cancelled(job);
     else
@@ -326,6 +877,12 @@ gboolean fm_job_run_sync(FmJob* job)
     return ret;
 }
 
+static gpointer flush_in_main_thread(FmJob* job, gpointer unused)
+{
+    /* posts are delivered by on_idle_call() already */
+    return NULL;
+}
+
 static void on_sync_job_finished(FmJob* job, GMainLoop* mainloop)
 {
     g_main_loop_quit(mainloop);
@@ -345,6 +902,9 @@ static void on_sync_job_finished(FmJob* job, GMainLoop* mainloop)
  * threads before calling this API and lock them back after return from
  * it. This statement is valid for any GTK application that uses locks.
  *
+ * Since 1.3.2 the @job is started at once regardless of its priority
+ * class and doesn't count against limit of running jobs of the class.
+ *
  * Returns: %TRUE if job started successfully.
  *
  * Since: 0.1.1
@@ -353,6 +913,7 @@ gboolean fm_job_run_sync_with_mainloop(FmJob* job)
 {
     GMainLoop* mainloop = g_main_loop_new(NULL, FALSE);
     gboolean ret;
+    ((FmJobSched*)job->sched)->bypass = TRUE;
     g_signal_connect(job, "finished", G_CALLBACK(on_sync_job_finished), mainloop);
     ret = fm_job_run_async(job);
     if(G_LIKELY(ret))
@@ -368,8 +929,21 @@ gboolean fm_job_run_sync_with_mainloop(FmJob* job)
 static void job_thread(FmJob* job, gpointer unused)
 {
     FmJobClass* klass = FM_JOB_CLASS(G_OBJECT_GET_CLASS(job));
+    FmJobSched* sched = job->sched;
+
+    if(sched->resolving) /* not admitted yet */
+    {
+        sched_resolve_devices(sched);
+        G_LOCK(scheduler);
+        sched->resolving = FALSE;
+        sched_enqueue(job);
+        G_UNLOCK(scheduler);
+        return;
+    }
     klass->run(job);
 
+    /* let waiting jobs start */
+    sched_release(job);
     /* let the main thread know that we're done, and free the job
      * in idle handler if neede. */
     fm_job_finish(job);
@@ -387,16 +961,184 @@ static void job_thread(FmJob* job, gpointer unused)
 void fm_job_cancel(FmJob* job)
 {
     FmJobClass* klass = FM_JOB_CLASS(G_OBJECT_GET_CLASS(job));
+    FmJobSched* sched = job->sched;
+
     job->cancel = TRUE;
+    /* don't let cancelled job wait for a slot, it will finish at once */
+    G_LOCK(scheduler);
+    if(sched->link)
+    {
+        g_queue_delete_link(&sched_queues[sched->priority].waiting, sched->link);
+        sched->link = NULL;
+        sched_start(job, -1);
+    }
+    G_UNLOCK(scheduler);
     if(job->cancellable)
         g_cancellable_cancel(job->cancellable);
     if(klass->cancel)
         klass->cancel(job);
 }
 
+/* ---- notifications posted from working threads ---- */
+/* interval in milliseconds between deliveries of posted notifications */
+#define POST_INTERVAL 50
+
+typedef struct _FmJobPost
+{
+    FmJob* job;
+    FmJobCallMainThreadFunc func;
+    gpointer user_data;
+    GDestroyNotify destroy;
+}FmJobPost;
+
+static GQueue posts = G_QUEUE_INIT;
+/* coalescing posts which are waiting for delivery */
+static GHashTable* posts_coalesced = NULL;
+static guint post_handler = 0;
+G_LOCK_DEFINE_STATIC(posts);
+
+static guint post_hash(gconstpointer key)
+{
+    const FmJobPost* post = key;
+    return g_direct_hash(post->job) ^ g_direct_hash(post->func);
+}
+
+static gboolean post_equal(gconstpointer a, gconstpointer b)
+{
+    const FmJobPost *post_a = a, *post_b = b;
+    return post_a->job == post_b->job && post_a->func == post_b->func;
+}
+
+static void post_free(FmJobPost* post)
+{
+    if(post->destroy)
+        post->destroy(post->user_data);
+    g_object_unref(post->job);
+    g_slice_free(FmJobPost, post);
+}
+
+/* delivers posts of @job or of all jobs if @job is NULL in main thread */
+static void flush_posts(FmJob* job)
+{
+    GList *l, *next, *list = NULL;
+
+    G_LOCK(posts);
+    for(l = posts.head; l; l = next)
+    {
+        FmJobPost* post = l->data;
+        next = l->next;
+        if(job && post->job != job)
+            continue;
+        if(posts_coalesced && g_hash_table_lookup(posts_coalesced, post) == post)
+            g_hash_table_remove(posts_coalesced, post);
+        g_queue_unlink(&posts, l);
+        list = g_list_concat(l, list); /* reversed, it's faster */
+    }
+    G_UNLOCK(posts);
+    list = g_list_reverse(list);
+    for(l = list; l; l = l->next)
+    {
+        FmJobPost* post = l->data;
+        post->func(post->job, post->user_data);
+        post_free(post);
+    }
+    g_list_free(list);
+}
+
+static gboolean on_post_timeout(gpointer unused)
+{
+    G_LOCK(posts);
+    post_handler = 0;
+    G_UNLOCK(posts);
+    flush_posts(NULL);
+    return FALSE;
+}
+
+/* checks if there is anything posted by @job still not delivered */
+static gboolean has_posts(FmJob* job)
+{
+    GList* l;
+    gboolean found = FALSE;
+
+    G_LOCK(posts);
+    for(l = posts.head; l && !found; l = l->next)
+        found = (((FmJobPost*)l->data)->job == job);
+    G_UNLOCK(posts);
+    return found;
+}
+
+/**
+ * fm_job_post_main_thread
+ * @job: the job that calls main thread
+ * @func: callback to run from main thread
+ * @user_data: user data for the callback
+ * @destroy: (allow-none): function to free @user_data after callback
+ * @coalesce: %TRUE to replace data of previous post of @func
+ *
+ * Queues call to @func in main thread with @user_data and returns
+ * without waiting for it. Posted calls are delivered in order in
+ * batches at most 20 times per second. If @coalesce is %TRUE and
+ * previous call to @func for @job is still not delivered then only
+ * its @user_data is replaced with new one so only the latest value is
+ * delivered. That is useful for progress and status updates.
+ *
+ * All posted calls are delivered before any call made with
+ * fm_job_call_main_thread() and before the #FmJob::finished signal is
+ * emitted. Return value of @func is ignored. If @func needs an answer
+ * from main thread then use fm_job_call_main_thread() instead.
+ *
+ * This APIs is private to #FmJob and should only be used in the
+ * implementation of classes derived from #FmJob.
+ *
+ * This function should be called from working thread only.
+ *
+ * Since: 1.3.2
+ */
+void fm_job_post_main_thread(FmJob* job, FmJobCallMainThreadFunc func,
+                             gpointer user_data, GDestroyNotify destroy,
+                             gboolean coalesce)
+{
+    FmJobPost* post = g_slice_new(FmJobPost);
+    FmJobPost* old;
+
+    post->job = job;
+    post->func = func;
+    post->user_data = user_data;
+    post->destroy = destroy;
+    G_LOCK(posts);
+    if(coalesce)
+    {
+        if(G_UNLIKELY(posts_coalesced == NULL))
+            posts_coalesced = g_hash_table_new(post_hash, post_equal);
+        old = g_hash_table_lookup(posts_coalesced, post);
+        if(old)
+        {
+            /* keep place in queue but replace data, old data is freed
+               outside of the lock */
+            post->user_data = old->user_data;
+            post->destroy = old->destroy;
+            old->user_data = user_data;
+            old->destroy = destroy;
+            G_UNLOCK(posts);
+            if(post->destroy)
+                post->destroy(post->user_data);
+            g_slice_free(FmJobPost, post);
+            return;
+        }
+        g_hash_table_insert(posts_coalesced, post, post);
+    }
+    g_object_ref(job);
+    g_queue_push_tail(&posts, post);
+    if(post_handler == 0)
+        post_handler = g_timeout_add(POST_INTERVAL, on_post_timeout, NULL);
+    G_UNLOCK(posts);
+}
+
 static gboolean on_idle_call(gpointer input_data)
 {
     FmIdleCall* data = (FmIdleCall*)input_data;
+    /* deliver everything posted earlier first to keep order */
+    flush_posts(data->job);
     data->ret = data->func(data->job, data->user_data);
     return FALSE;
 }
@@ -411,6 +1153,9 @@ static gboolean on_idle_call(gpointer input_data)
  * to callback @func in main thread, gathers result of callback, and
  * returns it to caller.
  *
+ * If @func only notifies main thread and its result isn't needed then
+ * use fm_job_post_main_thread() instead which doesn't stop the job.
+ *
  * This APIs is private to #FmJob and should only be used in the
  * implementation of classes derived from #FmJob.
  *
@@ -573,6 +1318,7 @@ static gboolean on_idle_cleanup(gpointer unused)
     for(l = jobs; l; l=l->next)
     {
         FmJob* job = FM_JOB(l->data);
+        flush_posts(job);
         if(job->cancel)
             fm_job_emit_cancelled(job);
         fm_job_emit_finished(job);
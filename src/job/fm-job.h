@@ -30,6 +30,7 @@
 #include <stdarg.h>
 
 #include "fm-seal.h"
+#include "fm-path.h"
 
 /* If we're not using GNU C, elide __attribute__ */
 #ifndef __GNUC__
@@ -84,6 +85,25 @@ typedef enum {
     FM_JOB_ABORT
 } FmJobErrorAction;
 
+/**
+ * FmJobPriority
+ * @FM_JOB_PRIORITY_INTERACTIVE: jobs the user waits for, such as folder listing
+ * @FM_JOB_PRIORITY_REFRESH: updates of file information
+ * @FM_JOB_PRIORITY_BULK: file operations such as copying or deletion
+ * @FM_JOB_PRIORITY_BACKGROUND: jobs nobody waits for, such as deep counting
+ *
+ * Priority classes of jobs, in order of decreasing priority. Each class
+ * has its own limit of concurrently running jobs.
+ *
+ * Since: 1.3.2
+ */
+typedef enum {
+    FM_JOB_PRIORITY_INTERACTIVE,
+    FM_JOB_PRIORITY_REFRESH,
+    FM_JOB_PRIORITY_BULK,
+    FM_JOB_PRIORITY_BACKGROUND
+} FmJobPriority;
+
 struct _FmJob
 {
     /*< private >*/
@@ -102,7 +122,7 @@ struct _FmJob
     GStaticRecMutex FM_SEAL(stop);
 #endif
 
-    gpointer _reserved1;
+    gpointer FM_SEAL(sched); /* scheduler data, since 1.3.2 */
     gpointer _reserved2;
 };
 
@@ -177,6 +197,23 @@ gboolean fm_job_run_sync_with_mainloop(FmJob* job);
 /* Cancel the running job. can be called from any thread. */
 void fm_job_cancel(FmJob* job);
 
+/* Priority class of the job, may be changed at any time. */
+void fm_job_set_priority(FmJob* job, FmJobPriority priority);
+FmJobPriority fm_job_get_priority(FmJob* job);
+
+void fm_job_set_max_running(FmJobPriority priority, guint max_running);
+
+/* Devices used by the job, bulk jobs are admitted to slow devices one
+ * by one. Should be called before the job is started. */
+void fm_job_add_io_path(FmJob* job, FmPath* path);
+void fm_job_set_max_running_per_device(guint max_running);
+void fm_job_get_scheduler_stats(FmJobPriority priority, guint* n_running,
+                                guint* n_waiting, guint* n_started,
+                                gint64* total_wait, gint64* max_wait);
+
+/* for usage by FmFileOpsJob - never use in applications */
+gboolean _fm_job_uses_serial_device(FmJob* job);
+
 /* Following APIs are private to FmJob and should only be used in the
  * implementation of classes derived from FmJob.
  * Besides, they should be called from working thread only if another
@@ -184,6 +221,13 @@ void fm_job_cancel(FmJob* job);
 gpointer fm_job_call_main_thread(FmJob* job, FmJobCallMainThreadFunc func,
                                  gpointer user_data);
 
+/* Queue a call to func in main thread without waiting for it. Calls are
+ * delivered in batches at bounded rate, if coalesce is TRUE then only
+ * the latest user_data of not delivered call to func is kept. */
+void fm_job_post_main_thread(FmJob* job, FmJobCallMainThreadFunc func,
+                             gpointer user_data, GDestroyNotify destroy,
+                             gboolean coalesce);
+
 /* Used by derived classes to implement FmJob::run() using gio inside.
  * This API tried to initialize a GCancellable object for use with gio and
  * should only be called once in the constructor of derived classes which
@@ -0,0 +1,105 @@
+/*
+ *      bench-alloc.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Measures memory taken by FmPath and FmFileInfo objects: lists a
+   directory, keeps the files and reports listing time, growth of RSS and
+   allocator counters, then drops the files and lists the directory again
+   to show reuse of freed memory.
+   Usage: bench-alloc [n_entries]
+   Default is 500000 entries. Run it with G_SLICE=always-malloc in
+   environment to compare GSlice against plain g_malloc(). */
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fixtures.h"
+
+/* resident set size in KiB */
+static gulong get_rss(void)
+{
+    FILE *f = fopen("/proc/self/statm", "r");
+    gulong size = 0, resident = 0;
+
+    if (f)
+    {
+        if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static FmFileInfoList *list_dir(FmPath *path, const char *what)
+{
+    FmDirListJob *job = fm_dir_list_job_new2(path, FM_DIR_LIST_JOB_FAST);
+    FmFileInfoList *files = NULL;
+    gulong rss = get_rss();
+    gsize in_use;
+    guint n_objects;
+    gint64 start, end;
+
+    start = g_get_monotonic_time();
+    if (fm_job_run_sync(FM_JOB(job)))
+        files = fm_file_info_list_ref(fm_dir_list_job_get_files(job));
+    end = g_get_monotonic_time();
+    g_object_unref(job);
+
+    fm_get_allocator_stats(&in_use, &n_objects);
+    printf("%s: %u files in %9.3f ms, RSS +%lu KiB, %u objects, in use %lu KiB\n",
+           what, files ? fm_file_info_list_get_length(files) : 0,
+           (end - start) / 1000.0, get_rss() - rss, n_objects,
+           (gulong)(in_use / 1024));
+    return files;
+}
+
+int main(int argc, char *argv[])
+{
+    guint n = argc > 1 ? strtoul(argv[1], NULL, 10) : 500000;
+    const char *env = g_getenv("G_SLICE");
+    FmFileInfoList *files;
+    FmPath *path;
+    char *dir;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    dir = fixture_make_tree(n);
+    path = fm_path_new_for_path(dir);
+    printf("%u entries, %s\n", n,
+           (env && strstr(env, "always-malloc")) ? "g_malloc()" : "GSlice");
+
+    files = list_dir(path, "first listing ");
+    if (files)
+        fm_file_info_list_unref(files);
+    files = list_dir(path, "second listing");
+    if (files)
+        fm_file_info_list_unref(files);
+
+    fm_path_unref(path);
+    fixture_remove_tree(dir);
+    fm_finalize();
+    return 0;
+}
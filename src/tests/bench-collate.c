@@ -0,0 +1,185 @@
+/*
+ *      bench-collate.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Compares collate keys made by fm_file_info_get_collate_key() against
+   plain g_utf8_collate_key_for_filename() on real file names: time to
+   make keys, memory taken by stored keys, and time to sort by them, and
+   checks that both give the same keys. Names are collected recursively from given directories.
+   Usage: bench-collate [dir...]
+   Default directory is /usr/share, at most 500000 names are used. */
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+
+#define MAX_NAMES 500000
+
+static void collect_names(const char *dir_path, GPtrArray *names)
+{
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    const char *name;
+
+    if (dir == NULL)
+        return;
+    while (names->len < MAX_NAMES && (name = g_dir_read_name(dir)))
+    {
+        char *path = g_build_filename(dir_path, name, NULL);
+        g_ptr_array_add(names, g_strdup(name));
+        if (g_file_test(path, G_FILE_TEST_IS_DIR) &&
+            !g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+            collect_names(path, names);
+        g_free(path);
+    }
+    g_dir_close(dir);
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+static const char **sort_keys;
+
+static int compare_indexes(const void *a, const void *b)
+{
+    return strcmp(sort_keys[*(const guint*)a], sort_keys[*(const guint*)b]);
+}
+
+static void report(const char *what, gint64 make_time, gsize size,
+                   const char **keys, guint n)
+{
+    guint *order = g_new(guint, n);
+    gint64 start;
+    guint i;
+
+    for (i = 0; i < n; i++)
+        order[i] = i;
+    sort_keys = keys;
+    start = g_get_monotonic_time();
+    qsort(order, n, sizeof(guint), compare_indexes);
+    printf("%-6s: keys %9.3f ms, %8lu KiB stored, sort %9.3f ms\n", what,
+           make_time / 1000.0, (gulong)(size / 1024),
+           (g_get_monotonic_time() - start) / 1000.0);
+    g_free(order);
+}
+
+int main(int argc, char *argv[])
+{
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    FmPath *parent;
+    FmFileInfo **files;
+    GFileInfo *inf;
+    const char **keys;
+    char **glib_keys;
+    gint64 start, make_time;
+    gsize size;
+    guint i, n, n_ascii = 0, n_differ = 0;
+    int j;
+
+    setlocale(LC_ALL, "");
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    if (argc > 1)
+        for (j = 1; j < argc; j++)
+            collect_names(argv[j], names);
+    else
+        collect_names("/usr/share", names);
+    n = names->len;
+    /* shuffle so sort doesn't benefit from order of directory */
+    for (i = n; i > 1; i--)
+    {
+        guint k = g_random_int_range(0, i);
+        gpointer tmp = names->pdata[i - 1];
+        names->pdata[i - 1] = names->pdata[k];
+        names->pdata[k] = tmp;
+    }
+    for (i = 0; i < n; i++)
+    {
+        const guchar *p;
+        for (p = names->pdata[i]; *p >= 0x20 && *p < 0x7f; p++);
+        if (*p == '\0')
+            n_ascii++;
+    }
+    printf("%u names, %u of them are ASCII\n", n, n_ascii);
+    keys = g_new(const char*, n);
+    glib_keys = g_new(char*, n);
+
+    /* plain glib keys, as libfm did before */
+    start = g_get_monotonic_time();
+    for (i = 0; i < n; i++)
+    {
+        char *casefold = g_utf8_casefold(names->pdata[i], -1);
+        glib_keys[i] = g_utf8_collate_key_for_filename(casefold, -1);
+        g_free(casefold);
+    }
+    make_time = g_get_monotonic_time() - start;
+    for (size = 0, i = 0; i < n; i++)
+        size += strlen(glib_keys[i]) + 1;
+    report("glib", make_time, size, (const char**)glib_keys, n);
+
+    /* keys of FmFileInfo */
+    files = g_new(FmFileInfo*, n);
+    parent = fm_path_new_for_path("/nonexistent-libfm-bench");
+    inf = g_file_info_new();
+    g_file_info_set_file_type(inf, G_FILE_TYPE_REGULAR);
+    g_file_info_set_content_type(inf, "text/plain");
+    for (i = 0; i < n; i++)
+    {
+        FmPath *path = fm_path_new_child(parent, names->pdata[i]);
+        g_file_info_set_name(inf, names->pdata[i]);
+        g_file_info_set_display_name(inf, names->pdata[i]);
+        files[i] = fm_file_info_new_from_g_file_data(NULL, inf, path);
+        fm_path_unref(path);
+        /* make display name ready */
+        fm_file_info_get_disp_name(files[i]);
+    }
+    g_object_unref(inf);
+    fm_path_unref(parent);
+    start = g_get_monotonic_time();
+    for (i = 0; i < n; i++)
+        keys[i] = fm_file_info_get_collate_key(files[i]);
+    make_time = g_get_monotonic_time() - start;
+    for (size = 0, i = 0; i < n; i++)
+        if (keys[i] != fm_file_info_get_disp_name(files[i]))
+            size += strlen(keys[i]) + 1;
+    report("libfm", make_time, size, keys, n);
+    for (i = 0; i < n; i++)
+        if (strcmp(keys[i], glib_keys[i]) != 0)
+            n_differ++;
+    printf("%u keys differ from glib ones\n", n_differ);
+    for (i = 0; i < n; i++)
+    {
+        fm_file_info_unref(files[i]);
+        g_free(glib_keys[i]);
+    }
+    g_free(files);
+    g_free(glib_keys);
+
+    g_free(keys);
+    g_ptr_array_free(names, TRUE);
+    fm_finalize();
+    return n_differ ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+/*
+ *      bench-copy-small.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Measures copying of a tree of small files by FmFileOpsJob with
+   different numbers of files copied at once, in the temporary directory
+   and in /dev/shm (tmpfs) if it exists.
+   Usage: bench-copy-small [n_files [file_size]]
+   Default is 10000 files of 4096 bytes in directories of 100 files. */
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+
+#include "fixtures.h"
+
+#define FILES_PER_DIR 100
+
+static char *make_tree(const char *base, guint n, gsize size)
+{
+    char *dir = fixture_make_dir(base);
+    char *src = g_build_filename(dir, "src", NULL);
+    char name[32];
+    guint i;
+
+    g_mkdir(src, 0755);
+    for (i = 0; i < n; i += FILES_PER_DIR)
+    {
+        char *path;
+
+        g_snprintf(name, sizeof(name), "dir-%05u", i / FILES_PER_DIR);
+        path = g_build_filename(src, name, NULL);
+        g_mkdir(path, 0755);
+        fixture_make_files(path, "file", i, MIN(FILES_PER_DIR, n - i), size);
+        g_free(path);
+    }
+    g_free(src);
+    return dir;
+}
+
+static void run_bench(const char *base, guint n, gsize size, guint concurrency)
+{
+    char *dir = make_tree(base, n, size);
+    char *src = g_build_filename(dir, "src", NULL);
+    char *dest = g_build_filename(dir, "dest", NULL);
+    FmPathList *srcs = fm_path_list_new();
+    FmPath *src_path = fm_path_new_for_path(src);
+    FmPath *dest_path;
+    FmFileOpsJob *job;
+    gint64 start, end;
+    gboolean ok;
+
+    g_mkdir(dest, 0755);
+    dest_path = fm_path_new_for_path(dest);
+    fm_path_list_push_tail(srcs, src_path);
+    job = fm_file_ops_job_new(FM_FILE_OP_COPY, srcs);
+    fm_file_ops_job_set_dest(job, dest_path);
+    fm_file_ops_job_set_concurrency(job, concurrency);
+
+    start = g_get_monotonic_time();
+    ok = fm_job_run_sync_with_mainloop(FM_JOB(job));
+    end = g_get_monotonic_time();
+
+    printf("%-12s %8u files of %6u bytes, %u at once: %9.3f ms%s\n",
+           base, n, (guint)size, concurrency, (end - start) / 1000.0,
+           ok ? "" : " (failed)");
+
+    g_object_unref(job);
+    fm_path_unref(dest_path);
+    fm_path_unref(src_path);
+    fm_path_list_unref(srcs);
+    fixture_remove_tree(dir);
+    g_free(dest);
+    g_free(src);
+}
+
+int main(int argc, char *argv[])
+{
+    static const guint concurrency[] = { 1, 4, 8 };
+    const char *bases[2];
+    guint n = 10000, n_bases = 0, i, j;
+    gsize size = 4096;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    if (argc > 1)
+        n = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        size = strtoul(argv[2], NULL, 10);
+    bases[n_bases++] = g_get_tmp_dir();
+    if (g_file_test("/dev/shm", G_FILE_TEST_IS_DIR))
+        bases[n_bases++] = "/dev/shm";
+
+    for (i = 0; i < n_bases; i++)
+        for (j = 0; j < G_N_ELEMENTS(concurrency); j++)
+            run_bench(bases[i], n, size, concurrency[j]);
+
+    fm_finalize();
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ *      bench-dir-list-job.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Measures incremental directory listing: time until the first
+   FmDirListJob::files-found batch and total listing time.
+   Usage: bench-dir-list-job [n_entries...]
+   Default sizes are 10000, 100000 and 1000000 entries. */
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fixtures.h"
+
+typedef struct
+{
+    GMainLoop *mainloop;
+    gint64 start;
+    gint64 first_batch;
+    guint n_batches;
+    guint n_found;
+} BenchData;
+
+static void on_files_found(FmDirListJob *job, GSList *files, BenchData *data)
+{
+    if (data->n_batches++ == 0)
+        data->first_batch = g_get_monotonic_time();
+    data->n_found += g_slist_length(files);
+}
+
+static void on_finished(FmJob *job, BenchData *data)
+{
+    g_main_loop_quit(data->mainloop);
+}
+
+static void run_bench(guint n)
+{
+    char *dir = fixture_make_tree(n);
+    FmPath *path = fm_path_new_for_path(dir);
+    FmDirListJob *job = fm_dir_list_job_new2(path, FM_DIR_LIST_JOB_FAST);
+    BenchData data = { NULL, 0, 0, 0, 0 };
+    gint64 end;
+
+    data.mainloop = g_main_loop_new(NULL, FALSE);
+    fm_dir_list_job_set_incremental(job, TRUE);
+    g_signal_connect(job, "files-found", G_CALLBACK(on_files_found), &data);
+    g_signal_connect(job, "finished", G_CALLBACK(on_finished), &data);
+    data.start = g_get_monotonic_time();
+    if (fm_job_run_async(FM_JOB(job)))
+        g_main_loop_run(data.mainloop);
+    end = g_get_monotonic_time();
+
+    printf("%8u entries: first batch %8.3f ms, total %9.3f ms, %u batches, %u files\n",
+           n, (data.first_batch - data.start) / 1000.0,
+           (end - data.start) / 1000.0, data.n_batches, data.n_found);
+
+    g_object_unref(job);
+    g_main_loop_unref(data.mainloop);
+    fm_path_unref(path);
+    fixture_remove_tree(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    static const guint default_sizes[] = { 10000, 100000, 1000000 };
+    int i;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    if (argc > 1)
+        for (i = 1; i < argc; i++)
+            run_bench(strtoul(argv[i], NULL, 10));
+    else
+        for (i = 0; i < (int)G_N_ELEMENTS(default_sizes); i++)
+            run_bench(default_sizes[i]);
+
+    fm_finalize();
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ *      bench-folder-events.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Replays a storm of monitor events on a loaded FmFolder: every existing
+   file is touched, the same number of new files is created and half of
+   the existing files are deleted. Reports time of lookups by name and
+   time until the folder has processed all additions and deletions.
+   Usage: bench-folder-events [n_entries...]
+   Default sizes are 1000, 10000 and 50000 entries. */
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <utime.h>
+#include <glib/gstdio.h>
+
+#include "fixtures.h"
+
+#define STORM_TIMEOUT_SEC 600
+
+typedef struct
+{
+    GMainLoop *mainloop;
+    guint n_added;
+    guint n_removed;
+    guint n_changed;
+    guint want_added;
+    guint want_removed;
+    gint64 last_event;
+    gboolean timed_out;
+} BenchData;
+
+static void on_finish_loading(FmFolder *folder, BenchData *data)
+{
+    g_main_loop_quit(data->mainloop);
+}
+
+static void check_done(BenchData *data)
+{
+    data->last_event = g_get_monotonic_time();
+    if (data->n_added >= data->want_added && data->n_removed >= data->want_removed)
+        g_main_loop_quit(data->mainloop);
+}
+
+static void on_files_added(FmFolder *folder, GSList *files, BenchData *data)
+{
+    data->n_added += g_slist_length(files);
+    check_done(data);
+}
+
+static void on_files_removed(FmFolder *folder, GSList *files, BenchData *data)
+{
+    data->n_removed += g_slist_length(files);
+    check_done(data);
+}
+
+static void on_files_changed(FmFolder *folder, GSList *files, BenchData *data)
+{
+    data->n_changed += g_slist_length(files);
+}
+
+static gboolean on_timeout(BenchData *data)
+{
+    data->timed_out = TRUE;
+    g_main_loop_quit(data->mainloop);
+    return FALSE;
+}
+
+static void run_bench(guint n)
+{
+    char *dir = fixture_make_tree(n);
+    BenchData data = { NULL, 0, 0, 0, 0, 0, 0, FALSE };
+    FmFolder *folder;
+    char name[32];
+    gint64 start, lookup_time, storm_end;
+    guint i, timeout;
+
+    data.mainloop = g_main_loop_new(NULL, FALSE);
+    folder = fm_folder_from_path_name(dir);
+    g_signal_connect(folder, "finish-loading", G_CALLBACK(on_finish_loading), &data);
+    if (!fm_folder_is_loaded(folder))
+        g_main_loop_run(data.mainloop);
+    g_signal_handlers_disconnect_by_func(folder, on_finish_loading, &data);
+
+    /* lookups by name */
+    start = g_get_monotonic_time();
+    for (i = 0; i < n; i++)
+    {
+        g_snprintf(name, sizeof(name), "file-%08u.txt", i);
+        g_assert(fm_folder_get_file_by_name(folder, name) != NULL);
+    }
+    lookup_time = g_get_monotonic_time() - start;
+
+    /* the storm */
+    g_signal_connect(folder, "files-added", G_CALLBACK(on_files_added), &data);
+    g_signal_connect(folder, "files-removed", G_CALLBACK(on_files_removed), &data);
+    g_signal_connect(folder, "files-changed", G_CALLBACK(on_files_changed), &data);
+    data.want_added = n;
+    data.want_removed = n / 2;
+    start = g_get_monotonic_time();
+    for (i = 0; i < n; i++)
+    {
+        char *path;
+        g_snprintf(name, sizeof(name), "file-%08u.txt", i);
+        path = g_build_filename(dir, name, NULL);
+        utime(path, NULL);
+        if (i % 2)
+            g_unlink(path);
+        g_free(path);
+        fixture_make_files(dir, "new", i, 1, 0);
+    }
+    timeout = g_timeout_add_seconds(STORM_TIMEOUT_SEC, (GSourceFunc)on_timeout, &data);
+    g_main_loop_run(data.mainloop);
+    if (!data.timed_out)
+        g_source_remove(timeout);
+    storm_end = data.last_event;
+
+    printf("%8u entries: lookup %8.3f ms, storm %9.3f ms, %u added, %u removed, %u changed%s\n",
+           n, lookup_time / 1000.0, (storm_end - start) / 1000.0,
+           data.n_added, data.n_removed, data.n_changed,
+           data.timed_out ? " (timed out)" : "");
+
+    g_object_unref(folder);
+    g_main_loop_unref(data.mainloop);
+    fixture_remove_tree(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    static const guint default_sizes[] = { 1000, 10000, 50000 };
+    int i;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    if (argc > 1)
+        for (i = 1; i < argc; i++)
+            run_bench(strtoul(argv[i], NULL, 10));
+    else
+        for (i = 0; i < (int)G_N_ELEMENTS(default_sizes); i++)
+            run_bench(default_sizes[i]);
+
+    fm_finalize();
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ *      bench-mime-globs.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Compares guessing of content type by file name in
+   fm_mime_type_from_file_name() against g_content_type_guess() on real
+   file names: time per name and number of names where results differ.
+   Names are collected recursively from given directories.
+   Usage: bench-mime-globs [dir...]
+   Default directory is /usr/share, at most 500000 names are used. */
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NAMES 500000
+
+static void collect_names(const char *dir_path, GPtrArray *names)
+{
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    const char *name;
+
+    if (dir == NULL)
+        return;
+    while (names->len < MAX_NAMES && (name = g_dir_read_name(dir)))
+    {
+        char *path = g_build_filename(dir_path, name, NULL);
+        g_ptr_array_add(names, g_strdup(name));
+        if (g_file_test(path, G_FILE_TEST_IS_DIR) &&
+            !g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+            collect_names(path, names);
+        g_free(path);
+    }
+    g_dir_close(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    FmMimeType **types;
+    gint64 start, gio_time, fm_time;
+    guint i, n, n_diff = 0;
+    int j;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    if (argc > 1)
+        for (j = 1; j < argc; j++)
+            collect_names(argv[j], names);
+    else
+        collect_names("/usr/share", names);
+    n = names->len;
+    types = g_new(FmMimeType*, n);
+
+    /* the first call loads tables, don't count it */
+    fm_mime_type_unref(fm_mime_type_from_file_name("test.txt"));
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < n; i++)
+    {
+        gboolean uncertain;
+        char *type = g_content_type_guess(names->pdata[i], NULL, 0, &uncertain);
+        types[i] = fm_mime_type_from_name(type);
+        g_free(type);
+    }
+    gio_time = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < n; i++)
+    {
+        FmMimeType *mime_type = fm_mime_type_from_file_name(names->pdata[i]);
+        if (mime_type != types[i])
+        {
+            if (n_diff++ < 10)
+                printf("differs: %s: %s instead of %s\n", (char*)names->pdata[i],
+                       fm_mime_type_get_type(mime_type),
+                       fm_mime_type_get_type(types[i]));
+        }
+        fm_mime_type_unref(mime_type);
+    }
+    fm_time = g_get_monotonic_time() - start;
+
+    printf("%u names: GIO %8.3f ms (%.0f ns/name), libfm %8.3f ms (%.0f ns/name), %u differ\n",
+           n, gio_time / 1000.0, n ? gio_time * 1000.0 / n : 0.0,
+           fm_time / 1000.0, n ? fm_time * 1000.0 / n : 0.0, n_diff);
+
+    for (i = 0; i < n; i++)
+        fm_mime_type_unref(types[i]);
+    g_free(types);
+    g_ptr_array_free(names, TRUE);
+    fm_finalize();
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ *      bench-path-intern.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Measures contention on FmPath creation: runs N FmDirListJob in parallel
+   over N disjoint directories and reports listing throughput for N from 1
+   up to number of processors.
+   Usage: bench-path-intern [n_entries_per_dir]
+   Default is 20000 entries per directory. */
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "fixtures.h"
+
+typedef struct
+{
+    GMainLoop *mainloop;
+    guint n_running;
+    guint n_found;
+} BenchData;
+
+static void on_finished(FmDirListJob *job, BenchData *data)
+{
+    data->n_found += fm_file_info_list_get_length(fm_dir_list_job_get_files(job));
+    if (--data->n_running == 0)
+        g_main_loop_quit(data->mainloop);
+}
+
+static void run_bench(char **dirs, guint n_jobs, guint n)
+{
+    BenchData data = { NULL, 0, 0 };
+    FmDirListJob **jobs = g_new(FmDirListJob *, n_jobs);
+    gint64 start, end;
+    guint i;
+
+    data.mainloop = g_main_loop_new(NULL, FALSE);
+    for (i = 0; i < n_jobs; i++)
+    {
+        FmPath *path = fm_path_new_for_path(dirs[i]);
+        jobs[i] = fm_dir_list_job_new2(path, FM_DIR_LIST_JOB_FAST);
+        fm_path_unref(path);
+        g_signal_connect(jobs[i], "finished", G_CALLBACK(on_finished), &data);
+    }
+    start = g_get_monotonic_time();
+    for (i = 0; i < n_jobs; i++)
+        if (fm_job_run_async(FM_JOB(jobs[i])))
+            data.n_running++;
+    if (data.n_running > 0)
+        g_main_loop_run(data.mainloop);
+    end = g_get_monotonic_time();
+
+    printf("%3u jobs: %9.3f ms, %10.0f files/s, %u files\n", n_jobs,
+           (end - start) / 1000.0, data.n_found * 1000000.0 / (end - start),
+           data.n_found);
+
+    /* all paths are freed with jobs so next run creates them again */
+    for (i = 0; i < n_jobs; i++)
+        g_object_unref(jobs[i]);
+    g_free(jobs);
+    g_main_loop_unref(data.mainloop);
+}
+
+int main(int argc, char *argv[])
+{
+    guint n = 20000, n_cpus, i;
+    char *top, **dirs;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    if (argc > 1)
+        n = strtoul(argv[1], NULL, 10);
+    n_cpus = MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+
+    top = fixture_make_dir(NULL);
+    dirs = g_new(char *, n_cpus);
+    for (i = 0; i < n_cpus; i++)
+    {
+        dirs[i] = fixture_make_dir(top);
+        fixture_make_files(dirs[i], "file", 0, n, 0);
+    }
+
+    for (i = 1; i <= n_cpus; i *= 2)
+        run_bench(dirs, i, n);
+    if (i / 2 != n_cpus)
+        run_bench(dirs, n_cpus, n);
+
+    for (i = 0; i < n_cpus; i++)
+        g_free(dirs[i]);
+    g_free(dirs);
+    fixture_remove_tree(top);
+
+    fm_finalize();
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ *      bench-sniff-cache.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Measures detailed listing of a directory of files without suffix, so
+   content type of each file is detected by its contents, with persistent
+   content type cache disabled, with empty cache, and with filled cache.
+   Each pass is run in a new process, as opening a folder after restart.
+   Usage: bench-sniff-cache [n_entries]
+   Default is 20000 entries. Drop page cache before each pass to include
+   disk reads into cold results. */
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fixtures.h"
+
+static const char *contents[] = {
+    "#!/bin/sh\necho hello\n",
+    "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n1 0 obj\n",
+    "\x89PNG\r\n\x1a\n\0\0\0\rIHDR",
+    "From someone@example.com Mon Jan  1 00:00:00 2001\nSubject: test\n\n",
+    "Just some plain text in a file without suffix.\n"
+};
+
+static char *make_tree(guint n)
+{
+    char *dir = fixture_make_dir(NULL);
+    char name[32];
+    guint i;
+
+    for (i = 0; i < n; i++)
+    {
+        char *path;
+        const char *data = contents[i % G_N_ELEMENTS(contents)];
+        g_snprintf(name, sizeof(name), "file-%08u", i);
+        path = g_build_filename(dir, name, NULL);
+        /* PNG header contains NUL bytes, write 16 bytes of it */
+        g_assert(g_file_set_contents(path, data, data[0] == '\x89' ? 16 : -1, NULL));
+        g_free(path);
+    }
+    return dir;
+}
+
+/* runs in child process */
+static int run_pass(const char *dir, gboolean use_cache)
+{
+    FmPath *path;
+    FmDirListJob *job;
+    gint64 start, listed, end;
+    guint hits, misses, n_entries;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+    if (!use_cache)
+        fm_mime_type_set_sniff_cache_limit(0);
+    path = fm_path_new_for_path(dir);
+    job = fm_dir_list_job_new2(path, FM_DIR_LIST_JOB_DETAILED);
+    start = g_get_monotonic_time();
+    fm_job_run_sync(FM_JOB(job));
+    listed = g_get_monotonic_time();
+    fm_mime_type_get_sniff_cache_stats(&hits, &misses, &n_entries);
+    g_object_unref(job);
+    fm_path_unref(path);
+    fm_finalize(); /* the cache is saved here */
+    end = g_get_monotonic_time();
+    printf("listing %9.3f ms, finalize %8.3f ms, %u hits, %u misses, %u cached\n",
+           (listed - start) / 1000.0, (end - listed) / 1000.0,
+           hits, misses, n_entries);
+    return 0;
+}
+
+static void spawn_pass(const char *self, const char *what, const char *dir,
+                       const char *cache_dir, gboolean use_cache)
+{
+    char *argv[] = { (char*)self, "--pass", (char*)dir,
+                     use_cache ? "cache" : "nocache", NULL };
+    char **envp = g_get_environ();
+    char *out = NULL;
+    int status;
+
+    envp = g_environ_setenv(envp, "XDG_CACHE_HOME", cache_dir, TRUE);
+    if (g_spawn_sync(NULL, argv, envp, 0, NULL, NULL, &out, NULL, &status, NULL))
+        printf("%-8s: %s", what, out);
+    g_free(out);
+    g_strfreev(envp);
+}
+
+int main(int argc, char *argv[])
+{
+    char *dir, *cache_dir;
+    guint n = 20000;
+
+    if (argc == 4 && strcmp(argv[1], "--pass") == 0)
+        return run_pass(argv[2], strcmp(argv[3], "cache") == 0);
+    if (argc > 1)
+        n = strtoul(argv[1], NULL, 10);
+
+    dir = make_tree(n);
+    cache_dir = fixture_make_dir(NULL);
+    printf("%u files without suffix\n", n);
+    spawn_pass(argv[0], "no cache", dir, cache_dir, FALSE);
+    spawn_pass(argv[0], "cold", dir, cache_dir, TRUE);
+    spawn_pass(argv[0], "warm", dir, cache_dir, TRUE);
+    fixture_remove_tree(cache_dir);
+    fixture_remove_tree(dir);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ *      fixtures.c
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+//ignore for test disabled asserts
+#ifdef G_DISABLE_ASSERT
+#  undef G_DISABLE_ASSERT
+#endif
+
+#include "fixtures.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+/* creates new empty directory in @parent, or in temporary directory if
+   @parent is NULL, returns newly allocated path */
+char *fixture_make_dir(const char *parent)
+{
+    char *dir;
+
+    if (parent == NULL)
+        dir = g_dir_make_tmp("libfm-test-XXXXXX", NULL);
+    else
+    {
+        char *tmpl = g_build_filename(parent, "libfm-test-XXXXXX", NULL);
+        dir = g_mkdtemp(tmpl);
+        if (dir == NULL)
+            g_free(tmpl);
+    }
+    g_assert(dir != NULL);
+    return dir;
+}
+
+/* creates files "@prefix-NNNNNNNN.txt" numbered from @first in @dir,
+   each of @size zero bytes */
+void fixture_make_files(const char *dir, const char *prefix, guint first,
+                        guint n, gsize size)
+{
+    char *buf = size ? g_malloc0(size) : NULL;
+    char name[64];
+    guint i;
+
+    for (i = first; i < first + n; i++)
+    {
+        char *path;
+        int fd;
+
+        g_snprintf(name, sizeof(name), "%s-%08u.txt", prefix, i);
+        path = g_build_filename(dir, name, NULL);
+        fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        g_assert(fd >= 0);
+        if (size)
+            g_assert(write(fd, buf, size) == (ssize_t)size);
+        close(fd);
+        g_free(path);
+    }
+    g_free(buf);
+}
+
+/* creates temporary directory with @n empty files "file-NNNNNNNN.txt" */
+char *fixture_make_tree(guint n)
+{
+    char *dir = fixture_make_dir(NULL);
+
+    fixture_make_files(dir, "file", 0, n, 0);
+    return dir;
+}
+
+/* removes @dir with all its contents and frees @dir */
+void fixture_remove_tree(char *dir)
+{
+    GDir *gd = g_dir_open(dir, 0, NULL);
+    const char *name;
+
+    while (gd && (name = g_dir_read_name(gd)))
+    {
+        char *path = g_build_filename(dir, name, NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_DIR) &&
+            !g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+            fixture_remove_tree(path);
+        else
+        {
+            g_unlink(path);
+            g_free(path);
+        }
+    }
+    if (gd)
+        g_dir_close(gd);
+    g_rmdir(dir);
+    g_free(dir);
+}
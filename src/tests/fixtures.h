@@ -0,0 +1,39 @@
+/*
+ *      fixtures.h
+ *
+ *      This file is a part of the Libfm library.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Directory trees for tests and benchmarks. */
+
+#ifndef __FIXTURES_H__
+#define __FIXTURES_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+char *fixture_make_dir(const char *parent);
+void fixture_make_files(const char *dir, const char *prefix, guint first,
+                        guint n, gsize size);
+char *fixture_make_tree(guint n);
+void fixture_remove_tree(char *dir);
+
+G_END_DECLS
+
+#endif /* __FIXTURES_H__ */
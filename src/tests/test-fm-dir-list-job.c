@@ -0,0 +1,141 @@
+/*
+ *      test-fm-dir-list-job.c
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+//ignore for test disabled asserts
+#ifdef G_DISABLE_ASSERT
+#  undef G_DISABLE_ASSERT
+#endif
+
+#include <fm.h>
+
+#include "fixtures.h"
+
+/* more than few chunks of worker and more than one emission batch */
+#define N_FILES 5000
+
+typedef struct
+{
+    GMainLoop *mainloop;
+    GHashTable *found; /* name -> number of times */
+    guint n_batches;
+    gboolean finished;
+} ListData;
+
+static void on_files_found(FmDirListJob *job, GSList *files, ListData *data)
+{
+    g_assert(!data->finished);
+    data->n_batches++;
+    for (; files; files = files->next)
+    {
+        const char *name = fm_file_info_get_name(files->data);
+        guint n = GPOINTER_TO_UINT(g_hash_table_lookup(data->found, name));
+        g_hash_table_insert(data->found, g_strdup(name), GUINT_TO_POINTER(n + 1));
+    }
+}
+
+static void on_finished(FmJob *job, ListData *data)
+{
+    data->finished = TRUE;
+    g_main_loop_quit(data->mainloop);
+}
+
+static FmDirListJob *list_dir(const char *dir, gboolean incremental, ListData *data)
+{
+    FmPath *path = fm_path_new_for_path(dir);
+    FmDirListJob *job = fm_dir_list_job_new2(path, FM_DIR_LIST_JOB_FAST);
+
+    data->mainloop = g_main_loop_new(NULL, FALSE);
+    data->found = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    data->n_batches = 0;
+    data->finished = FALSE;
+    fm_dir_list_job_set_incremental(job, incremental);
+    g_signal_connect(job, "files-found", G_CALLBACK(on_files_found), data);
+    g_signal_connect(job, "finished", G_CALLBACK(on_finished), data);
+    g_assert(fm_job_run_async(FM_JOB(job)));
+    g_main_loop_run(data->mainloop);
+    g_main_loop_unref(data->mainloop);
+    fm_path_unref(path);
+    return job;
+}
+
+static void test_incremental(void)
+{
+    char *dir = fixture_make_tree(N_FILES);
+    ListData data;
+    FmDirListJob *job = list_dir(dir, TRUE, &data);
+    FmFileInfoList *files = fm_dir_list_job_get_files(job);
+    GList *l;
+
+    /* every file was reported once before the job finished */
+    g_assert_cmpuint(fm_file_info_list_get_length(files), ==, N_FILES);
+    g_assert_cmpuint(g_hash_table_size(data.found), ==, N_FILES);
+    for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+    {
+        const char *name = fm_file_info_get_name(l->data);
+        g_assert_cmpuint(GPOINTER_TO_UINT(g_hash_table_lookup(data.found, name)), ==, 1);
+    }
+    g_assert_cmpuint(data.n_batches, >, 0);
+
+    g_hash_table_destroy(data.found);
+    g_object_unref(job);
+    fixture_remove_tree(dir);
+}
+
+static void test_not_incremental(void)
+{
+    char *dir = fixture_make_tree(N_FILES);
+    ListData data;
+    FmDirListJob *job = list_dir(dir, FALSE, &data);
+
+    g_assert_cmpuint(fm_file_info_list_get_length(fm_dir_list_job_get_files(job)), ==, N_FILES);
+    g_assert_cmpuint(data.n_batches, ==, 0);
+
+    g_hash_table_destroy(data.found);
+    g_object_unref(job);
+    fixture_remove_tree(dir);
+}
+
+static void test_empty(void)
+{
+    char *dir = fixture_make_tree(0);
+    ListData data;
+    FmDirListJob *job = list_dir(dir, TRUE, &data);
+
+    g_assert(fm_file_info_list_is_empty(fm_dir_list_job_get_files(job)));
+    g_assert_cmpuint(data.n_batches, ==, 0);
+
+    g_hash_table_destroy(data.found);
+    g_object_unref(job);
+    fixture_remove_tree(dir);
+}
+
+int main (int   argc, char *argv[])
+{
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    g_test_init (&argc, &argv, NULL); // initialize test program
+    g_test_add_func("/FmDirListJob/incremental", test_incremental);
+    g_test_add_func("/FmDirListJob/not_incremental", test_not_incremental);
+    g_test_add_func("/FmDirListJob/empty", test_empty);
+
+    return g_test_run();
+}
@@ -0,0 +1,246 @@
+/*
+ *      test-fm-file-info.c
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+//ignore for test disabled asserts
+#ifdef G_DISABLE_ASSERT
+#  undef G_DISABLE_ASSERT
+#endif
+
+#include <fm.h>
+#include <stdio.h>
+#include <locale.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include "fixtures.h"
+
+static const char *self = NULL;
+
+/* collate keys of ASCII names are made by libfm itself, they should be
+   the same as glib makes so keys of all names are comparable */
+static void check_collate_keys(const char *name)
+{
+    FmPath *path = fm_path_new_child(fm_path_get_root(), name);
+    FmFileInfo *fi = fm_file_info_new();
+    char *casefold = g_utf8_casefold(name, -1);
+    char *key = g_utf8_collate_key_for_filename(casefold, -1);
+    char *key_case = g_utf8_collate_key_for_filename(name, -1);
+
+    fm_file_info_set_path(fi, path);
+    if (strcmp(fm_file_info_get_collate_key(fi), key) != 0)
+        g_error("collate key of '%s' differs from glib in locale %s",
+                name, setlocale(LC_COLLATE, NULL));
+    if (strcmp(fm_file_info_get_collate_key_nocasefold(fi), key_case) != 0)
+        g_error("case-sensitive collate key of '%s' differs from glib in locale %s",
+                name, setlocale(LC_COLLATE, NULL));
+    g_free(key_case);
+    g_free(key);
+    g_free(casefold);
+    fm_file_info_unref(fi);
+    fm_path_unref(path);
+}
+
+static void test_collate_keys(void)
+{
+    static const char *locales[] = {
+        "C", "C.UTF-8", "en_US.UTF-8", "de_DE.UTF-8", "sv_SE.UTF-8"
+    };
+    static const char *names[] = {
+        "a", "A", "abc", "ABC", "aBc", "file.txt", "File.TXT", "file10.txt",
+        "file9.txt", "file09.txt", "file009", "file0", "file00", "00", "0",
+        "0.0", "1.10.2", "v1.2.3-rc1", "a..b", ".hidden", "trailing.",
+        "x 1", "x  2", "under_score", "dash-name", "tilde~", "[bracket]",
+        "semi;colon", "colon:name", "MiXeD123CaSe456", "12345678901234567890",
+        "a0b00c000", "Zebra", "zebra", "_first", "~last",
+        /* these are made by glib in both cases */
+        "\xc3\xa4pfel", "na\xc3\xafve.txt"
+    };
+    char *saved = g_strdup(setlocale(LC_ALL, NULL));
+    guint i, j, n_locales = 0;
+
+    for (i = 0; i < G_N_ELEMENTS(locales); i++)
+    {
+        if (setlocale(LC_ALL, locales[i]) == NULL)
+            continue; /* not installed */
+        n_locales++;
+        for (j = 0; j < G_N_ELEMENTS(names); j++)
+            check_collate_keys(names[j]);
+    }
+    setlocale(LC_ALL, saved);
+    g_free(saved);
+    g_assert_cmpuint(n_locales, >, 0);
+}
+
+/* rewrites desktop entry @path in place, so inode is the same */
+static void write_desktop_entry(const char *path, const char *name)
+{
+    FILE *f = fopen(path, "w");
+
+    g_assert(f != NULL);
+    fprintf(f, "[Desktop Entry]\nType=Application\nName=%s\nExec=true\n", name);
+    fclose(f);
+}
+
+/* rewrites desktop entry @path in place keeping size and modification
+   time, so the cached entry is still considered valid */
+static void write_desktop_entry_unnoticed(const char *path, const char *name)
+{
+    struct stat st;
+    struct utimbuf times;
+
+    g_assert(stat(path, &st) == 0);
+    write_desktop_entry(path, name);
+    times.actime = st.st_atime;
+    times.modtime = st.st_mtime;
+    g_assert(utime(path, &times) == 0);
+}
+
+static char *get_disp_name(const char *path)
+{
+    FmPath *fm_path = fm_path_new_for_path(path);
+    FmFileInfo *fi = fm_file_info_new();
+    char *name;
+
+    fm_file_info_set_path(fi, fm_path);
+    g_assert(fm_file_info_set_from_native_file(fi, path, NULL));
+    name = g_strdup(fm_file_info_get_disp_name(fi));
+    fm_file_info_unref(fi);
+    fm_path_unref(fm_path);
+    return name;
+}
+
+static void check_disp_name(const char *path, const char *expected)
+{
+    char *name = get_disp_name(path);
+
+    g_assert_cmpstr(name, ==, expected);
+    g_free(name);
+}
+
+static void test_desktop_cache(void)
+{
+    char *dir = fixture_make_dir(NULL);
+    char *path = g_build_filename(dir, "app.desktop", NULL);
+
+    write_desktop_entry(path, "Alpha");
+    check_disp_name(path, "Alpha");
+    /* the cached entry is used while size and time are the same */
+    write_desktop_entry_unnoticed(path, "Omega");
+    check_disp_name(path, "Alpha");
+    /* and is dropped when size is changed */
+    write_desktop_entry(path, "Omega 2");
+    check_disp_name(path, "Omega 2");
+
+    g_free(path);
+    fixture_remove_tree(dir);
+}
+
+static void test_desktop_cache_disabled(void)
+{
+    char *dir = fixture_make_dir(NULL);
+    char *path = g_build_filename(dir, "app.desktop", NULL);
+
+    fm_file_info_set_desktop_entry_cache(0, TRUE);
+    write_desktop_entry(path, "Alpha");
+    check_disp_name(path, "Alpha");
+    write_desktop_entry_unnoticed(path, "Omega");
+    check_disp_name(path, "Omega");
+    fm_file_info_set_desktop_entry_cache(1024, TRUE); /* the default */
+
+    g_free(path);
+    fixture_remove_tree(dir);
+}
+
+/* runs in child process: prints display name of desktop entry @path */
+static int run_desktop_pass(const char *path)
+{
+    char *name;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+    name = get_disp_name(path);
+    fm_finalize(); /* the cache is saved here */
+    printf("%s\n", name);
+    g_free(name);
+    return 0;
+}
+
+static void check_desktop_pass(const char *path, const char *expected)
+{
+    char *argv[] = { (char*)self, "--desktop-pass", (char*)path, NULL };
+    char *out = NULL;
+    int status;
+
+    g_assert(g_spawn_sync(NULL, argv, NULL, 0, NULL, NULL, &out, NULL, &status, NULL));
+    g_assert_cmpint(status, ==, 0);
+    g_assert(out != NULL);
+    g_strchomp(out);
+    g_assert_cmpstr(out, ==, expected);
+    g_free(out);
+}
+
+static void test_desktop_cache_saved(void)
+{
+    char *dir = fixture_make_dir(NULL);
+    char *path = g_build_filename(dir, "saved.desktop", NULL);
+
+    /* the next process gets the entry from the cache saved at exit */
+    write_desktop_entry(path, "Alpha");
+    check_desktop_pass(path, "Alpha");
+    write_desktop_entry_unnoticed(path, "Omega");
+    check_desktop_pass(path, "Alpha");
+
+    g_free(path);
+    fixture_remove_tree(dir);
+}
+
+int main (int   argc, char *argv[])
+{
+    char *cache_home;
+    int ret;
+
+    if (argc == 3 && strcmp(argv[1], "--desktop-pass") == 0)
+        return run_desktop_pass(argv[2]);
+    self = argv[0];
+
+    /* use own cache dir, it should be done before GLib reads environment
+       first time */
+    cache_home = fixture_make_dir(NULL);
+    g_setenv("XDG_CACHE_HOME", cache_home, TRUE);
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    g_test_init (&argc, &argv, NULL); // initialize test program
+    g_test_add_func("/FmFileInfo/collate_keys", test_collate_keys);
+    g_test_add_func("/FmFileInfo/desktop_cache", test_desktop_cache);
+    g_test_add_func("/FmFileInfo/desktop_cache_disabled", test_desktop_cache_disabled);
+    g_test_add_func("/FmFileInfo/desktop_cache_saved", test_desktop_cache_saved);
+
+    ret = g_test_run();
+
+    fm_finalize();
+    fixture_remove_tree(cache_home);
+    return ret;
+}
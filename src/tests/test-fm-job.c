@@ -0,0 +1,241 @@
+/*
+ *      test-fm-job.c
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+//ignore for test disabled asserts
+#ifdef G_DISABLE_ASSERT
+#  undef G_DISABLE_ASSERT
+#endif
+
+#include <fm.h>
+
+/* waits are limited to 10 seconds so broken scheduler fails the test */
+#define WAIT_STEP_USEC 1000
+#define WAIT_STEPS 10000
+
+typedef struct
+{
+    volatile gint gate; /* gated jobs run until it's opened */
+    volatile gint n_running;
+    volatile gint max_running;
+    volatile gint n_ran;
+    guint n_finished;
+} SchedData;
+
+static gboolean gated_job(FmJob *job, gpointer user_data)
+{
+    SchedData *data = user_data;
+    gint n, max;
+
+    g_atomic_int_inc(&data->n_running);
+    n = g_atomic_int_get(&data->n_running);
+    do
+        max = g_atomic_int_get(&data->max_running);
+    while (n > max && !g_atomic_int_compare_and_exchange(&data->max_running, max, n));
+    g_atomic_int_inc(&data->n_ran);
+    while (!g_atomic_int_get(&data->gate) && !fm_job_is_cancelled(job))
+        g_usleep(WAIT_STEP_USEC);
+    g_atomic_int_add(&data->n_running, -1);
+    return TRUE;
+}
+
+static gboolean quick_job(FmJob *job, gpointer user_data)
+{
+    SchedData *data = user_data;
+
+    g_atomic_int_inc(&data->n_ran);
+    return TRUE;
+}
+
+static void on_finished(FmJob *job, SchedData *data)
+{
+    data->n_finished++;
+}
+
+static FmJob *start_job(SchedData *data, FmSimpleJobFunc func, FmJobPriority priority)
+{
+    FmJob *job = fm_simple_job_new(func, data, NULL);
+
+    fm_job_set_priority(job, priority);
+    g_signal_connect(job, "finished", G_CALLBACK(on_finished), data);
+    g_assert(fm_job_run_async(job));
+    return job;
+}
+
+static void wait_for_ran(SchedData *data, gint n_ran)
+{
+    guint i;
+
+    for (i = 0; i < WAIT_STEPS && g_atomic_int_get(&data->n_ran) < n_ran; i++)
+        g_usleep(WAIT_STEP_USEC);
+    g_assert_cmpint(g_atomic_int_get(&data->n_ran), ==, n_ran);
+}
+
+static void wait_for_finished(SchedData *data, guint n_finished)
+{
+    guint i;
+
+    for (i = 0; i < WAIT_STEPS && data->n_finished < n_finished; i++)
+    {
+        while (g_main_context_iteration(NULL, FALSE))
+            ;
+        if (data->n_finished < n_finished)
+            g_usleep(WAIT_STEP_USEC);
+    }
+    g_assert_cmpuint(data->n_finished, ==, n_finished);
+}
+
+static void check_stats(FmJobPriority priority, guint n_running, guint n_waiting)
+{
+    guint running, waiting;
+
+    fm_job_get_scheduler_stats(priority, &running, &waiting, NULL, NULL, NULL);
+    g_assert_cmpuint(running, ==, n_running);
+    g_assert_cmpuint(waiting, ==, n_waiting);
+}
+
+static void unref_jobs(FmJob **jobs, guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++)
+        g_object_unref(jobs[i]);
+}
+
+static void test_max_running(void)
+{
+    SchedData data = { 0, 0, 0, 0, 0 };
+    FmJob *jobs[5];
+    guint i, started, started2;
+
+    fm_job_set_max_running(FM_JOB_PRIORITY_REFRESH, 2);
+    fm_job_get_scheduler_stats(FM_JOB_PRIORITY_REFRESH, NULL, NULL, &started, NULL, NULL);
+    for (i = 0; i < G_N_ELEMENTS(jobs); i++)
+        jobs[i] = start_job(&data, gated_job, FM_JOB_PRIORITY_REFRESH);
+    wait_for_ran(&data, 2);
+    check_stats(FM_JOB_PRIORITY_REFRESH, 2, G_N_ELEMENTS(jobs) - 2);
+
+    /* waiting jobs are started when running ones are done */
+    g_atomic_int_set(&data.gate, 1);
+    wait_for_finished(&data, G_N_ELEMENTS(jobs));
+    g_assert_cmpint(data.n_ran, ==, G_N_ELEMENTS(jobs));
+    g_assert_cmpint(data.max_running, ==, 2);
+    check_stats(FM_JOB_PRIORITY_REFRESH, 0, 0);
+    fm_job_get_scheduler_stats(FM_JOB_PRIORITY_REFRESH, NULL, NULL, &started2, NULL, NULL);
+    g_assert_cmpuint(started2 - started, ==, G_N_ELEMENTS(jobs));
+
+    fm_job_set_max_running(FM_JOB_PRIORITY_REFRESH, 4); /* the default */
+    unref_jobs(jobs, G_N_ELEMENTS(jobs));
+}
+
+static void test_promote(void)
+{
+    SchedData data = { 0, 0, 0, 0, 0 };
+    FmJob *jobs[3];
+
+    /* the only background slot is taken, both jobs are waiting */
+    fm_job_set_max_running(FM_JOB_PRIORITY_BACKGROUND, 1);
+    jobs[0] = start_job(&data, gated_job, FM_JOB_PRIORITY_BACKGROUND);
+    wait_for_ran(&data, 1);
+    jobs[1] = start_job(&data, gated_job, FM_JOB_PRIORITY_BACKGROUND);
+    jobs[2] = start_job(&data, gated_job, FM_JOB_PRIORITY_BACKGROUND);
+    check_stats(FM_JOB_PRIORITY_BACKGROUND, 1, 2);
+
+    /* promoted job is started at once, the other one still waits */
+    fm_job_set_priority(jobs[2], FM_JOB_PRIORITY_INTERACTIVE);
+    g_assert_cmpint(fm_job_get_priority(jobs[2]), ==, FM_JOB_PRIORITY_INTERACTIVE);
+    wait_for_ran(&data, 2);
+    check_stats(FM_JOB_PRIORITY_BACKGROUND, 1, 1);
+
+    g_atomic_int_set(&data.gate, 1);
+    wait_for_finished(&data, G_N_ELEMENTS(jobs));
+    check_stats(FM_JOB_PRIORITY_BACKGROUND, 0, 0);
+    unref_jobs(jobs, G_N_ELEMENTS(jobs));
+}
+
+static void test_cancel_waiting(void)
+{
+    SchedData data = { 0, 0, 0, 0, 0 };
+    FmJob *jobs[2];
+
+    fm_job_set_max_running(FM_JOB_PRIORITY_BACKGROUND, 1);
+    jobs[0] = start_job(&data, gated_job, FM_JOB_PRIORITY_BACKGROUND);
+    wait_for_ran(&data, 1);
+    jobs[1] = start_job(&data, gated_job, FM_JOB_PRIORITY_BACKGROUND);
+    check_stats(FM_JOB_PRIORITY_BACKGROUND, 1, 1);
+
+    /* cancelled job doesn't wait for the slot */
+    fm_job_cancel(jobs[1]);
+    wait_for_finished(&data, 1);
+    check_stats(FM_JOB_PRIORITY_BACKGROUND, 1, 0);
+
+    g_atomic_int_set(&data.gate, 1);
+    wait_for_finished(&data, G_N_ELEMENTS(jobs));
+    unref_jobs(jobs, G_N_ELEMENTS(jobs));
+}
+
+static gboolean on_sync_timeout(gpointer user_data)
+{
+    SchedData *data = user_data;
+
+    /* let the test fail instead of hanging */
+    g_atomic_int_set(&data->gate, 1);
+    return FALSE;
+}
+
+static void test_sync_bypass(void)
+{
+    SchedData data = { 0, 0, 0, 0, 0 };
+    FmJob *blocker, *job;
+    guint timeout;
+
+    fm_job_set_max_running(FM_JOB_PRIORITY_BACKGROUND, 1);
+    blocker = start_job(&data, gated_job, FM_JOB_PRIORITY_BACKGROUND);
+    wait_for_ran(&data, 1);
+
+    /* the caller waits for the job so it runs while the slot is taken */
+    job = fm_simple_job_new(quick_job, &data, NULL);
+    fm_job_set_priority(job, FM_JOB_PRIORITY_BACKGROUND);
+    timeout = g_timeout_add_seconds(10, on_sync_timeout, &data);
+    g_assert(fm_job_run_sync_with_mainloop(job));
+    g_assert(!g_atomic_int_get(&data.gate));
+    g_source_remove(timeout);
+    g_assert_cmpint(data.n_ran, ==, 2);
+    check_stats(FM_JOB_PRIORITY_BACKGROUND, 1, 0);
+
+    g_atomic_int_set(&data.gate, 1);
+    wait_for_finished(&data, 1);
+    g_object_unref(job);
+    g_object_unref(blocker);
+}
+
+int main (int   argc, char *argv[])
+{
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    g_test_init (&argc, &argv, NULL); // initialize test program
+    g_test_add_func("/FmJob/max_running", test_max_running);
+    g_test_add_func("/FmJob/promote", test_promote);
+    g_test_add_func("/FmJob/cancel_waiting", test_cancel_waiting);
+    g_test_add_func("/FmJob/sync_bypass", test_sync_bypass);
+
+    return g_test_run();
+}
@@ -0,0 +1,291 @@
+/*
+ *      test-fm-mime-type.c
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+//ignore for test disabled asserts
+#ifdef G_DISABLE_ASSERT
+#  undef G_DISABLE_ASSERT
+#endif
+
+#include <fm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fixtures.h"
+
+/* private data and cache dirs, they are set before anything is initialized */
+static char *data_home = NULL;
+static char *globs_path = NULL;
+static const char *self = NULL;
+
+/* files without suffix which type is detected by contents */
+static const char *contents[] = {
+    "#!/bin/sh\necho hello\n",
+    "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n1 0 obj\n",
+    "From someone@example.com Mon Jan  1 00:00:00 2001\nSubject: test\n\n",
+    "Just some plain text in a file without suffix.\n"
+};
+
+static void write_globs(const char *contents)
+{
+    g_assert(g_file_set_contents(globs_path, contents, -1, NULL));
+}
+
+static void check_name(const char *name)
+{
+    FmMimeType *mime_type = fm_mime_type_from_file_name(name);
+    gboolean uncertain;
+    char *type = g_content_type_guess(name, NULL, 0, &uncertain);
+
+    if (strcmp(fm_mime_type_get_type(mime_type), type) != 0)
+        g_error("%s: got %s, GIO has %s", name, fm_mime_type_get_type(mime_type), type);
+    g_free(type);
+    fm_mime_type_unref(mime_type);
+}
+
+static void test_globs_as_gio(void)
+{
+    static const char *names[] = {
+        "image.png", "IMAGE.PNG", "archive.tar.gz", "archive.TAR.GZ", "a.tar.bz2",
+        "page.html", "page.htm", "notes.txt", "script.sh", "source.c",
+        "header.h", "source.C", "Makefile", "makefile", "README", "core",
+        "CMakeLists.txt", "photo.jpeg", "photo.JPG", "movie.mkv", "song.mp3",
+        "doc.pdf", "book.epub", "data.json", "style.css", "x.desktop",
+        "noext", ".hidden", "trailing.", "a.b.c.d", "backup~", "file.bak",
+        "libfm.so.4", "libfm.so", "main.o", "app.py", "Foo.java", "file.fmtest",
+        "file.FMTEST", "UPPER.fmcs", "lower.FMCS", "named-fmtest"
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(names); i++)
+        check_name(names[i]);
+}
+
+static void test_globs_reload(void)
+{
+    FmMimeType *mime_type;
+
+    mime_type = fm_mime_type_from_file_name("file.fmtest");
+    g_assert_cmpstr(fm_mime_type_get_type(mime_type), ==, "application/x-fm-test");
+    fm_mime_type_unref(mime_type);
+
+    /* file size is changed so change is noticed even within same second */
+    write_globs("# test globs\n"
+                "50:application/x-fm-test-changed:*.fmtest\n"
+                "50:application/x-fm-test-new:*.fmnew\n");
+    /* both libfm and GIO check files not often than every 5 seconds */
+    g_usleep(6 * G_USEC_PER_SEC);
+
+    mime_type = fm_mime_type_from_file_name("file.fmtest");
+    g_assert_cmpstr(fm_mime_type_get_type(mime_type), ==, "application/x-fm-test-changed");
+    fm_mime_type_unref(mime_type);
+    check_name("file.fmtest");
+    check_name("file.fmnew");
+}
+
+static char *make_sniff_tree(void)
+{
+    char *dir = fixture_make_dir(NULL);
+    char name[32];
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(contents); i++)
+    {
+        char *path;
+        g_snprintf(name, sizeof(name), "file-%u", i);
+        path = g_build_filename(dir, name, NULL);
+        g_assert(g_file_set_contents(path, contents[i], -1, NULL));
+        g_free(path);
+    }
+    return dir;
+}
+
+/* returns types of files in @dir as "name type\n" lines */
+static char *sniff_tree(const char *dir)
+{
+    GString *types = g_string_new("");
+    char name[32];
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(contents); i++)
+    {
+        FmMimeType *mime_type;
+        char *path;
+        g_snprintf(name, sizeof(name), "file-%u", i);
+        path = g_build_filename(dir, name, NULL);
+        mime_type = fm_mime_type_from_native_file(path, name, NULL);
+        g_assert(mime_type != NULL);
+        g_string_append_printf(types, "%s %s\n", name, fm_mime_type_get_type(mime_type));
+        fm_mime_type_unref(mime_type);
+        g_free(path);
+    }
+    return g_string_free(types, FALSE);
+}
+
+static void test_sniff_cache(void)
+{
+    char *dir = make_sniff_tree();
+    char *types, *cached, *path;
+    guint hits, misses, hits2, misses2, n_entries;
+
+    fm_mime_type_get_sniff_cache_stats(&hits, &misses, NULL);
+    types = sniff_tree(dir);
+    fm_mime_type_get_sniff_cache_stats(&hits2, &misses2, &n_entries);
+    g_assert_cmpuint(hits2, ==, hits);
+    g_assert_cmpuint(misses2, ==, misses + G_N_ELEMENTS(contents));
+    g_assert_cmpuint(n_entries, >=, G_N_ELEMENTS(contents));
+
+    /* the same types are found without reading files */
+    cached = sniff_tree(dir);
+    fm_mime_type_get_sniff_cache_stats(&hits, &misses, NULL);
+    g_assert_cmpuint(hits, ==, hits2 + G_N_ELEMENTS(contents));
+    g_assert_cmpuint(misses, ==, misses2);
+    g_assert_cmpstr(cached, ==, types);
+    g_free(cached);
+
+    /* changed file is read again */
+    path = g_build_filename(dir, "file-0", NULL);
+    g_assert(g_file_set_contents(path, contents[1], -1, NULL));
+    g_free(path);
+    cached = sniff_tree(dir);
+    fm_mime_type_get_sniff_cache_stats(&hits2, &misses2, NULL);
+    g_assert_cmpuint(misses2, ==, misses + 1);
+    g_assert_cmpuint(hits2, ==, hits + G_N_ELEMENTS(contents) - 1);
+    g_assert(strncmp(cached, "file-0 application/pdf\n", 23) == 0);
+
+    g_free(cached);
+    g_free(types);
+    fixture_remove_tree(dir);
+}
+
+static void test_sniff_cache_disabled(void)
+{
+    char *dir = make_sniff_tree();
+    guint hits, misses, hits2, misses2;
+
+    /* files are read every time and nothing is counted */
+    fm_mime_type_set_sniff_cache_limit(0);
+    fm_mime_type_get_sniff_cache_stats(&hits, &misses, NULL);
+    g_free(sniff_tree(dir));
+    g_free(sniff_tree(dir));
+    fm_mime_type_get_sniff_cache_stats(&hits2, &misses2, NULL);
+    fm_mime_type_set_sniff_cache_limit(65536); /* the default */
+    g_assert_cmpuint(hits2, ==, hits);
+    g_assert_cmpuint(misses2, ==, misses);
+
+    fixture_remove_tree(dir);
+}
+
+/* runs in child process: prints "hits misses" and types of files in @dir */
+static int run_sniff_pass(const char *dir)
+{
+    guint hits, misses;
+    char *types;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+    types = sniff_tree(dir);
+    fm_mime_type_get_sniff_cache_stats(&hits, &misses, NULL);
+    fm_finalize(); /* the cache is saved here */
+    printf("%u %u\n%s", hits, misses, types);
+    g_free(types);
+    return 0;
+}
+
+static char *spawn_sniff_pass(const char *dir)
+{
+    char *argv[] = { (char*)self, "--sniff-pass", (char*)dir, NULL };
+    char *out = NULL;
+    int status;
+
+    g_assert(g_spawn_sync(NULL, argv, NULL, 0, NULL, NULL, &out, NULL, &status, NULL));
+    g_assert_cmpint(status, ==, 0);
+    return out;
+}
+
+static void test_sniff_cache_saved(void)
+{
+    char *dir = make_sniff_tree();
+    char *first, *second, *expected;
+    char *types;
+
+    /* first process reads all files and saves the cache at exit, the
+       next one finds all of them in the cache */
+    first = spawn_sniff_pass(dir);
+    second = spawn_sniff_pass(dir);
+    types = strchr(first, '\n');
+    g_assert(types != NULL);
+    expected = g_strdup_printf("0 %u%s", (guint)G_N_ELEMENTS(contents), types);
+    g_assert_cmpstr(first, ==, expected);
+    g_free(expected);
+    expected = g_strdup_printf("%u 0%s", (guint)G_N_ELEMENTS(contents), types);
+    g_assert_cmpstr(second, ==, expected);
+
+    g_free(expected);
+    g_free(second);
+    g_free(first);
+    fixture_remove_tree(dir);
+}
+
+int main (int   argc, char *argv[])
+{
+    char *mime_dir, *cache_home;
+    int ret;
+
+    if (argc == 3 && strcmp(argv[1], "--sniff-pass") == 0)
+        return run_sniff_pass(argv[2]);
+    self = argv[0];
+
+    /* use globs from own data dir and own cache dir, it should be done
+       before GLib reads environment first time */
+    data_home = fixture_make_dir(NULL);
+    mime_dir = g_build_filename(data_home, "mime", NULL);
+    g_assert(g_mkdir_with_parents(mime_dir, 0700) == 0);
+    globs_path = g_build_filename(mime_dir, "globs2", NULL);
+    write_globs("# test globs\n"
+                "50:application/x-fm-test:*.fmtest\n"
+                "50:application/x-fm-test-cs:*.fmcs:cs\n"
+                "50:application/x-fm-test-literal:named-fmtest\n");
+    g_setenv("XDG_DATA_HOME", data_home, TRUE);
+    cache_home = g_build_filename(data_home, "cache", NULL);
+    g_setenv("XDG_CACHE_HOME", cache_home, TRUE);
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    fm_init(NULL);
+
+    g_test_init (&argc, &argv, NULL); // initialize test program
+    g_test_add_func("/FmMimeType/globs_as_gio", test_globs_as_gio);
+    g_test_add_func("/FmMimeType/globs_reload", test_globs_reload);
+    g_test_add_func("/FmMimeType/sniff_cache", test_sniff_cache);
+    g_test_add_func("/FmMimeType/sniff_cache_disabled", test_sniff_cache_disabled);
+    g_test_add_func("/FmMimeType/sniff_cache_saved", test_sniff_cache_saved);
+
+    ret = g_test_run();
+
+    fm_finalize();
+    fixture_remove_tree(data_home);
+    g_free(cache_home);
+    g_free(globs_path);
+    g_free(mime_dir);
+    return ret;
+}
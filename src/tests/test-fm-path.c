@@ -25,6 +25,7 @@
 #endif
 
 #include <fm.h>
+#include <string.h>
 
 #define TEST_PARSING(func, str_to_parse, ...) \
     G_STMT_START { \
@@ -394,6 +395,49 @@ static void test_path_child()
 */
 }
 
+static void test_path_to_str()
+{
+    FmPath* path;
+    FmPath* parent;
+    char* str;
+    char buf[64];
+
+    path = fm_path_new_for_path("/usr/share/libfm");
+    str = fm_path_to_str(path);
+    g_assert_cmpstr(str, ==, "/usr/share/libfm");
+    g_assert_cmpint(fm_path_to_str_buf(path, buf, sizeof(buf)), ==, strlen(str));
+    g_assert_cmpstr(buf, ==, str);
+    g_assert_cmpint(fm_path_depth(path), ==, 4);
+    /* buffer is too small: nothing is written */
+    buf[0] = '\0';
+    g_assert_cmpint(fm_path_to_str_buf(path, buf, strlen(str)), ==, strlen(str));
+    g_assert_cmpstr(buf, ==, "");
+    g_free(str);
+
+    /* hash should be the same as computed from parent */
+    parent = fm_path_new_for_path("/usr/share");
+    g_assert(fm_path_get_parent(path) == parent);
+    g_assert_cmpuint(fm_path_hash(path), ==,
+                     (((g_str_hash("libfm") << 5) - g_str_hash("libfm") + '/')
+                      ^ fm_path_hash(parent)));
+    fm_path_unref(parent);
+    fm_path_unref(path);
+
+    path = fm_path_get_root();
+    g_assert_cmpint(fm_path_to_str_buf(path, buf, sizeof(buf)), ==, 1);
+    g_assert_cmpstr(buf, ==, "/");
+    g_assert_cmpint(fm_path_depth(path), ==, 1);
+
+    path = fm_path_new_for_uri("sftp://user@host/dir/file");
+    str = fm_path_to_str(path);
+    g_assert_cmpstr(str, ==, "sftp://user@host/dir/file");
+    g_assert_cmpint(fm_path_to_str_buf(path, buf, sizeof(buf)), ==, strlen(str));
+    g_assert_cmpstr(buf, ==, str);
+    g_assert_cmpint(fm_path_depth(path), ==, 3);
+    g_free(str);
+    fm_path_unref(path);
+}
+
 static void test_predefined_paths()
 {
     FmPath* path;
@@ -454,6 +498,7 @@ int main (int   argc, char *argv[])
     g_test_add_func("/FmPath/path_parsing", test_path_parsing);
     g_test_add_func("/FmPath/uri_parsing", test_uri_parsing);
     g_test_add_func("/FmPath/predefined_paths", test_predefined_paths);
+    g_test_add_func("/FmPath/to_str", test_path_to_str);
 
     return g_test_run();
 }